@@ -22,11 +22,16 @@
 /* awn-desktop-lookup-cached.c */
 
 
+#include <sys/stat.h>
+#include <string.h>
+#include <glib/gstdio.h>
+
 #include "xutils.h"
 #include <libdesktop-agnostic/fdo.h>
 #include "awn-desktop-lookup-cached.h"
 #include "libawn/libawn.h"
 #include "util.h"
+#include "desktop-index.h"
 
 #undef G_DISABLE_SINGLE_INCLUDES
 #include <glibtop/procargs.h>
@@ -38,19 +43,59 @@ G_DEFINE_TYPE(AwnDesktopLookupCached, awn_desktop_lookup_cached, AWN_TYPE_DESKTO
 
 typedef struct _AwnDesktopLookupCachedPrivate AwnDesktopLookupCachedPrivate;
 
+/*
+ Index
+
+ Every desktop file is a DesktopNode in nodes, its position is its order
+ (earlier data dirs first) which decides between several matches. Besides
+ the exact hash tables there are
+   - exec_trie, a trie of the Exec values, for finding the first Exec that
+     is a prefix of a command line or that a command line is a prefix of.
+   - exec_trigrams and path_trigrams, every 3 byte substring of Exec or the
+     path -> orders of the nodes containing it, for substring searches. Only
+     the nodes in the shortest list of the needle's trigrams are compared.
+ The desktop files are watched by directory monitors, which mark deleted
+ nodes instead of testing the result of every lookup stage with stat().
+
+ What's needed from the desktop files is kept in a DesktopIndex between
+ runs, so only the directories that changed are listed and only the files
+ that changed are read.
+ */
+
 typedef struct {
-    gchar* path;
-    gchar* exec;
-    gchar* name;
+    gchar*   path;
+    gchar*   exec;
+    gchar*   name;
+    /* set by the directory monitors */
+    gboolean deleted;
 } DesktopNode;
 
+typedef struct _ExecTrieNode ExecTrieNode;
+struct _ExecTrieNode {
+    ExecTrieNode* child;
+    ExecTrieNode* sibling;
+    gchar         c;
+    /* order of the first Exec ending here, -1 if none does */
+    gint          order;
+    /* lowest order of this subtree */
+    gint          min_order;
+};
+
 struct _AwnDesktopLookupCachedPrivate {
     GHashTable* name_hash;
     GHashTable* exec_hash;
     GHashTable* desktops_hash;     /*desktop file names, without paths*/
     GHashTable* startup_wm_hash;
 
-    GSList* desktop_list;   /*For when the fast lookups don't work*/
+    GPtrArray*    nodes;          /* DesktopNode, in order */
+    GHashTable*   paths_hash;     /* path -> DesktopNode */
+    ExecTrieNode* exec_trie;
+    GHashTable*   exec_trigrams;
+    GHashTable*   path_trigrams;
+    GHashTable*   monitors;       /* directory -> DesktopAgnosticVFSFileMonitor */
+
+    DesktopIndex* index;
+    guint         save_id;
 };
 
 static void
@@ -76,136 +121,461 @@ awn_desktop_lookup_cached_set_property(GObject* object, guint property_id,
 static void
 awn_desktop_lookup_cached_dispose(GObject* object)
 {
+    AwnDesktopLookupCachedPrivate* priv = GET_PRIVATE(object);
+
+    if (priv->monitors) {
+        g_hash_table_destroy(priv->monitors);
+        priv->monitors = NULL;
+    }
+    if (priv->save_id) {
+        g_source_remove(priv->save_id);
+        priv->save_id = 0;
+        desktop_index_save(priv->index);
+    }
     G_OBJECT_CLASS(awn_desktop_lookup_cached_parent_class)->dispose(object);
 }
 
+static void
+_exec_trie_free(ExecTrieNode* node)
+{
+    while (node) {
+        ExecTrieNode* sibling = node->sibling;
+        _exec_trie_free(node->child);
+        g_slice_free(ExecTrieNode, node);
+        node = sibling;
+    }
+}
+
+static void
+_desktop_node_free(DesktopNode* node)
+{
+    g_free(node->name);
+    /* path and exec are owned by the hash tables */
+    g_free(node);
+}
+
+static void
+_trigram_list_free(GArray* list)
+{
+    g_array_free(list, TRUE);
+}
+
 static void
 awn_desktop_lookup_cached_finalize(GObject* object)
 {
+    AwnDesktopLookupCachedPrivate* priv = GET_PRIVATE(object);
+
+    g_hash_table_destroy(priv->name_hash);
+    g_hash_table_destroy(priv->exec_hash);
+    g_hash_table_destroy(priv->desktops_hash);
+    g_hash_table_destroy(priv->startup_wm_hash);
+    g_hash_table_destroy(priv->paths_hash);
+    g_hash_table_destroy(priv->exec_trigrams);
+    g_hash_table_destroy(priv->path_trigrams);
+    _exec_trie_free(priv->exec_trie);
+    g_ptr_array_foreach(priv->nodes, (GFunc)_desktop_node_free, NULL);
+    g_ptr_array_free(priv->nodes, TRUE);
+    desktop_index_free(priv->index);
+
     G_OBJECT_CLASS(awn_desktop_lookup_cached_parent_class)->finalize(object);
 }
 
+static void
+_exec_trie_insert(ExecTrieNode** root, const gchar* exec, gint order)
+{
+    ExecTrieNode** level = root;
+    ExecTrieNode* node = NULL;
+
+    for (const gchar* c = exec; *c; c++) {
+        for (node = *level; node && node->c != *c; node = node->sibling);
+        if (!node) {
+            node = g_slice_new(ExecTrieNode);
+            node->child = NULL;
+            node->sibling = *level;
+            node->c = *c;
+            node->order = -1;
+            node->min_order = order;
+            *level = node;
+        } else if (node->min_order > order) {
+            node->min_order = order;
+        }
+        level = &node->child;
+    }
+    if (node && (node->order < 0 || node->order > order)) {
+        node->order = order;
+    }
+}
+
+/*
+ Returns the order of the first Exec that cmd is a prefix of or that is
+ a prefix of cmd, -1 if there's none.
+ */
+static gint
+_exec_trie_lookup_prefix(ExecTrieNode* root, const gchar* cmd)
+{
+    ExecTrieNode* node = NULL;
+    ExecTrieNode* level = root;
+    gint result = -1;
+    gint depth = 0;
+
+    if (strlen(cmd) < 3) {
+        return -1;
+    }
+    for (const gchar* c = cmd; *c; c++) {
+        for (node = level; node && node->c != *c; node = node->sibling);
+        if (!node) {
+            return result;
+        }
+        depth++;
+        if (depth >= 3 && node->order >= 0 && (result < 0 || node->order < result)) {
+            result = node->order;
+        }
+        level = node->child;
+    }
+    /* every Exec below starts with cmd */
+    if (result < 0 || node->min_order < result) {
+        result = node->min_order;
+    }
+    return result;
+}
+
+#define TRIGRAM_KEY(s) \
+  GUINT_TO_POINTER(((guint)(guchar)(s)[0] << 16) | ((guint)(guchar)(s)[1] << 8) | (guchar)(s)[2])
+
+static void
+_trigrams_insert(GHashTable* trigrams, const gchar* str, guint order)
+{
+    gsize len = strlen(str);
+
+    for (gsize i = 0; i + 3 <= len; i++) {
+        GArray* list = (GArray*)g_hash_table_lookup(trigrams, TRIGRAM_KEY(str + i));
+        if (!list) {
+            list = g_array_new(FALSE, FALSE, sizeof(guint));
+            g_hash_table_insert(trigrams, TRIGRAM_KEY(str + i), list);
+        }
+        /* a node is added once, even if the trigram repeats */
+        if (list->len == 0 || g_array_index(list, guint, list->len - 1) != order) {
+            g_array_append_val(list, order);
+        }
+    }
+}
+
+/*
+ Returns the orders of the nodes that may contain needle, in order. NULL if
+ none can.
+ */
+static GArray*
+_trigrams_candidates(GHashTable* trigrams, const gchar* needle)
+{
+    gsize len = strlen(needle);
+    GArray* best = NULL;
+
+    if (len < 3) {
+        return NULL;
+    }
+    for (gsize i = 0; i + 3 <= len; i++) {
+        GArray* list = (GArray*)g_hash_table_lookup(trigrams, TRIGRAM_KEY(needle + i));
+        if (!list) {
+            return NULL;
+        }
+        if (!best || list->len < best->len) {
+            best = list;
+        }
+    }
+    return best;
+}
+
+static DesktopNode*
+_get_node(AwnDesktopLookupCachedPrivate* priv, guint order)
+{
+    return (DesktopNode*)g_ptr_array_index(priv->nodes, order);
+}
+
+/* NULL if the desktop file was deleted since it was indexed */
+static const gchar*
+_existing(AwnDesktopLookupCachedPrivate* priv, const gchar* path)
+{
+    DesktopNode* node;
+
+    if (!path) {
+        return NULL;
+    }
+    node = (DesktopNode*)g_hash_table_lookup(priv->paths_hash, path);
+    return node && !node->deleted ? path : NULL;
+}
+
+static void
+_data_dir_changed(DesktopAgnosticVFSFileMonitor* monitor,
+                  DesktopAgnosticVFSFile* self,
+                  DesktopAgnosticVFSFile* other,
+                  DesktopAgnosticVFSFileMonitorEvent event,
+                  AwnDesktopLookupCached* lookup);
+
+static void
+awn_desktop_lookup_cached_monitor_dir(AwnDesktopLookupCached* lookup, const gchar* dir)
+{
+    AwnDesktopLookupCachedPrivate* priv = GET_PRIVATE(lookup);
+    DesktopAgnosticVFSFileMonitor* monitor_vfs;
+    DesktopAgnosticVFSFile* file_vfs;
+    GError* error = NULL;
+
+    if (!priv->monitors || g_hash_table_lookup(priv->monitors, dir)) {
+        return;
+    }
+    file_vfs = desktop_agnostic_vfs_file_new_for_path(dir, &error);
+    if (error) {
+        g_warning("%s: Error with file monitor.  %s", __func__, error->message);
+        g_error_free(error);
+        return;
+    }
+    monitor_vfs = desktop_agnostic_vfs_file_monitor(file_vfs);
+    g_signal_connect(G_OBJECT(monitor_vfs), "changed", G_CALLBACK(_data_dir_changed), lookup);
+    g_hash_table_insert(priv->monitors, g_strdup(dir), monitor_vfs);
+    g_object_weak_ref(G_OBJECT(lookup), (GWeakNotify)g_object_unref, file_vfs);
+}
+
+/* reads what the index keeps from a desktop file, free with _entry_clear() */
+static void
+_read_desktop_file(const gchar* path, DesktopIndexEntry* entry)
+{
+    DesktopAgnosticFDODesktopEntry* desktop = NULL;
+    DesktopAgnosticVFSFile* file;
+
+    file = desktop_agnostic_vfs_file_new_for_path(path, NULL);
+    if (!file) {
+        return;
+    }
+    if (desktop_agnostic_vfs_file_exists(file)) {
+        desktop = desktop_agnostic_fdo_desktop_entry_new_for_file(file, NULL);
+    }
+    if (desktop) {
+        if (desktop_agnostic_fdo_desktop_entry_key_exists(desktop, "NoDisplay")) {
+            entry->no_display = desktop_agnostic_fdo_desktop_entry_get_boolean(desktop, "NoDisplay");
+        }
+        if (desktop_agnostic_fdo_desktop_entry_key_exists(desktop, "Name")
+                &&
+                desktop_agnostic_fdo_desktop_entry_key_exists(desktop, "Exec")) {
+            gchar* exec = desktop_agnostic_fdo_desktop_entry_get_string(desktop, "Exec");
+
+            if (exec) {
+                g_strdelimit(exec, "%", '\0');
+                g_strstrip(exec);
+            }
+            entry->name = _desktop_entry_get_localized_name(desktop);
+            entry->exec = exec;
+        }
+        if (desktop_agnostic_fdo_desktop_entry_key_exists(desktop, "StartupWMClass")) {
+            entry->startup_wm = desktop_agnostic_fdo_desktop_entry_get_string(desktop, "StartupWMClass");
+        }
+        g_object_unref(desktop);
+    }
+    g_object_unref(file);
+}
+
+static void
+_entry_clear(DesktopIndexEntry* entry)
+{
+    g_free((gchar*)entry->name);
+    g_free((gchar*)entry->exec);
+    g_free((gchar*)entry->startup_wm);
+}
+
+static void
+awn_desktop_lookup_cached_add_desktop(AwnDesktopLookupCached* lookup, const gchar* new_path,
+                                      const DesktopIndexEntry* entry)
+{
+    AwnDesktopLookupCachedPrivate* priv = GET_PRIVATE(lookup);
+    DesktopNode* node;
+
+    node = (DesktopNode*)g_hash_table_lookup(priv->paths_hash, new_path);
+    if (node) {
+        /* deleted and back again */
+        node->deleted = FALSE;
+        return;
+    }
+    if (entry->no_display && !check_no_display_override(entry->basename)) {
+        return;
+    }
+    if (entry->name && entry->exec) {
+        /*
+         Be careful.  Not duplicating these strings for each data structure
+         */
+        gchar* name = g_strdup(entry->name);
+        gchar* exec = g_strdup(entry->exec);
+        gchar* copy_path = NULL;
+        gchar* search = NULL;
+        gchar* name_lwr = g_utf8_strdown(name, -1);
+        gchar* startup_wm = NULL;
+        gchar* desktop_name = g_strdup(entry->basename);
+
+        if (name_lwr && (search = g_hash_table_lookup(priv->name_hash, name_lwr))) {
+//          g_warning ("%s: Name (%s) collision between %s and %s",__func__,name,search,new_path);
+            g_free(name_lwr);
+            name_lwr = NULL;
+        }
+
+        if (exec && (search = g_hash_table_lookup(priv->exec_hash, exec))) {
+            /* This gets hit when we refresh the list due to an new installations etc.
+             If we hit this then it's more or less a duplicate of an existing desktop
+             or we have a refresh for some reason.  Either way we ignore it.*/
+//          g_warning ("%s: Exec Name (%s) collision between %s and %s",__func__,exec,search,new_path);
+            g_free(name);
+            g_free(name_lwr);
+            g_free(exec);
+            g_free(desktop_name);
+            return;
+        }
+
+        if (desktop_name && (search = g_hash_table_lookup(priv->desktops_hash, desktop_name))) {
+            /*Happens often enough (ex.  "Terminal" ).  Not a big deal, we're
+             relatively conservative in using name for matching purposes*/
+            g_free(desktop_name);
+            desktop_name = NULL;
+        }
+
+        if (entry->startup_wm) {
+            startup_wm = g_strdup(entry->startup_wm);
+            search = g_hash_table_lookup(priv->startup_wm_hash, startup_wm);
+            if (g_strcmp0(startup_wm, "Wine") == 0) {
+                g_free(startup_wm);
+                startup_wm = NULL;
+            } else if (search) {
+                /*if we hit this then I'm interested in knowing about it*/
+                g_warning("%s: StartuWM Name (%s) collision between %s and %s", __func__, startup_wm, search, new_path);
+                g_free(startup_wm);
+                startup_wm = NULL;
+            }
+        }
+        copy_path = g_strdup(new_path);
+        if (name_lwr) {
+            g_hash_table_insert(priv->name_hash, name_lwr, copy_path);
+        }
+        if (exec) {
+            g_hash_table_insert(priv->exec_hash, exec, copy_path);
+        }
+        if (desktop_name) {
+            g_hash_table_insert(priv->desktops_hash, desktop_name, copy_path);
+        }
+        if (startup_wm) {
+            g_hash_table_insert(priv->startup_wm_hash, startup_wm, copy_path);
+        }
+        node = g_new0(DesktopNode, 1);
+        node->path = copy_path;
+        node->name = name;
+        node->exec = exec;
+        g_hash_table_insert(priv->paths_hash, copy_path, node);
+        if (strlen(exec) >= 3) {
+            _exec_trie_insert(&priv->exec_trie, exec, priv->nodes->len);
+            _trigrams_insert(priv->exec_trigrams, exec, priv->nodes->len);
+        }
+        _trigrams_insert(priv->path_trigrams, copy_path, priv->nodes->len);
+        g_ptr_array_add(priv->nodes, node);
+    }
+}
+
+/*
+ A directory with the same mtime as in the index is replayed from it,
+ otherwise it's listed and only the desktop files whose mtime changed are
+ read. Subdirectories are checked on their own.
+ */
 static void
 awn_desktop_lookup_cached_add_dir(AwnDesktopLookupCached* lookup, const gchar* applications_dir)
 {
+    AwnDesktopLookupCachedPrivate* priv = GET_PRIVATE(lookup);
     GDir*         dir = NULL;
     const gchar* fname = NULL;
-    AwnDesktopLookupCachedPrivate* priv = GET_PRIVATE(lookup);
     static int call_depth = 0;
+    struct stat st;
+    const DesktopIndexDir* cached;
+    DesktopIndexDir* dir_index;
+    GHashTable* cached_entries = NULL;
 
+    if (g_stat(applications_dir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        return;
+    }
     call_depth ++;
     if (call_depth > 10) {
         g_debug("%s: resursive depth = %d.  bailing at %s", __func__, call_depth, applications_dir);
     }
+    awn_desktop_lookup_cached_monitor_dir(lookup, applications_dir);
+
+    cached = desktop_index_lookup(priv->index, applications_dir);
+    if (cached && cached->mtime == (gint64)st.st_mtime) {
+        for (guint i = 0; i < cached->entries->len; i++) {
+            const DesktopIndexEntry* entry = &g_array_index(cached->entries,
+                                             DesktopIndexEntry, i);
+            gchar* new_path = g_build_filename(applications_dir, entry->basename, NULL);
+            if (entry->type == DESKTOP_INDEX_DIR) {
+                awn_desktop_lookup_cached_add_dir(lookup, new_path);
+            } else {
+                awn_desktop_lookup_cached_add_desktop(lookup, new_path, entry);
+            }
+            g_free(new_path);
+        }
+        call_depth --;
+        return;
+    }
+
     dir = g_dir_open(applications_dir, 0, NULL);
+    if (!dir) {
+        call_depth --;
+        return;
+    }
+    if (cached) {
+        cached_entries = g_hash_table_new(g_str_hash, g_str_equal);
+        for (guint i = 0; i < cached->entries->len; i++) {
+            DesktopIndexEntry* entry = &g_array_index(cached->entries,
+                                       DesktopIndexEntry, i);
+            g_hash_table_insert(cached_entries, (gpointer)entry->basename, entry);
+        }
+    }
+    dir_index = desktop_index_dir_new(st.st_mtime);
+
     while ((fname = g_dir_read_name(dir))) {
-        gchar* new_path = g_strdup_printf("%s/%s", applications_dir, fname);
+        gchar* new_path = g_build_filename(applications_dir, fname, NULL);
+        DesktopIndexEntry entry = { DESKTOP_INDEX_DIR, fname, 0, FALSE, NULL, NULL, NULL };
+        struct stat file_st;
+
         if (g_file_test(new_path, G_FILE_TEST_IS_DIR)) {
+            desktop_index_dir_append(priv->index, dir_index, &entry);
             awn_desktop_lookup_cached_add_dir(lookup, new_path);
-        } else {
-            DesktopAgnosticFDODesktopEntry* entry = NULL;
-            DesktopAgnosticVFSFile* file;
-            file = desktop_agnostic_vfs_file_new_for_path(new_path, NULL);
-            if (file) {
-                if (desktop_agnostic_vfs_file_exists(file) && g_strstr_len(new_path, -1, ".desktop")) {
-                    entry = desktop_agnostic_fdo_desktop_entry_new_for_file(file, NULL);
-                    if (entry && desktop_agnostic_fdo_desktop_entry_key_exists(entry, "NoDisplay")) {
-                        if (desktop_agnostic_fdo_desktop_entry_get_boolean(entry, "NoDisplay")) {
-                            if (!check_no_display_override(fname)) {
-                                goto NO_DISPLAY;
-                            }
-                        }
-                    }
-                    if (entry && desktop_agnostic_fdo_desktop_entry_key_exists(entry, "Name")
-                            &&
-                            desktop_agnostic_fdo_desktop_entry_key_exists(entry, "Exec")) {
-                        /*
-                         Be careful.  Not duplicating these strings for each data structure
-                         */
-                        gchar* name = _desktop_entry_get_localized_name(entry);
-                        gchar* exec = desktop_agnostic_fdo_desktop_entry_get_string(entry, "Exec");
-                        gchar* copy_path = NULL;
-                        gchar* search = NULL;
-                        gchar* name_lwr = g_utf8_strdown(name, -1);
-                        gchar* startup_wm = NULL;
-                        gchar* desktop_name = g_strdup(fname);
-                        DesktopNode* node;
-
-                        g_strdelimit(exec, "%", '\0');
-                        g_strstrip(exec);
-
-                        if (name_lwr && (search = g_hash_table_lookup(priv->name_hash, name_lwr))) {
-//              g_warning ("%s: Name (%s) collision between %s and %s",__func__,name,search,new_path);
-                            g_free(name_lwr);
-                            name_lwr = NULL;
-                        }
-
-                        if (exec && (search = g_hash_table_lookup(priv->exec_hash, exec))) {
-                            /* This gets hit when we refresh the list due to an new installations etc.
-                             If we hit this then it's more or less a duplicate of an existing desktop
-                             or we have a refresh for some reason.  Either way we ignore it.*/
-//              g_warning ("%s: Exec Name (%s) collision between %s and %s",__func__,exec,search,new_path);
-                            g_free(name);
-                            g_free(name_lwr);
-                            g_free(exec);
-                            g_free(desktop_name);
-                            goto NAME_COLLSION;
-                        }
-
-                        if (desktop_name && (search = g_hash_table_lookup(priv->desktops_hash, desktop_name))) {
-                            /*Happens often enough (ex.  "Terminal" ).  Not a big deal, we're
-                             relatively conservative in using name for matching purposes*/
-                            g_free(desktop_name);
-                            desktop_name = NULL;
-                        }
-
-                        if (desktop_agnostic_fdo_desktop_entry_key_exists(entry, "StartupWMClass")) {
-                            startup_wm = desktop_agnostic_fdo_desktop_entry_get_string(entry, "StartupWMClass");
-                            search = g_hash_table_lookup(priv->startup_wm_hash, startup_wm);
-                            if (g_strcmp0(startup_wm, "Wine") == 0) {
-                                g_free(startup_wm);
-                                startup_wm = NULL;
-                            } else if (search) {
-                                /*if we hit this then I'm interested in knowing about it*/
-                                g_warning("%s: StartuWM Name (%s) collision between %s and %s", __func__, startup_wm, search, new_path);
-                                g_free(startup_wm);
-                                startup_wm = NULL;
-                            }
-                        }
-                        copy_path = g_strdup(new_path);
-                        if (name_lwr) {
-                            g_hash_table_insert(priv->name_hash, name_lwr, copy_path);
-                        }
-                        if (exec) {
-                            g_hash_table_insert(priv->exec_hash, exec, copy_path);
-                        }
-                        if (desktop_name) {
-                            g_hash_table_insert(priv->desktops_hash, desktop_name, copy_path);
-                        }
-                        if (startup_wm) {
-                            g_hash_table_insert(priv->startup_wm_hash, startup_wm, copy_path);
-                        }
-                        node = g_malloc(sizeof(DesktopNode));
-                        node->path = copy_path;
-                        node->name = name;
-                        node->exec = exec;
-                        priv->desktop_list = g_slist_prepend(priv->desktop_list, node);
-                    }
-NO_DISPLAY:
-NAME_COLLSION:
-                    if (entry) {
-                        g_object_unref(entry);
-                    }
-                }
-                g_object_unref(file);
+        } else if (g_strstr_len(new_path, -1, ".desktop") && g_stat(new_path, &file_st) == 0) {
+            const DesktopIndexEntry* old = cached_entries ?
+                                           (const DesktopIndexEntry*)g_hash_table_lookup(cached_entries, fname) : NULL;
+
+            if (old && old->type == DESKTOP_INDEX_FILE && old->mtime == (gint64)file_st.st_mtime) {
+                desktop_index_dir_append(priv->index, dir_index, old);
+                awn_desktop_lookup_cached_add_desktop(lookup, new_path, old);
+            } else {
+                entry.type = DESKTOP_INDEX_FILE;
+                entry.mtime = file_st.st_mtime;
+                _read_desktop_file(new_path, &entry);
+                desktop_index_dir_append(priv->index, dir_index, &entry);
+                awn_desktop_lookup_cached_add_desktop(lookup, new_path, &entry);
+                _entry_clear(&entry);
             }
         }
         g_free(new_path);
     }
     g_dir_close(dir);
+    if (cached_entries) {
+        g_hash_table_destroy(cached_entries);
+    }
+    /* cached isn't valid after this */
+    desktop_index_replace(priv->index, applications_dir, dir_index);
     call_depth --;
 }
 
+static gboolean
+_save_index(AwnDesktopLookupCached* lookup)
+{
+    AwnDesktopLookupCachedPrivate* priv = GET_PRIVATE(lookup);
+
+    desktop_index_save(priv->index);
+    priv->save_id = 0;
+    return FALSE;
+}
+
 static void
 _data_dir_changed(DesktopAgnosticVFSFileMonitor* monitor,
                   DesktopAgnosticVFSFile* self,
@@ -214,10 +584,37 @@ _data_dir_changed(DesktopAgnosticVFSFileMonitor* monitor,
                   AwnDesktopLookupCached* lookup
                  )
 {
+    AwnDesktopLookupCachedPrivate* priv = GET_PRIVATE(lookup);
     gchar* path = desktop_agnostic_vfs_file_get_path(self);
-    if (g_file_test(path, G_FILE_TEST_IS_DIR)) {
+    gchar* dirname = g_path_get_dirname(path);
+
+    if (event == DESKTOP_AGNOSTIC_VFS_FILE_MONITOR_EVENT_CHANGED) {
+        /* edited in place, the directory's mtime doesn't change */
+        desktop_index_invalidate(priv->index, dirname);
+    } else if (event == DESKTOP_AGNOSTIC_VFS_FILE_MONITOR_EVENT_DELETED) {
+        /* the file or everything in the directory */
+        gchar* dir_prefix = g_strconcat(path, G_DIR_SEPARATOR_S, NULL);
+        for (guint i = 0; i < priv->nodes->len; i++) {
+            DesktopNode* node = _get_node(priv, i);
+            if (g_strcmp0(node->path, path) == 0 ||
+                    g_str_has_prefix(node->path, dir_prefix)) {
+                node->deleted = TRUE;
+            }
+        }
+        g_free(dir_prefix);
+    }
+    /* relist the directory the change happened in, that picks up new files
+     and subdirectories and updates the index */
+    if (priv->monitors && g_hash_table_lookup(priv->monitors, dirname)) {
+        awn_desktop_lookup_cached_add_dir(lookup, dirname);
+    } else {
         awn_desktop_lookup_cached_add_dir(lookup, path);
     }
+    if (!priv->save_id) {
+        priv->save_id = g_timeout_add_seconds(5, (GSourceFunc)_save_index, lookup);
+    }
+    g_free(dirname);
+    g_free(path);
 }
 
 static void
@@ -232,12 +629,14 @@ awn_desktop_lookup_cached_constructed(GObject* object)
         G_OBJECT_CLASS(awn_desktop_lookup_cached_parent_class)->constructed(object);
     }
 
+    /*
+     The nodes are kept in the order they are found, on the premise that
+     data dirs early in the list are more likely to have the desktop file we
+     are looking for
+     */
     system_dirs = g_get_system_data_dirs();
     for (iter = (GStrv)system_dirs; *iter; iter++) {
-        GError* error = NULL;
-        DesktopAgnosticVFSFileMonitor* monitor_vfs;
-        DesktopAgnosticVFSFile* file_vfs;
-        applications_dir = g_strdup_printf("%s/applications/", *iter);
+        applications_dir = g_build_filename(*iter, "applications", NULL);
 
         if (! g_file_test(applications_dir, G_FILE_TEST_IS_DIR)) {
             g_free(applications_dir);
@@ -245,32 +644,16 @@ awn_desktop_lookup_cached_constructed(GObject* object)
         }
 //    g_message ("Adding %s",applications_dir);
         awn_desktop_lookup_cached_add_dir(AWN_DESKTOP_LOOKUP_CACHED(object), applications_dir);
-
-        file_vfs = desktop_agnostic_vfs_file_new_for_path(applications_dir, &error);
-        if (error) {
-            g_warning("%s: Error with file monitor.  %s", __func__, error->message);
-            g_error_free(error);
-            error = NULL;
-        }
-        monitor_vfs = desktop_agnostic_vfs_file_monitor(file_vfs);
-        g_signal_connect(G_OBJECT(monitor_vfs), "changed", G_CALLBACK(_data_dir_changed), object);
-        g_object_weak_ref(object, (GWeakNotify)g_object_unref, file_vfs);
-        g_object_weak_ref(object, (GWeakNotify)g_object_unref, monitor_vfs);
         g_free(applications_dir);
     }
-    applications_dir = g_strdup_printf("%s/applications/", g_get_user_data_dir());
+    applications_dir = g_build_filename(g_get_user_data_dir(), "applications", NULL);
 //  g_message ("Adding %s",applications_dir);
     awn_desktop_lookup_cached_add_dir(AWN_DESKTOP_LOOKUP_CACHED(object), applications_dir);
     g_free(applications_dir);
 
 //  awn_desktop_lookup_cached_add_dir (AWN_DESKTOP_LOOKUP_CACHED(object),"/var/lib/menu-xdg/applications/");
 
-    /*
-     entries originally prepended in order found.  Reversing on the premise that
-     data dirs early in the list are more likely to have the desktop file we
-     are looking for
-     */
-    priv->desktop_list = g_slist_reverse(priv->desktop_list);
+    desktop_index_save(priv->index);
 }
 
 static void
@@ -308,7 +691,26 @@ awn_desktop_lookup_cached_init(AwnDesktopLookupCached* self)
                             g_str_equal,
                             g_free,
                             NULL);
-    priv->desktop_list = NULL;
+    priv->nodes = g_ptr_array_new();
+    priv->paths_hash = g_hash_table_new_full(g_str_hash,
+                       g_str_equal,
+                       g_free,
+                       NULL);
+    priv->exec_trie = NULL;
+    priv->exec_trigrams = g_hash_table_new_full(g_direct_hash,
+                          g_direct_equal,
+                          NULL,
+                          (GDestroyNotify)_trigram_list_free);
+    priv->path_trigrams = g_hash_table_new_full(g_direct_hash,
+                          g_direct_equal,
+                          NULL,
+                          (GDestroyNotify)_trigram_list_free);
+    priv->monitors = g_hash_table_new_full(g_str_hash,
+                                           g_str_equal,
+                                           g_free,
+                                           g_object_unref);
+    priv->index = desktop_index_new();
+    priv->save_id = 0;
 }
 
 AwnDesktopLookupCached*
@@ -317,70 +719,33 @@ awn_desktop_lookup_cached_new(void)
     return g_object_new(AWN_TYPE_DESKTOP_LOOKUP_CACHED, NULL);
 }
 
-static int
-_search_exec(DesktopNode* a, gchar* b)
-{
-    if (!a->exec) {
-        return -1;
-    }
-    int a_len = strlen(a->exec);
-    int b_len = strlen(b);
-    if (a_len < 3 || b_len < 3) {
-        return -1;
-    }
-    return strncmp(a->exec, b, a_len > b_len ? b_len : a_len);
-}
-
-static int
-_search_exec_sub(DesktopNode* a, gchar* b)
+/*
+ Returns the first node after *order (-1 to start at the beginning) whose
+ Exec (or path) contains needle and sets *order to it.
+ */
+static DesktopNode*
+_search_substring(AwnDesktopLookupCachedPrivate* priv, GHashTable* trigrams,
+                  gboolean exec, const gchar* needle, gint* order)
 {
-    if (!a->exec) {
-        return -1;
-    }
-    int a_len = strlen(a->exec);
-    int b_len = strlen(b);
-    if (a_len < 3 || b_len < 3) {
-        return -1;
-    }
-//  g_debug ("matching %s, %s",a->exec,b);
-    if (g_strstr_len(a->exec, -1, b)) {
-        return 0;
-    }
-    return -1;
-}
+    GArray* candidates = _trigrams_candidates(trigrams, needle);
 
-static int
-_search_path(DesktopNode* a, gchar* b)
-{
-    if (!a->path) {
-        return -1;
-    }
-    int a_len = strlen(a->path);
-    int b_len = strlen(b);
-    if (a_len < 3 || b_len < 3) {
-        return -1;
+    if (!candidates) {
+        return NULL;
     }
-    if (g_strstr_len(a->path, -1, b)) {
-        return 0;
-    }
-    return -1;
-}
+    for (guint i = 0; i < candidates->len; i++) {
+        gint candidate = g_array_index(candidates, guint, i);
+        DesktopNode* node;
 
-static int
-_search_path_base_cmp(DesktopNode* a, gchar* b)
-{
-    int result = -1;
-    if (!a->path) {
-        return result;
-    }
-    gchar* bname = g_path_get_basename(a->path);
-    int a_len = strlen(a->path);
-    int b_len = strlen(b);
-    if (a_len > 2 && b_len > 2) {
-        result = g_strcmp0(bname, b);
+        if (candidate <= *order) {
+            continue;
+        }
+        node = _get_node(priv, candidate);
+        if (strstr(exec ? node->exec : node->path, needle)) {
+            *order = candidate;
+            return node;
+        }
     }
-    g_free(bname);
-    return result;
+    return NULL;
 }
 
 const gchar*
@@ -405,9 +770,9 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
     gchar* full_cmd = NULL;
     gchar* cmd = NULL;
     gchar* cmd_basename = NULL;
-    glibtop_proc_args buf;
     gulong xid = wnck_window_get_xid(win);
-    GSList* l = NULL;
+    DesktopNode* node = NULL;
+    gint order;
     const gchar* title;
     gint  hit_method = 0;
 
@@ -443,7 +808,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
     if (class_name) {
         class_name_lwr = g_utf8_strdown(class_name, -1);
     }
-    cmd = glibtop_get_proc_args(&buf, wnck_window_get_pid(win), 1024);
+    cmd = g_strdup(get_proc_info(wnck_window_get_pid(win))->cmd);
     full_cmd = get_full_cmd_from_pid(wnck_window_get_pid(win));
     if (full_cmd) {
         g_strstrip(full_cmd);
@@ -461,12 +826,10 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
             GSList* iter;
             for (iter = desktops; iter; iter = iter->next) {
                 gchar* build_name = g_strdup_printf("%s.desktop", (gchar*)iter->data);
-                l = g_slist_find_custom(priv->desktop_list,
-                                        build_name,
-                                        (GCompareFunc)_search_path_base_cmp);
+                result = _existing(priv, (const gchar*)g_hash_table_lookup(priv->desktops_hash,
+                                   build_name));
                 g_free(build_name);
-                if (l) {
-                    result = ((DesktopNode*)(l->data))->path;
+                if (result) {
                     break;
                 }
             }
@@ -474,7 +837,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
     if (!result) {
         GSList* desktops = get_special_desktop_from_window_data(cmd,
                            res_name,
@@ -484,12 +847,10 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
             GSList* iter;
             for (iter = desktops; iter; iter = iter->next) {
                 gchar* build_name = g_strdup_printf("%s.desktop", (gchar*)iter->data);
-                l = g_slist_find_custom(priv->desktop_list,
-                                        build_name,
-                                        (GCompareFunc)_search_path_base_cmp);
+                result = _existing(priv, (const gchar*)g_hash_table_lookup(priv->desktops_hash,
+                                   build_name));
                 g_free(build_name);
-                if (l) {
-                    result = ((DesktopNode*)(l->data))->path;
+                if (result) {
                     break;
                 }
             }
@@ -497,7 +858,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     /*
      Look for the full cmd in the exec table
@@ -508,7 +869,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     /*  class name in startupwm hash table?*/
     if (!result) {
@@ -517,7 +878,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     /*  class_name_no_ext in startupwm hash table?*/
     if (!result) {
@@ -526,7 +887,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     /*res name in startup hash?*/
     if (!result) {
@@ -535,7 +896,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     /*look for %res_name%.desktop */
     if (!result) {
@@ -546,7 +907,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     /*look for res_name_no_ext in startup hash*/
     if (!result) {
@@ -555,7 +916,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     /*look for %res_name_no_ext%.desktop */
     if (!result) {
@@ -566,7 +927,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (res_name_lwr) {
@@ -576,7 +937,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (res_name_no_ext_lwr) {
@@ -586,7 +947,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (cmd) {
@@ -594,7 +955,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (cmd_basename) {
@@ -602,65 +963,60 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (full_cmd) {
-            l = g_slist_find_custom(priv->desktop_list,
-                                    full_cmd,
-                                    (GCompareFunc)_search_exec);
-            if (l) {
-                result = ((DesktopNode*)(l->data))->path;
+            order = _exec_trie_lookup_prefix(priv->exec_trie, full_cmd);
+            if (order >= 0) {
+                result = _get_node(priv, order)->path;
             }
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (full_cmd) {
-            l = g_slist_find_custom(priv->desktop_list, full_cmd, (GCompareFunc)_search_exec_sub);
-            while (l) {
-                if (g_strstr_len(title, -1, ((DesktopNode*)(l->data))->name)) {
-                    result = ((DesktopNode*)(l->data))->path;
-                }
-                l = l->next;
-                if (l) {
-                    l = g_slist_find_custom(l, full_cmd, (GCompareFunc)_search_exec_sub);
+            order = -1;
+            while ((node = _search_substring(priv, priv->exec_trigrams, TRUE,
+                                             full_cmd, &order))) {
+                if (g_strstr_len(title, -1, node->name)) {
+                    result = node->path;
                 }
             }
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (full_cmd) {
-            l = g_slist_find_custom(priv->desktop_list,
-                                    full_cmd,
-                                    (GCompareFunc)_search_exec_sub);
-            if (l) {
-                result = ((DesktopNode*)(l->data))->path;
+            order = -1;
+            node = _search_substring(priv, priv->exec_trigrams, TRUE,
+                                     full_cmd, &order);
+            if (node) {
+                result = node->path;
             }
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (cmd) {
             gchar* d_filename = g_strdup_printf("%s.desktop", cmd);
-            l = g_slist_find_custom(priv->desktop_list,
-                                    d_filename,
-                                    (GCompareFunc)_search_path);
+            order = -1;
+            node = _search_substring(priv, priv->path_trigrams, FALSE,
+                                     d_filename, &order);
             g_free(d_filename);
-            if (l) {
-                result = ((DesktopNode*)(l->data))->path;
+            if (node) {
+                result = node->path;
             }
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (cmd) {
@@ -668,7 +1024,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (res_name) {
@@ -676,7 +1032,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (res_name_lwr) {
@@ -684,7 +1040,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (res_name) {
@@ -692,7 +1048,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 
     if (!result) {
         if (res_name_lwr) {
@@ -700,7 +1056,7 @@ awn_desktop_lookup_search_by_wnck_window(AwnDesktopLookupCached* lookup, WnckWin
         }
         hit_method ++;
     }
-    result = result ? (g_file_test(result, G_FILE_TEST_EXISTS) ? result : NULL) : NULL;
+    result = _existing(priv, result);
 #ifdef DEBUG
     if (hit_method) {
         g_message("%s: Hit method = %d", __func__, hit_method);
@@ -0,0 +1,370 @@
+/*
+ * Copyright (C) 2009,2010 Rodney Cryderman <rcryderman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+/* desktop-index.c */
+
+/*
+ Reading every desktop file under every applications directory dominates the
+ startup of the taskmanager, especially with the home directory on NFS.
+
+ This index keeps what AwnDesktopLookupCached needs from every desktop file
+ in $XDG_CACHE_HOME/awn/desktop-index, grouped by directory together with
+ the mtime of the directory. A directory whose mtime didn't change is
+ replayed from the index without listing it, a changed one is listed again
+ and only the files whose mtime changed are parsed.
+
+ The file is mapped and the strings are used in place. Layout (native
+ endianness, integers unaligned):
+
+   "AWNDIDX1" stamp n_dirs
+   dir:   path mtime(gint64) n_entries
+   entry: type(guint32) no_display(guint32) mtime(gint64)
+          basename name exec startup_wm
+   string: length(guint32, G_MAXUINT32 for NULL) bytes NUL
+
+ The stamp is the list of languages, the localized names depend on it.
+ */
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "desktop-index.h"
+
+#define DESKTOP_INDEX_MAGIC "AWNDIDX1"
+
+struct _DesktopIndex {
+    gchar*        path;
+    GMappedFile*  file;
+    /* strings of the entries that weren't read from file */
+    GStringChunk* strings;
+    /* path -> DesktopIndexDir */
+    GHashTable*   dirs;
+    gboolean      dirty;
+};
+
+typedef struct {
+    const gchar* data;
+    const gchar* end;
+    gboolean     error;
+} IndexReader;
+
+static void
+_dir_free(DesktopIndexDir* dir)
+{
+    g_array_free(dir->entries, TRUE);
+    g_free(dir);
+}
+
+static gchar*
+_get_stamp(void)
+{
+    const gchar* const* languages = g_get_language_names();
+    return g_strjoinv(":", (gchar**)languages);
+}
+
+static gboolean
+_read(IndexReader* reader, gpointer dest, gsize len)
+{
+    if (reader->error || (gsize)(reader->end - reader->data) < len) {
+        reader->error = TRUE;
+        return FALSE;
+    }
+    memcpy(dest, reader->data, len);
+    reader->data += len;
+    return TRUE;
+}
+
+static guint32
+_read_uint32(IndexReader* reader)
+{
+    guint32 value = 0;
+    _read(reader, &value, sizeof(value));
+    return value;
+}
+
+static gint64
+_read_int64(IndexReader* reader)
+{
+    gint64 value = 0;
+    _read(reader, &value, sizeof(value));
+    return value;
+}
+
+static const gchar*
+_read_string(IndexReader* reader)
+{
+    guint32 len = _read_uint32(reader);
+    const gchar* str = reader->data;
+
+    if (reader->error || len == G_MAXUINT32) {
+        return NULL;
+    }
+    if ((gsize)(reader->end - reader->data) <= len || str[len] != '\0') {
+        reader->error = TRUE;
+        return NULL;
+    }
+    reader->data += len + 1;
+    return str;
+}
+
+static gboolean
+_load(DesktopIndex* index)
+{
+    IndexReader reader;
+    gchar magic[8];
+    gchar* stamp;
+    gboolean stamp_ok;
+    guint32 n_dirs;
+
+    index->file = g_mapped_file_new(index->path, FALSE, NULL);
+    if (!index->file) {
+        return FALSE;
+    }
+    reader.data = g_mapped_file_get_contents(index->file);
+    reader.end = reader.data + g_mapped_file_get_length(index->file);
+    reader.error = FALSE;
+
+    if (!_read(&reader, magic, sizeof(magic)) ||
+            memcmp(magic, DESKTOP_INDEX_MAGIC, sizeof(magic)) != 0) {
+        return FALSE;
+    }
+    stamp = _get_stamp();
+    stamp_ok = g_strcmp0(_read_string(&reader), stamp) == 0;
+    g_free(stamp);
+    if (!stamp_ok) {
+        return FALSE;
+    }
+
+    n_dirs = _read_uint32(&reader);
+    for (guint32 i = 0; i < n_dirs && !reader.error; i++) {
+        const gchar* path = _read_string(&reader);
+        DesktopIndexDir* dir = desktop_index_dir_new(_read_int64(&reader));
+        guint32 n_entries = _read_uint32(&reader);
+
+        for (guint32 j = 0; j < n_entries && !reader.error; j++) {
+            DesktopIndexEntry entry;
+            entry.type = (DesktopIndexType)_read_uint32(&reader);
+            entry.no_display = _read_uint32(&reader);
+            entry.mtime = _read_int64(&reader);
+            entry.basename = _read_string(&reader);
+            entry.name = _read_string(&reader);
+            entry.exec = _read_string(&reader);
+            entry.startup_wm = _read_string(&reader);
+            if (!entry.basename) {
+                reader.error = TRUE;
+            }
+            g_array_append_val(dir->entries, entry);
+        }
+        if (!path) {
+            reader.error = TRUE;
+        }
+        if (reader.error) {
+            _dir_free(dir);
+            break;
+        }
+        g_hash_table_insert(index->dirs, (gpointer)path, dir);
+    }
+
+    if (reader.error) {
+        g_hash_table_remove_all(index->dirs);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ Returns the index of the previous run, or an empty one if there's none or
+ it can't be used.
+ */
+DesktopIndex*
+desktop_index_new(void)
+{
+    DesktopIndex* index = g_new0(DesktopIndex, 1);
+
+    index->path = g_build_filename(g_get_user_cache_dir(), "awn",
+                                   "desktop-index", NULL);
+    index->strings = g_string_chunk_new(4096);
+    /* the keys point into the file or into strings */
+    index->dirs = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                        NULL, (GDestroyNotify)_dir_free);
+    if (!_load(index)) {
+        index->dirty = TRUE;
+    }
+    return index;
+}
+
+void
+desktop_index_free(DesktopIndex* index)
+{
+    g_hash_table_destroy(index->dirs);
+    g_string_chunk_free(index->strings);
+    if (index->file) {
+        g_mapped_file_free(index->file);
+    }
+    g_free(index->path);
+    g_free(index);
+}
+
+/* marks the directory as still in use, returns NULL if it isn't indexed */
+const DesktopIndexDir*
+desktop_index_lookup(DesktopIndex* index, const gchar* path)
+{
+    DesktopIndexDir* dir = (DesktopIndexDir*)g_hash_table_lookup(index->dirs, path);
+    if (dir) {
+        dir->seen = TRUE;
+    }
+    return dir;
+}
+
+/* makes the next lookup of the directory fail the mtime check */
+void
+desktop_index_invalidate(DesktopIndex* index, const gchar* path)
+{
+    DesktopIndexDir* dir = (DesktopIndexDir*)g_hash_table_lookup(index->dirs, path);
+    if (dir) {
+        dir->mtime = -1;
+    }
+}
+
+DesktopIndexDir*
+desktop_index_dir_new(gint64 mtime)
+{
+    DesktopIndexDir* dir = g_new0(DesktopIndexDir, 1);
+    dir->mtime = mtime;
+    dir->entries = g_array_new(FALSE, FALSE, sizeof(DesktopIndexEntry));
+    return dir;
+}
+
+static const gchar*
+_insert_string(DesktopIndex* index, const gchar* str)
+{
+    return str ? g_string_chunk_insert_const(index->strings, str) : NULL;
+}
+
+/* copies entry */
+void
+desktop_index_dir_append(DesktopIndex* index, DesktopIndexDir* dir,
+                         const DesktopIndexEntry* entry)
+{
+    DesktopIndexEntry copy = *entry;
+
+    copy.basename = _insert_string(index, entry->basename);
+    copy.name = _insert_string(index, entry->name);
+    copy.exec = _insert_string(index, entry->exec);
+    copy.startup_wm = _insert_string(index, entry->startup_wm);
+    g_array_append_val(dir->entries, copy);
+}
+
+/* takes ownership of dir */
+void
+desktop_index_replace(DesktopIndex* index, const gchar* path,
+                      DesktopIndexDir* dir)
+{
+    dir->seen = TRUE;
+    g_hash_table_replace(index->dirs,
+                         (gpointer)_insert_string(index, path), dir);
+    index->dirty = TRUE;
+}
+
+static void
+_write_uint32(GString* out, guint32 value)
+{
+    g_string_append_len(out, (const gchar*)&value, sizeof(value));
+}
+
+static void
+_write_int64(GString* out, gint64 value)
+{
+    g_string_append_len(out, (const gchar*)&value, sizeof(value));
+}
+
+static void
+_write_string(GString* out, const gchar* str)
+{
+    if (!str) {
+        _write_uint32(out, G_MAXUINT32);
+        return;
+    }
+    _write_uint32(out, strlen(str));
+    g_string_append_len(out, str, strlen(str) + 1);
+}
+
+/* writes the directories that were used in this run, if anything changed */
+void
+desktop_index_save(DesktopIndex* index)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    GString* out;
+    gchar* stamp;
+    gchar* dirname;
+    guint32 n_dirs = 0;
+    gsize n_dirs_offset;
+    GError* error = NULL;
+
+    if (!index->dirty) {
+        return;
+    }
+    index->dirty = FALSE;
+
+    dirname = g_path_get_dirname(index->path);
+    if (g_mkdir_with_parents(dirname, 0700) != 0) {
+        g_warning("Unable to create cache directory \"%s\"", dirname);
+        g_free(dirname);
+        return;
+    }
+    g_free(dirname);
+
+    out = g_string_new(DESKTOP_INDEX_MAGIC);
+    stamp = _get_stamp();
+    _write_string(out, stamp);
+    g_free(stamp);
+
+    n_dirs_offset = out->len;
+    _write_uint32(out, 0);
+
+    g_hash_table_iter_init(&iter, index->dirs);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        DesktopIndexDir* dir = (DesktopIndexDir*)value;
+        if (!dir->seen) {
+            continue;
+        }
+        _write_string(out, (const gchar*)key);
+        _write_int64(out, dir->mtime);
+        _write_uint32(out, dir->entries->len);
+        for (guint i = 0; i < dir->entries->len; i++) {
+            DesktopIndexEntry* entry = &g_array_index(dir->entries, DesktopIndexEntry, i);
+            _write_uint32(out, entry->type);
+            _write_uint32(out, entry->no_display);
+            _write_int64(out, entry->mtime);
+            _write_string(out, entry->basename);
+            _write_string(out, entry->name);
+            _write_string(out, entry->exec);
+            _write_string(out, entry->startup_wm);
+        }
+        n_dirs++;
+    }
+    memcpy(out->str + n_dirs_offset, &n_dirs, sizeof(n_dirs));
+
+    /* replaced atomically, the old file may still be mapped */
+    if (!g_file_set_contents(index->path, out->str, out->len, &error)) {
+        g_warning("Unable to write desktop index: %s", error->message);
+        g_error_free(error);
+    }
+    g_string_free(out, TRUE);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2009,2010 Rodney Cryderman <rcryderman@gmail.com>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor Boston, MA 02110-1301,  USA
+ */
+
+/* desktop-index.h */
+
+#ifndef __TASK_MANAGER_DESKTOP_INDEX_H__
+#define __TASK_MANAGER_DESKTOP_INDEX_H__
+
+#include <glib.h>
+
+typedef enum {
+    DESKTOP_INDEX_DIR,
+    DESKTOP_INDEX_FILE
+} DesktopIndexType;
+
+/* a child of an applications directory, strings are owned by the index */
+typedef struct {
+    DesktopIndexType type;
+    /* without the directory */
+    const gchar*     basename;
+    /* the rest is only set for files */
+    gint64           mtime;
+    gboolean         no_display;
+    /* localized Name, NULL if the file couldn't be used */
+    const gchar*     name;
+    /* Exec without the field codes */
+    const gchar*     exec;
+    const gchar*     startup_wm;
+} DesktopIndexEntry;
+
+typedef struct {
+    gint64   mtime;
+    /* DesktopIndexEntry, in the order they were read */
+    GArray*  entries;
+    gboolean seen;
+} DesktopIndexDir;
+
+typedef struct _DesktopIndex DesktopIndex;
+
+DesktopIndex* desktop_index_new(void);
+
+void desktop_index_free(DesktopIndex* index);
+
+const DesktopIndexDir* desktop_index_lookup(DesktopIndex* index,
+        const gchar* path);
+
+void desktop_index_invalidate(DesktopIndex* index, const gchar* path);
+
+DesktopIndexDir* desktop_index_dir_new(gint64 mtime);
+
+void desktop_index_dir_append(DesktopIndex* index, DesktopIndexDir* dir,
+                              const DesktopIndexEntry* entry);
+
+void desktop_index_replace(DesktopIndex* index, const gchar* path,
+                           DesktopIndexDir* dir);
+
+void desktop_index_save(DesktopIndex* index);
+
+#endif
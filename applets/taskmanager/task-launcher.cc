@@ -32,8 +32,6 @@
 
 #include <libdesktop-agnostic/fdo.h>
 #undef G_DISABLE_SINGLE_INCLUDES
-#include <glibtop/procargs.h>
-#include <glibtop/procuid.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <libawn/libawn.h>
@@ -697,14 +695,10 @@ _match(TaskItem* item,
     gchar*   search_result = NULL;
     gchar* id = NULL;
 
-    glibtop_proc_args buf;
-    glibtop_proc_uid buf_proc_uid;
-    glibtop_proc_uid ppid_buf_proc_uid;
+    const TaskProcInfo* proc_info;
     glong   timestamp;
     GTimeVal timeval;
     gint    result = 0;
-    gchar buffer[256];
-    gchar* client_name = NULL;
     const gchar* client_name_to_match = NULL;
     gchar* startup_wm_class = NULL;
 
@@ -726,33 +720,22 @@ _match(TaskItem* item,
                  "ignore_wm_client_name", &ignore_wm_client_name,
                  NULL);
     if (!ignore_wm_client_name) {
-        gethostname(buffer, sizeof(buffer));
-        buffer [sizeof(buffer) - 1] = '\0';
-        client_name = g_strdup(buffer);
-
         client_name_to_match = task_window_get_client_name(TASK_WINDOW(item_to_match));
-        if (!client_name_to_match) {
-            /*
-             WM_CLIENT_NAME is not necessarily set... in those case we'll assume
-             that it's the host
-             */
-            gethostname(buffer, sizeof(buffer));
-            buffer [sizeof(buffer) - 1] = '\0';
-            client_name_to_match = buffer;
-        }
-        if (g_strcmp0(client_name, client_name_to_match) != 0) {
-            g_free(client_name);
+        /*
+         WM_CLIENT_NAME is not necessarily set... in those case we'll assume
+         that it's the host
+         */
+        if (client_name_to_match &&
+                g_strcmp0(g_get_host_name(), client_name_to_match) != 0) {
             return 0;
         }
-        g_free(client_name);
     }
 
     pid = task_window_get_pid(window);
-    glibtop_get_proc_uid(&buf_proc_uid, pid);
-    glibtop_get_proc_uid(&ppid_buf_proc_uid, buf_proc_uid.ppid);
+    proc_info = get_proc_info(pid);
     g_get_current_time(&timeval);
-    cmd = glibtop_get_proc_args(&buf, pid, 1024);
-    full_cmd = get_full_cmd_from_pid(pid);
+    cmd = g_strdup(proc_info->cmd);
+    full_cmd = g_strdup(proc_info->full_cmd);
 
     task_window_get_wm_class(window, &res_name, &class_name);
     if (res_name) {
@@ -808,11 +791,11 @@ _match(TaskItem* item,
      Removing to test if they're resulting in some incorrect matches*/
     /*
     #ifdef DEBUG
-    g_debug ("ppid of window pid = %d, launch pid = %d",buf_proc_uid.ppid,priv->pid);
+    g_debug ("ppid of window pid = %d, launch pid = %d",proc_info->ppid,priv->pid);
     #endif
-    if (pid && buf_proc_uid.ppid)
+    if (pid && proc_info->ppid)
     {
-      if ( buf_proc_uid.ppid == priv->pid)
+      if ( proc_info->ppid == priv->pid)
       {
         result = 92;
         goto finished;
@@ -820,11 +803,11 @@ _match(TaskItem* item,
 
 
     #ifdef DEBUG
-    g_debug ("ppid of parent pid = %d, launch pid = %d",ppid_buf_proc_uid.ppid,priv->pid);
+    g_debug ("ppid of parent pid = %d, launch pid = %d",proc_info->parent_ppid,priv->pid);
     #endif
-    if (pid && buf_proc_uid.ppid && ppid_buf_proc_uid.ppid)
+    if (pid && proc_info->ppid && proc_info->parent_ppid)
     {
-      if ( ppid_buf_proc_uid.ppid == priv->pid)
+      if ( proc_info->parent_ppid == priv->pid)
       {
         result = 91;
         goto finished;
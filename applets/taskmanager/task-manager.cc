@@ -147,6 +147,13 @@ struct _TaskManagerPrivate {
     GtkWidget* add_icon;
     guint       add_icon_source;
 
+    /* windows opened since the last process_pending_windows () */
+    GQueue*     pending_windows;
+    guint       pending_windows_id;
+    /* set during process_pending_windows (), the icons added by it are
+     shown and refreshed once at the end */
+    gboolean    in_batch;
+    GSList*     batch_icons;
 };
 
 typedef struct {
@@ -222,6 +229,7 @@ static void task_manager_origin_changed(AwnApplet* applet,
                                         gpointer       data);
 
 static void task_manager_dispose(GObject* object);
+static void task_manager_finalize(GObject* object);
 
 static void task_manager_active_window_changed_cb(WnckScreen* screen,
         WnckWindow* previous_window,
@@ -514,7 +522,7 @@ task_manager_constructed(GObject* object)
      FIXME: ? possible config option.
      */
     g_object_set(awn_pixbuf_cache_get_default(),
-                 "max-cache-size", 32,
+                 "memory-budget", 6 * 1024 * 1024,
                  NULL);
 
     priv->desktops_table = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
@@ -648,6 +656,7 @@ task_manager_class_init(TaskManagerClass* klass)
     obj_class->set_property = task_manager_set_property;
     obj_class->get_property = task_manager_get_property;
     obj_class->dispose = task_manager_dispose;
+    obj_class->finalize = task_manager_finalize;
 
     app_class->position_changed = task_manager_position_changed;
     app_class->size_changed   = task_manager_size_changed;
@@ -760,6 +769,10 @@ task_manager_init(TaskManager* manager)
     priv->hidden_list = NULL;
     priv->add_icon_source = 0;
     priv->add_icon = NULL;
+    priv->pending_windows = g_queue_new();
+    priv->pending_windows_id = 0;
+    priv->in_batch = FALSE;
+    priv->batch_icons = NULL;
 
     wnck_set_client_type(WNCK_CLIENT_TYPE_PAGER);
 
@@ -900,6 +913,11 @@ task_manager_dispose(GObject* object)
     desktop_agnostic_config_client_unbind_all_for_object(priv->client,
             object,
             NULL);
+    if (priv->pending_windows_id) {
+        g_source_remove(priv->pending_windows_id);
+        priv->pending_windows_id = 0;
+    }
+    g_queue_clear(priv->pending_windows);
     if (priv->connection) {
         if (priv->proxy) {
             g_object_unref(priv->proxy);
@@ -924,6 +942,16 @@ task_manager_dispose(GObject* object)
     G_OBJECT_CLASS(task_manager_parent_class)->dispose(object);
 }
 
+static void
+task_manager_finalize(GObject* object)
+{
+    TaskManagerPrivate* priv = TASK_MANAGER_GET_PRIVATE(object);
+
+    g_queue_free(priv->pending_windows);
+
+    G_OBJECT_CLASS(task_manager_parent_class)->finalize(object);
+}
+
 /*
  * WNCK_SCREEN CALLBACKS
  */
@@ -1323,6 +1351,10 @@ task_manager_add_icon(TaskManager* manager, TaskIcon* icon)
                              "animation-end",
                              G_CALLBACK(on_icon_effects_ends),
                              icon);
+    if (priv->in_batch) {
+        priv->batch_icons = g_slist_append(priv->batch_icons, icon);
+        return;
+    }
     update_icon_visible(manager, TASK_ICON(icon));
     task_icon_refresh_icon(TASK_ICON(icon), awn_applet_get_size(AWN_APPLET(manager)));
 }
@@ -1425,19 +1457,15 @@ search_for_desktop(TaskIcon* icon, TaskItem* item, gboolean thorough)
     if (TASK_IS_WINDOW(item)) {
         gchar*   res_name = NULL;
         gchar*   class_name = NULL;
-        gchar*   cmd;
         gchar*   full_cmd;
-        glibtop_proc_args buf;
 
         _wnck_get_wmclass(wnck_window_get_xid(win), &res_name, &class_name);
-        cmd = glibtop_get_proc_args(&buf, wnck_window_get_pid(win), 1024);
         full_cmd = get_full_cmd_from_pid(wnck_window_get_pid(win));
         task_window_set_use_win_icon(TASK_WINDOW(item), get_win_icon_use(full_cmd,
                                      res_name,
                                      class_name,
                                      task_window_get_name(TASK_WINDOW(item))));
         g_free(full_cmd);
-        g_free(cmd);
         g_free(class_name);
         g_free(res_name);
     }
@@ -1655,6 +1683,68 @@ _wait_for_name_change_timeout(WindowOpenTimeoutData* data)
     return FALSE;
 }
 
+/*
+ Windows are opened in bursts (session restore, the initial window list,
+ an app opening a bunch of windows) and every one of them used to be matched,
+ added and shown on its own. They're now queued and handled together in an
+ idle callback that runs before GTK's resize and redraw: the class hints of
+ the whole batch are read first, then the windows are matched in the order
+ they were opened, and the new icons are shown and refreshed at the end so
+ the box is laid out once.
+ */
+static gboolean
+process_pending_windows(TaskManager* manager)
+{
+    TaskManagerPrivate* priv = manager->priv;
+    GSList* ready = NULL;
+    WnckWindow* window;
+
+    priv->pending_windows_id = 0;
+
+    /* window-closed takes closed windows out of the queue */
+    while ((window = (WnckWindow*)g_queue_pop_head(priv->pending_windows))) {
+        gchar* res_name = NULL;
+        gchar* class_name = NULL;
+
+        _wnck_get_wmclass(wnck_window_get_xid(window),
+                          &res_name, &class_name);
+        if (g_strcmp0(res_name, "awn-applet") != 0) {
+            if (get_special_wait_from_window_data(res_name,
+                                                  class_name,
+                                                  wnck_window_get_name(window))) {
+                WindowOpenTimeoutData* win_timeout_data;
+                win_timeout_data = g_malloc(sizeof(WindowOpenTimeoutData));
+                win_timeout_data->window = window;
+                win_timeout_data->manager = manager;
+                g_signal_connect(window, "name-changed", G_CALLBACK(process_window_opened), manager);
+                g_timeout_add(2000, (GSourceFunc)_wait_for_name_change_timeout, win_timeout_data);
+            } else {
+                ready = g_slist_prepend(ready, window);
+            }
+        }
+        g_free(res_name);
+        g_free(class_name);
+    }
+    ready = g_slist_reverse(ready);
+
+    priv->in_batch = TRUE;
+    for (GSList* iter = ready; iter; iter = iter->next) {
+        process_window_opened(WNCK_WINDOW(iter->data), manager);
+    }
+    priv->in_batch = FALSE;
+    g_slist_free(ready);
+
+    for (GSList* iter = priv->batch_icons; iter; iter = iter->next) {
+        update_icon_visible(manager, TASK_ICON(iter->data));
+        task_icon_refresh_icon(TASK_ICON(iter->data),
+                               awn_applet_get_size(AWN_APPLET(manager)));
+    }
+    g_slist_free(priv->batch_icons);
+    priv->batch_icons = NULL;
+
+    return FALSE;
+}
+
 /*
  * Whenever a new window gets opened it will try to place it
  * in an awn-icon or will create a new awn-icon.
@@ -1674,34 +1764,24 @@ on_window_opened(WnckScreen*    screen,
      checks for one of those cases (open office being opened with a through a
      data file is one), and if that is the situations it connect a "name-change"
      signal and defers processing till then (after 500ms it will just go ahead*/
-    gchar* res_name = NULL;
-    gchar* class_name = NULL;
-    WindowOpenTimeoutData* win_timeout_data;
+    TaskManagerPrivate* priv;
 
     g_return_if_fail(TASK_IS_MANAGER(manager));
     g_return_if_fail(WNCK_IS_WINDOW(window));
 
+    priv = manager->priv;
     if (wnck_window_is_skip_tasklist(window)) {
         return;
     }
 
-    _wnck_get_wmclass(wnck_window_get_xid(window),
-                      &res_name, &class_name);
-    if (g_strcmp0(res_name, "awn-applet") != 0) {
-        if (get_special_wait_from_window_data(res_name,
-                                              class_name,
-                                              wnck_window_get_name(window))) {
-            win_timeout_data = g_malloc(sizeof(WindowOpenTimeoutData));
-            win_timeout_data->window = window;
-            win_timeout_data->manager = manager;
-            g_signal_connect(window, "name-changed", G_CALLBACK(process_window_opened), manager);
-            g_timeout_add(2000, (GSourceFunc)_wait_for_name_change_timeout, win_timeout_data);
-        } else {
-            process_window_opened(window, manager);
-        }
+    if (!g_queue_find(priv->pending_windows, window)) {
+        g_queue_push_tail(priv->pending_windows, window);
+    }
+    if (!priv->pending_windows_id) {
+        priv->pending_windows_id = g_idle_add_full(G_PRIORITY_HIGH_IDLE,
+                                   (GSourceFunc)process_pending_windows,
+                                   manager, NULL);
     }
-    g_free(res_name);
-    g_free(class_name);
 }
 
 /*
@@ -2757,6 +2837,8 @@ task_manager_win_closed_cb(WnckScreen* screen, WnckWindow* window, TaskManager*
 
     g_return_if_fail(TASK_IS_MANAGER(manager));
     priv = manager->priv;
+    g_queue_remove(priv->pending_windows, window);
+
     win = wnck_screen_get_active_window(priv->screen);
     if (!win) {
         return;
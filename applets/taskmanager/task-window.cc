@@ -544,6 +544,12 @@ on_window_icon_changed(WnckWindow* wnckwin, TaskWindow* window)
 
     priv = window->priv;
 
+    /* wnck emits icon-changed for every change of the icon properties,
+     * even if the icon stays the same */
+    if (!_wnck_window_icon_changed(wnckwin) && priv->icon_changes) {
+        return;
+    }
+
     pixbuf = _wnck_get_icon_at_size(wnckwin, s->panel_size, s->panel_size);
 
     height = gdk_pixbuf_get_height(pixbuf);
@@ -1318,31 +1324,20 @@ _match(TaskItem* item,
      once and save in a field
      */
     if (!ignore_wm_client_name) {
-        gchar buffer[256];
-        gchar buffer_to_match[256];
         const gchar*   client_name = NULL;
         const gchar*   client_name_to_match = NULL;
 
-        /*check the client names to begin with*/
+        /*
+         check the client names to begin with. WM_CLIENT_NAME is not
+         necessarily set... in those case we'll assume that it's the host
+         */
         client_name = task_window_get_client_name(TASK_WINDOW(item));
         if (!client_name) {
-            /*
-             WM_CLIENT_NAME is not necessarily set... in those case we'll assume
-             that it's the host
-             */
-            gethostname(buffer, sizeof(buffer));
-            buffer [sizeof(buffer) - 1] = '\0';
-            client_name = buffer;
+            client_name = g_get_host_name();
         }
         client_name_to_match = task_window_get_client_name(TASK_WINDOW(item_to_match));
         if (!client_name_to_match) {
-            /*
-             WM_CLIENT_NAME is not necessarily set... in those case we'll assume
-             that it's the host
-             */
-            gethostname(buffer_to_match, sizeof(buffer_to_match));
-            buffer_to_match [sizeof(buffer_to_match) - 1] = '\0';
-            client_name_to_match = buffer_to_match;
+            client_name_to_match = g_get_host_name();
         }
 
         if (g_strcmp0(client_name, client_name_to_match) != 0) {
@@ -20,8 +20,12 @@
 #include <glib.h>
 #undef G_DISABLE_SINGLE_INCLUDES
 #include <glibtop/procargs.h>
+#include <glibtop/proctime.h>
 #include <glibtop/procuid.h>
+#include <libwnck/libwnck.h>
+#include <string.h>
 
+#include "config.h"
 #include "util.h"
 
 //#define DEBUG 1
@@ -35,8 +39,6 @@
       The various uses are kind of obvious.  Such as use by shinyswitcher. And
       use your imagination.
 
-      Special casing info should be moved into separate datafiles/db.
-
       Tool to analyze and special case windows by advanced users ala xprop
       (point and click) and analyze.
 
@@ -49,49 +51,6 @@
 
  */
 
-static gchar* generate_id_from_cmd(gchar* cmd, gchar* res_name,
-                                   gchar* class_name, gchar* title);
-
-typedef struct {
-    const gchar* exec;
-    const gchar* name;
-    const gchar* filename;
-    const gchar* id;
-} DesktopMatch;
-
-typedef struct {
-    const gchar* cmd;
-    const gchar* res_name;
-    const gchar* class_name;
-    const gchar* title;
-    const void* id;
-} WindowMatch;
-
-typedef struct {
-    const gchar* cmd;
-    const gchar* res_name;
-    const gchar* class_name;
-    const gchar* title;
-    const gchar* desktop;
-} WindowToDesktopMatch;
-
-
-typedef struct {
-    const gchar* res_name;
-    const gchar* class_name;
-    const gchar* title;
-    guint wait;
-} WindowWait;
-
-typedef struct {
-    const gchar* cmd;
-    const gchar* res_name;
-    const gchar* class_name;
-    const gchar* title;
-    const WinIconUse  use;
-} IconUse;
-
-
 const gchar* blacklist[] = {"prism",
                             NULL
                            };
@@ -100,524 +59,532 @@ const gchar* no_display_override_list[] = {"nautilus.desktop",
                                            NULL
                                           };
 
-typedef gchar* (*fn_gen_id)(const gchar*, const gchar*, const gchar*, const gchar*);
-
+/*
+ Special case rules
+
+ The rules live in window-rules.ini, every group is a rule of one of the
+ tables below. They used to be matched with g_regex_match_simple(), which
+ compiles every pattern again for every rule and every window. Now they're
+ loaded and compiled once, and for every pattern the longest literal it
+ requires (if it has one, "Prism" for "Prism" or "OpenOffice" for
+ ".*OpenOffice.*") is remembered. The literals are checked with strstr()
+ once per value, so only the rules whose literals are all present get to
+ run their regexes. The rules are still evaluated in file order.
+ */
 
-/*Assign an id to a desktop file
+#define RULES_FILE APPLETDATADIR "/taskmanager/window-rules.ini"
 
- exec field,name field,desktop filename,id
- */
-static DesktopMatch desktop_regexes[] = {
-    {".*eclipse", "[Ee]clipse", "eclipse", "Eclipse"},
-    {".*ooffice.*-writer.*", NULL, NULL, "OpenOffice-Writer"},
-    {".*ooffice.*-draw.*", NULL, NULL, "OpenOffice-Draw"},
-    {".*ooffice.*-impress.*", NULL, NULL, "OpenOffice-Impress"},
-    {".*ooffice.*-calc.*", NULL, NULL, "OpenOffice-Calc"},
-    {".*ooffice.*-math.*", NULL, NULL, "OpenOffice-Math"},
-    {".*ooffice.*-base.*", NULL, NULL, "OpenOffice-Base"},
-
-    {".*libre.*-writer.*", NULL, NULL, "LibreOffice-Writer"},
-    {".*libre.*-draw.*", NULL, NULL, "LibreOffice-Draw"},
-    {".*libre.*-impress.*", NULL, NULL, "LibreOffice-Impress"},
-    {".*libre.*-calc.*", NULL, NULL, "LibreOffice-Calc"},
-    {".*libre.*-math.*", NULL, NULL, "LibreOffice-Math"},
-    {".*libre.*-base.*", NULL, NULL, "LibreOffice-Base"},
-
-    {".*amsn.*", "aMSN", ".*amsn.*desktop.*", "aMSN"},
-    {".*prism-google-calendar", ".*Google.*Calendar.*", "prism-google-calendar", "prism-google-calendar"},
-    {".*prism-google-analytics", ".*Google.*Analytics.*", "prism-google-analytics", "prism-google-analytics"},
-    {".*prism-google-docs", ".*Google.*Docs.*", "prism-google-docs", "prism-google-docs"},
-    {".*prism-google-groups", ".*Google.*Groups.*", "prism-google-groups", "prism-google-groups"},
-    {".*prism-google-mail", ".*Google.*Mail.*", "prism-google-mail", "prism-google-mail"},
-    {".*prism-google-reader", ".*Google.*Reader.*", "prism-google-reader", "prism-google-reader"},
-    {".*prism-google-talk", ".*Google.*Talk.*", "prism-google-talk", "prism-google-talk"},
-    {"TERMINATOR", NULL, NULL, NULL}
+enum {
+    RULE_CMD,
+    RULE_RES_NAME,
+    RULE_CLASS_NAME,
+    RULE_TITLE,
+    N_RULE_FIELDS
 };
 
-/*
- cmd, res name, class name, window title, id
- */
-static  WindowMatch window_regexes[] = {
-    {".*eclipse", "\\.", "\\.", NULL, "Eclipse"},
-    {NULL, "[eE]clipse", "[eE]clipse", NULL, "Eclipse"},
-    /*Do not bother trying to parse an open office command line for the type of window*/
-    {".*prism.*google.*calendar.*", "Prism", "Navigator", ".*[Cc]alendar.*", "prism-google-calendar"},
-    {".*prism.*google.*analytics.*", "Prism", "Navigator", ".*[Aa]nalytics.*", "prism-google-analytics"},
-    {".*prism.*google.*docs.*", "Prism", "Navigator", ".*[Dd]ocs.*", "prism-google-docs"},
-    {".*prism.*google.*groups.*", "Prism", "Navigator", ".*[Gg]roups.*", "prism-google-groups"},
-    {".*prism.*google.*mail.*", "Prism", "Navigator", ".*[Mm]ail.*", "prism-google-mail"},
-    {".*prism.*google.*reader.*", "Prism", "Navigator", ".*[Rr]eader.*", "prism-google-reader"},
-    {".*prism.*google.*talk.*", "Prism", "Navigator", ".*[Tt]alk.*", "prism-google-talk"},
-
-    {NULL, "Prism", "Webrunner", NULL, generate_id_from_cmd},
-
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Writer.*", "OpenOffice-Writer"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Draw.*", "OpenOffice-Draw"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Impress.*", "OpenOffice-Impress"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Calc.*", "OpenOffice-Calc"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Math.*", "OpenOffice-Math"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Base.*", "OpenOffice-Base"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", "^Database.*Wizard$", "OpenOffice-Base"},
-
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Writer.*", "LibreOffice-Writer"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Draw.*", "LibreOffice-Draw"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Impress.*", "LibreOffice-Impress"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Calc.*", "LibreOffice-Calc"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Math.*", "LibreOffice-Math"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Base.*", "LibreOffice-Base"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", "^Database.*Wizard$", "LibreOffice-Base"},
-
-    {NULL, "Amsn", "amsn", ".*aMSN.*", "aMSN"},
-    {NULL, "Chatwindow", "container.*", ".*Buddies.*Chat.*", "aMSN"},
-    {NULL, "Chatwindow", "container.*", ".*Untitled.*[wW]indow.*", "aMSN"},
-    {NULL, "Chatwindow", "container.*", ".*Offline.*Messaging.*", "aMSN"},
-    {NULL, "Chatwindow", "container.*", NULL, "aMSN"},
-    {NULL, "Toplevel", "cfg", ".*Preferences.*-.*Config.*", "aMSN"},
-    {NULL, "Toplevel", "plugin_selector", ".*Select.*Plugins.*", "aMSN"},
-    {NULL, "Toplevel", "skin_selector", ".*Please.*select.*skin.*", "aMSN"},
-    {NULL, "Toplevel", "eventlog_hist", ".*History.*eventlog.*", "aMSN"},
-    {NULL, "Toplevel", "alarm_cfg.*", ".*Alarm.*settings.*contact.*", "aMSN"},
-    {NULL, "Toplevel", "dpbrowser", ".*Display.*Pictures.*Browser.*", "aMSN"},
-    {NULL, "Toplevel", "change_name", ".*Change.*Nick.*aMSN.*", "aMSN"},
-    {NULL, "Toplevel", "_listchoose", "Send.*File", "aMSN"},
-    {NULL, "Toplevel", "_listchoose", "Send.*Message", "aMSN"},
-    {NULL, "Toplevel", "_listchoose", "Send.*to.*Mobile.*Device", "aMSN"},
-    {NULL, "Toplevel", "_listchoose", "Send.*E-mail", "aMSN"},
-    {NULL, "Toplevel", "_listchoose", "Send.*Webcam", "aMSN"},
-    {NULL, "Toplevel", "_listchoose", "Ask.*to.*Receive.*Webcam", "aMSN"},
-    {NULL, "Toplevel", "globalnick", "Global.*Nickname", "aMSN"},
-    {NULL, "Toplevel", "addcontact", "Add.*Contact.*aMSN", "aMSN"},
-    {NULL, "Toplevel", "_listchoose", "^Delete$", "aMSN"},
-    {NULL, "Toplevel", "_listchoose", "^Properties$", "aMSN"},
-    {NULL, "Toplevel", "_listchoose", "^Properties$", "aMSN"},
-    {NULL, "Toplevel", "^dlgag$", "^Add.*Group$", "aMSN"},
-    {NULL, "Toplevel", ".*_hist$", "^History.*", "aMSN"},
-    {NULL, "Toplevel", "savecontacts", "^Options$", "aMSN"},
-    {"TERMINATOR", NULL, NULL, NULL, NULL}
+/* desktop rules use the same fields for the desktop entry */
+static const gchar* window_rule_keys[N_RULE_FIELDS] = {
+    "Cmd", "ResName", "ClassName", "Title"
 };
-
-/*
- cmd, res name, class name, title, desktop
- */
-static  WindowToDesktopMatch window_to_desktop_regexes[] = {
-    {".*eclipse.*", ".*", ".*", "eclipse", "eclipse"},
-    /*Do not bother trying to parse an open office command line for the type of window*/
-    {".*prism.*google.*calendar.*", "Prism", "Navigator", ".*[Cc]alendar.*", "prism-google-calendar"},
-    {".*prism.*google.*analytics.*", "Prism", "Navigator", ".*[Aa]nalytics.*", "prism-google-analytics"},
-    {".*prism.*google.*docs.*", "Prism", "Navigator", ".*[Dd]ocs.*", "prism-google-docs"},
-    {".*prism.*google.*groups.*", "Prism", "Navigator", ".*[Gg]roups.*", "prism-google-groups"},
-    {".*prism.*google.*mail.*", "Prism", "Navigator", ".*[Mm]ail.*", "prism-google-mail"},
-    {".*prism.*google.*reader.*", "Prism", "Navigator", ".*[Rr]eader.*", "prism-google-reader"},
-    {".*prism.*google.*talk.*", "Prism", "Navigator", ".*[Tt]alk.*", "prism-google-talk"},
-
-    /*Debian*/
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Writer.*", "openoffice.org-writer"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Draw.*", "openoffice.org-draw"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Impress.*", "openoffice.org-impress"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Calc.*", "openoffice.org-calc"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Math.*", "openoffice.org-math"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Base.*", "openoffice.org-base"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", "^Database.*Wizard$", "openoffice.org-base"},
-
-    /*Ubuntu*/
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Writer.*", "ooo-writer"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Draw.*", "ooo-draw"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Impress.*", "ooo-impress"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Calc.*", "ooo-calc"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Math.*", "ooo-math"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", ".*Base.*", "ooo-base"},
-    {".*office.*", ".*OpenOffice.*", ".*VCLSalFrame.*", "^Database.*Wizard$", "ooo-base"},
-
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Writer.*", "libreoffice3-writer"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Draw.*", "libreoffice3-draw"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Impress.*", "libreoffice3-impress"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Calc.*", "libreoffice3-calc"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Math.*", "libreoffice3-math"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", ".*Base.*", "libreoffice3-base"},
-    {".*office.*", ".*LibreOffice.*", ".*VCLSalFrame.*", "^Database.*Wizard$", "libreoffice3-base"},
-
-    {".*gimp.*", ".*Gimp.*", ".*gimp.*", ".*GNU.*Image.*Manipulation.*Program.*", "gimp"},
-    {".*system-config-printer.*applet.*py.*", ".*Applet.*py.*", ".*applet.*", ".*Print.*Status.*", "redhat-manage-print-jobs"},
-    {".*amsn", "Amsn", "amsn", ".*aMSN.*", "amsn"},
-    {NULL, "Chatwindow", "container.*", ".*Buddies.*Chat.*", "amsn"},
-    {NULL, "Chatwindow", "container.*", ".*Untitled.*window.*", "amsn"},
-    {".*linuxdcpp", "Linuxdcpp", "linuxdcpp", "LinuxDC\\+\\+", "dc++"},
-    {NULL, "tvtime", "TVWindow", "^tvtime", "net-tvtime"},
-    {NULL, "VirtualBox", NULL, ".*VirtualBox.*", "virtualbox-ose"},
-    {NULL, "VirtualBox", NULL, ".*VirtualBox.*", "virtualbox"},
-    {NULL, "[Nn]autilus", "[Nn]autilus", NULL, "nautilus"},
-    {NULL, "[Nn]autilus", "[Nn]autilus", NULL, "nautilus-browser"},
-    {NULL, "[Nn]autilus", "[Nn]autilus", NULL, "nautilus-home"},
-    {NULL, NULL, NULL, "Moovida.*Media.*Cent.*", "moovida"},
-    {"TERMINATOR", NULL, NULL, NULL, NULL}
+static const gchar* desktop_rule_keys[N_RULE_FIELDS] = {
+    "Exec", "Name", "Filename", NULL
 };
 
-static  WindowWait windows_to_wait[] = {
-    {".*OpenOffice.*", ".*VCLSalFrame.*", "^OpenOffice\\.org.*", 1000},
-    {".*LibreOffice.*", ".*VCLSalFrame.*", "^LibreOffice.*", 1000},
-    {"TERMINATOR", NULL, NULL, 0}
-};
+typedef struct {
+    /* NULL if the field isn't checked */
+    GRegex* regex;
+    /* index into RuleTable.literals of the field, -1 if there's none */
+    gint    literal;
+} RulePattern;
 
+typedef struct {
+    RulePattern fields[N_RULE_FIELDS];
+    /* id, desktop, wait or use, NULL if the rule doesn't have one */
+    gchar*      result;
+} Rule;
 
-/*
- Only set something to USE_NEVER if the app sets it to something truly, truly,
- ugly (There are multiple bug reports about just how ugly it is ), as this will
- override the display of the app window icon even when the user has configured
- taskman to always use them.  USE_ALWAYS is disregarded (for overlays) if the
- icons are sufficiently similar.
- */
-static  IconUse icon_regexes[] = {
-    {NULL, ".*OpenOffice.*", ".*VCLSalFrame.*", NULL, USE_NEVER},
-    {NULL, ".*LibreOffice.*", ".*VCLSalFrame.*", NULL, USE_NEVER},
-    {NULL, "Pidgin", "pidgin", NULL, USE_ALWAYS},
-    {".*gimp.*", ".*Gimp.*", ".*gimp.*", NULL, USE_ALWAYS},
-    {NULL, NULL, NULL, NULL, USE_DEFAULT}
+typedef struct {
+    const gchar* name;
+    const gchar** keys;
+    const gchar* result_key;
+    GArray*      rules;
+    /* distinct literals of every field */
+    GPtrArray*   literals[N_RULE_FIELDS];
+} RuleTable;
+
+enum {
+    TABLE_DESKTOP_ID,
+    TABLE_WINDOW_ID,
+    TABLE_WINDOW_DESKTOP,
+    TABLE_WINDOW_WAIT,
+    TABLE_ICON_USE,
+    N_TABLES
 };
 
+static RuleTable rule_tables[N_TABLES] = {
+    {"DesktopId", desktop_rule_keys, "Id", NULL, {NULL}},
+    {"WindowId", window_rule_keys, "Id", NULL, {NULL}},
+    {"WindowDesktop", window_rule_keys, "Desktop", NULL, {NULL}},
+    {"WindowWait", window_rule_keys, "Wait", NULL, {NULL}},
+    {"IconUse", window_rule_keys, "Use", NULL, {NULL}}
+};
 
+/*
+ Returns the longest literal a match of pattern has to contain. Only simple
+ patterns are handled, a concatenation of literals and ".*", anything else
+ returns NULL.
+ */
 static gchar*
-generate_id_from_cmd(gchar* cmd, gchar* res_name, gchar* class_name, gchar* title)
+rule_get_literal(const gchar* pattern)
 {
-    if (cmd) {
-        return g_strdup(cmd);
+    gchar** parts;
+    gchar* literal = NULL;
+
+    if (strpbrk(pattern, "|()")) {
+        return NULL;
     }
-    return NULL;
+
+    parts = g_strsplit(pattern, ".*", -1);
+    for (gchar** part = parts; *part; part++) {
+        gchar* p = *part;
+        gsize len;
+
+        if (part == parts && *p == '^') {
+            p++;
+        }
+        len = strlen(p);
+        if (!*(part + 1) && len && p[len - 1] == '$') {
+            len--;
+        }
+        if (len == 0 || strcspn(p, ".[]{}*+?^$\\") < len) {
+            continue;
+        }
+        if (!literal || len > strlen(literal)) {
+            g_free(literal);
+            literal = g_strndup(p, len);
+        }
+    }
+    g_strfreev(parts);
+
+    return literal;
 }
 
-/*
- Special Casing should NOT be used for anything but a last resort.
- Other matching algororithms are NOT used if something is special cased.
-*/
-gchar*
-get_special_id_from_desktop(DesktopAgnosticFDODesktopEntry* entry)
+static gint
+rule_table_add_literal(RuleTable* table, gint field, gchar* literal)
 {
-    /*
-     Exec,Name,filename, special_id.  If all in the first 3 match then the
-     special_id is returned.
+    GPtrArray* literals = table->literals[field];
 
-     TODO  put data into a separate file
+    for (guint i = 0; i < literals->len; i++) {
+        if (strcmp((const gchar*)g_ptr_array_index(literals, i), literal) == 0) {
+            g_free(literal);
+            return i;
+        }
+    }
+    g_ptr_array_add(literals, literal);
+    return literals->len - 1;
+}
 
-     TODO  optimize the regex handling.
-     */
+static void
+rule_table_add(RuleTable* table, GKeyFile* keyfile, const gchar* group)
+{
+    Rule rule;
+
+    for (gint field = 0; field < N_RULE_FIELDS; field++) {
+        RulePattern* pattern = &rule.fields[field];
+        const gchar* key = table->keys[field];
+        gchar* value = key ? g_key_file_get_string(keyfile, group, key, NULL) : NULL;
+        GError* error = NULL;
+
+        pattern->regex = NULL;
+        pattern->literal = -1;
+        if (!value) {
+            continue;
+        }
 
-    DesktopMatch*  iter;
-    for (iter = desktop_regexes; iter->id; iter++) {
-        gboolean  match = TRUE;
-        if (iter->exec) {
-            gchar* exec = NULL;
-            if (desktop_agnostic_fdo_desktop_entry_key_exists(entry, "Exec")) {
-                exec = desktop_agnostic_fdo_desktop_entry_get_string(entry, "Exec");
-            }
-            if (!exec) {
-                continue;
-            }
-#ifdef DEBUG
-            g_debug("%s: iter->exec = %s, exec = %s", __func__, iter->exec, exec);
-#endif
-            match = g_regex_match_simple(iter->exec, exec, 0, 0);
-            g_free(exec);
-            if (!match) {
-                continue;
+        pattern->regex = g_regex_new(value, G_REGEX_OPTIMIZE, (GRegexMatchFlags)0,
+                                     &error);
+        if (error) {
+            g_warning("%s: Invalid %s in [%s]: %s", __func__, key, group,
+                      error->message);
+            g_error_free(error);
+            g_free(value);
+            /* drop the rest of the rule */
+            for (gint i = 0; i < field; i++) {
+                if (rule.fields[i].regex) {
+                    g_regex_unref(rule.fields[i].regex);
+                }
             }
+            return;
         }
-        if (iter->name) {
-            gchar* name = NULL;
-            /*We do not want localized values*/
-            if (desktop_agnostic_fdo_desktop_entry_key_exists(entry, "Name")) {
-                name = desktop_agnostic_fdo_desktop_entry_get_string(entry, "Name");
-            } else {
-                continue;
+
+        gchar* literal = rule_get_literal(value);
+        if (literal) {
+            pattern->literal = rule_table_add_literal(table, field, literal);
+        }
+        g_free(value);
+    }
+
+    rule.result = g_key_file_get_string(keyfile, group, table->result_key, NULL);
+    g_array_append_val(table->rules, rule);
+}
+
+static void
+load_rules(void)
+{
+    static gboolean loaded = FALSE;
+    GKeyFile* keyfile;
+    GError* error = NULL;
+    gchar** groups;
+
+    if (loaded) {
+        return;
+    }
+    loaded = TRUE;
+
+    for (gint i = 0; i < N_TABLES; i++) {
+        rule_tables[i].rules = g_array_new(FALSE, FALSE, sizeof(Rule));
+        for (gint field = 0; field < N_RULE_FIELDS; field++) {
+            rule_tables[i].literals[field] = g_ptr_array_new();
+        }
+    }
+
+    keyfile = g_key_file_new();
+    if (!g_key_file_load_from_file(keyfile, RULES_FILE, G_KEY_FILE_NONE, &error)) {
+        g_warning("%s: Unable to load %s: %s", __func__, RULES_FILE,
+                  error->message);
+        g_error_free(error);
+        g_key_file_free(keyfile);
+        return;
+    }
+
+    groups = g_key_file_get_groups(keyfile, NULL);
+    for (gchar** group = groups; *group; group++) {
+        gsize len = strcspn(*group, " ");
+        gint i;
+
+        for (i = 0; i < N_TABLES; i++) {
+            if (strlen(rule_tables[i].name) == len &&
+                    strncmp(rule_tables[i].name, *group, len) == 0) {
+                break;
             }
+        }
+        if (i == N_TABLES) {
+            g_warning("%s: Unknown rule [%s]", __func__, *group);
+            continue;
+        }
+        rule_table_add(&rule_tables[i], keyfile, *group);
+    }
+    g_strfreev(groups);
+    g_key_file_free(keyfile);
+}
 
-#ifdef DEBUG
-            g_debug("%s: iter->name = %s, name = %s", __func__, iter->name, name);
-#endif
-            match = g_regex_match_simple(iter->name, name, 0, 0);
-            g_free(name);
-            if (!match) {
+/*
+ Returns the index of the first rule from *start on that matches values,
+ or -1. found caches the literal checks between calls, it has to point to
+ N_RULE_FIELDS arrays of table->literals[field]->len zeroed gint8s.
+ */
+static gint
+rule_table_match(RuleTable* table, const gchar* values[N_RULE_FIELDS],
+                 gint8* found[N_RULE_FIELDS], guint start)
+{
+    for (guint i = start; i < table->rules->len; i++) {
+        Rule* rule = &g_array_index(table->rules, Rule, i);
+        gboolean match = TRUE;
+
+        /* the cheap checks first */
+        for (gint field = 0; match && field < N_RULE_FIELDS; field++) {
+            RulePattern* pattern = &rule->fields[field];
+            if (!pattern->regex) {
                 continue;
             }
+            if (!values[field]) {
+                match = FALSE;
+            } else if (pattern->literal >= 0) {
+                gint8* state = &found[field][pattern->literal];
+                if (!*state) {
+                    const gchar* literal = (const gchar*)
+                                           g_ptr_array_index(table->literals[field], pattern->literal);
+                    *state = strstr(values[field], literal) ? 1 : -1;
+                }
+                match = *state > 0;
+            }
         }
-        if (iter->filename) {
-            DesktopAgnosticVFSFile* file = desktop_agnostic_fdo_desktop_entry_get_file(entry);
-            gchar* filename = desktop_agnostic_vfs_file_get_path(file);
-#ifdef DEBUG
-            g_debug("%s: iter->filename = %s, filename = %s", __func__, iter->filename, filename);
-#endif
-            match = g_regex_match_simple(iter->filename, filename, 0, 0);
-            g_free(filename);
-            if (!match) {
-                continue;
+        for (gint field = 0; match && field < N_RULE_FIELDS; field++) {
+            RulePattern* pattern = &rule->fields[field];
+            if (pattern->regex) {
+                match = g_regex_match(pattern->regex, values[field],
+                                      (GRegexMatchFlags)0, NULL);
             }
         }
+        if (match) {
 #ifdef DEBUG
-        g_debug("%s:  Special cased ID: '%s'", __func__, iter->id);
+            g_debug("%s: %s rule %u matched: '%s'", __func__, table->name, i,
+                    rule->result);
 #endif
-        return g_strdup(iter->id);
+            return i;
+        }
     }
-    g_assert(g_strcmp0(iter->exec, "TERMINATOR") == 0);
-    return NULL;
+    return -1;
+}
+
+#define RULE_TABLE_FOUND(table, found) \
+    G_STMT_START { \
+        for (gint field = 0; field < N_RULE_FIELDS; field++) { \
+            found[field] = g_newa(gint8, (table)->literals[field]->len + 1); \
+            memset(found[field], 0, (table)->literals[field]->len + 1); \
+        } \
+    } G_STMT_END
+
+static const Rule*
+rule_table_lookup(gint table_id, const gchar* cmd, const gchar* res_name,
+                  const gchar* class_name, const gchar* title)
+{
+    RuleTable* table = &rule_tables[table_id];
+    const gchar* values[N_RULE_FIELDS] = {cmd, res_name, class_name, title};
+    gint8* found[N_RULE_FIELDS];
+    gint i;
+
+    load_rules();
+    RULE_TABLE_FOUND(table, found);
+
+    i = rule_table_match(table, values, found, 0);
+    return i < 0 ? NULL : &g_array_index(table->rules, Rule, i);
 }
 
 /*
  Special Casing should NOT be used for anything but a last resort.
  Other matching algororithms are NOT used if something is special cased.
 */
-
 gchar*
-get_special_id_from_window_data(gchar* cmd, gchar* res_name, gchar* class_name, const gchar* title)
+get_special_id_from_desktop(DesktopAgnosticFDODesktopEntry* entry)
 {
     /*
      Exec,Name,filename, special_id.  If all in the first 3 match then the
      special_id is returned.
+     */
+    gchar* exec = NULL;
+    gchar* name = NULL;
+    gchar* filename;
+    const Rule* rule;
 
-     TODO  put data into a separate file
+    if (desktop_agnostic_fdo_desktop_entry_key_exists(entry, "Exec")) {
+        exec = desktop_agnostic_fdo_desktop_entry_get_string(entry, "Exec");
+    }
+    /*We do not want localized values*/
+    if (desktop_agnostic_fdo_desktop_entry_key_exists(entry, "Name")) {
+        name = desktop_agnostic_fdo_desktop_entry_get_string(entry, "Name");
+    }
+    filename = desktop_agnostic_vfs_file_get_path(
+                   desktop_agnostic_fdo_desktop_entry_get_file(entry));
+
+    rule = rule_table_lookup(TABLE_DESKTOP_ID, exec, name, filename, NULL);
+
+    g_free(exec);
+    g_free(name);
+    g_free(filename);
 
-     TODO  optimize the regex handling.
-     */
-    WindowMatch*  iter;
-    for (iter = window_regexes; iter->id; iter++) {
-        gboolean  match = TRUE;
-#ifdef DEBUG
-        g_debug("%s: iter->cmd = %s, cmd = %s", __func__, iter->cmd, cmd);
-#endif
-        if (iter->cmd) {
-            match = cmd && g_regex_match_simple(iter->cmd, cmd, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
-#ifdef DEBUG
-        g_debug("%s: iter->res_name = %s, res_name = %s", __func__, iter->res_name, res_name);
-#endif
-        if (iter->res_name) {
-            match = res_name && g_regex_match_simple(iter->res_name, res_name, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
-#ifdef DEBUG
-        g_debug("%s: iter->class_name = %s, class_name = %s", __func__, iter->class_name, class_name);
-#endif
-        if (iter->class_name) {
-            match = class_name && g_regex_match_simple(iter->class_name, class_name, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
-#ifdef DEBUG
-        g_debug("%s: iter->title = %s, title = %s", __func__, iter->title, title);
-#endif
-        if (iter->title) {
-            match = title && g_regex_match_simple(iter->title, title, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
 #ifdef DEBUG
-        g_debug("%s:  Special cased Window ID: '%s'", __func__, (gchar*)iter->id);
+    g_debug("%s:  Special cased ID: '%s'", __func__, rule ? rule->result : NULL);
 #endif
+    return rule ? g_strdup(rule->result) : NULL;
+}
 
-        if (iter->id && (iter->id != generate_id_from_cmd)) {
-            return g_strdup(iter->id);
-        } else if (iter->id == generate_id_from_cmd) {
-            fn_gen_id fn = iter->id;
-            /*conditional operator*/
-            return fn(iter->cmd, iter->res_name, iter->class_name, iter->title);
-        }
+/*
+ Special Casing should NOT be used for anything but a last resort.
+ Other matching algororithms are NOT used if something is special cased.
+*/
 
-    }
-    g_assert(g_strcmp0(iter->cmd, "TERMINATOR") == 0);
-    return NULL;
+gchar*
+get_special_id_from_window_data(gchar* cmd, gchar* res_name, gchar* class_name, const gchar* title)
+{
+    /* a matching rule without an id stops the search */
+    const Rule* rule = rule_table_lookup(TABLE_WINDOW_ID, cmd, res_name,
+                                         class_name, title);
+#ifdef DEBUG
+    g_debug("%s:  Special cased Window ID: '%s'", __func__, rule ? rule->result : NULL);
+#endif
+    return rule ? g_strdup(rule->result) : NULL;
 }
 
+/* the desktops are owned by the rules, only free the list */
 GSList*
 get_special_desktop_from_window_data(gchar* cmd, gchar* res_name, gchar* class_name, const gchar* title)
 {
-    /*
-     Exec,Name,filename, special_id.  If all in the first 3 match then the
-     special_id is returned.
-
-     TODO  put data into a separate file
-
-     TODO  optimize the regex handling.
-     */
+    RuleTable* table = &rule_tables[TABLE_WINDOW_DESKTOP];
+    const gchar* values[N_RULE_FIELDS] = {cmd, res_name, class_name, title};
+    gint8* found[N_RULE_FIELDS];
     GSList* result = NULL;
-    WindowToDesktopMatch*  iter;
+    gint i = -1;
+
 #ifdef DEBUG
     g_debug("%s: cmd = '%s', res = '%s', class = '%s', title = '%s'", __func__, cmd, res_name, class_name, title);
-    g_debug("%p, %p", window_to_desktop_regexes, window_to_desktop_regexes->desktop);
-#endif
-    for (iter = window_to_desktop_regexes; iter->desktop; iter++) {
-        gboolean  match = TRUE;
-        if (iter->cmd) {
-#ifdef DEBUG
-            g_debug("%s: ite 10835r->cmd = %s, cmd = %s", __func__, iter->cmd, cmd);
-#endif
-            match = cmd && g_regex_match_simple(iter->cmd, cmd, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
-        if (iter->res_name) {
-#ifdef DEBUG
-            g_debug("%s: iter->res_name = %s, res_name = %s", __func__, iter->res_name, res_name);
-#endif
-            match = res_name && g_regex_match_simple(iter->res_name, res_name, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
-#ifdef DEBUG
-        g_debug("%s: iter->class_name = %s, class_name = %s", __func__, iter->class_name, class_name);
-#endif
-        if (iter->class_name) {
-            match = class_name && g_regex_match_simple(iter->class_name, class_name, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
-#ifdef DEBUG
-        g_debug("%s: iter->title = %s, title = %s", __func__, iter->title, title);
 #endif
-        if (iter->title) {
-            match = title && g_regex_match_simple(iter->title, title, 0, 0);
-            if (!match) {
-                continue;
-            }
+    load_rules();
+    RULE_TABLE_FOUND(table, found);
+
+    while ((i = rule_table_match(table, values, found, i + 1)) >= 0) {
+        Rule* rule = &g_array_index(table->rules, Rule, i);
+        if (rule->result) {
+            result = g_slist_append(result, rule->result);
         }
-#ifdef DEBUG
-        g_debug("%s:  Special cased desktop: '%s'", __func__, iter->desktop);
-#endif
-        result = g_slist_append(result, (gchar*)iter->desktop);
     }
-    g_assert(g_strcmp0(iter->cmd, "TERMINATOR") == 0);
     return result;
 }
 
 gboolean
 get_special_wait_from_window_data(gchar* res_name, gchar* class_name, const gchar* title)
 {
-    /*
-     Exec,Name,filename, special_id.  If all in the first 3 match then the
-     special_id is returned.
-
-     TODO  put data into a separate file
-
-     TODO  optimize the regex handling.
-     */
-    WindowWait*  iter;
     if (!res_name && !class_name) {
         return TRUE;
     }
 
-    for (iter = windows_to_wait; iter->wait; iter++) {
-        gboolean  match = TRUE;
-#ifdef DEBUG
-        g_debug("%s: iter->res_name = %s, res_name = %s", __func__, iter->res_name, res_name);
-#endif
-        if (iter->res_name) {
-            match = res_name && g_regex_match_simple(iter->res_name, res_name, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
-#ifdef DEBUG
-        g_debug("%s: iter->class_name = %s, class_name = %s", __func__, iter->class_name, class_name);
-#endif
-        if (iter->class_name) {
-            match = class_name && g_regex_match_simple(iter->class_name, class_name, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
-#ifdef DEBUG
-        g_debug("%s: iter->title = %s, title = %s", __func__, iter->title, title);
-#endif
-        if (iter->title) {
-            match = title && g_regex_match_simple(iter->title, title, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
-#ifdef DEBUG
-        g_debug("%s:  Special Wait Window ID:", __func__);
-#endif
-        return TRUE;
-    }
-    g_assert(g_strcmp0(iter->res_name, "TERMINATOR") == 0);
-    return FALSE;
+    return rule_table_lookup(TABLE_WINDOW_WAIT, NULL, res_name,
+                             class_name, title) != NULL;
 }
 
+/*
+ Only set something to never if the app sets it to something truly, truly,
+ ugly (There are multiple bug reports about just how ugly it is ), as this will
+ override the display of the app window icon even when the user has configured
+ taskman to always use them.  always is disregarded (for overlays) if the
+ icons are sufficiently similar.
+ */
 WinIconUse
 get_win_icon_use(gchar* cmd, gchar* res_name, gchar* class_name, const gchar* title)
 {
-    IconUse*  iter;
-    for (iter = icon_regexes; iter->use != USE_DEFAULT; iter++) {
-        gboolean  match = TRUE;
-#ifdef DEBUG
-        g_debug("%s: iter->cmd = %s, cmd = %s", __func__, iter->cmd, cmd);
-#endif
-        if (iter->cmd) {
-            match = cmd && g_regex_match_simple(iter->cmd, cmd, 0, 0);
-            if (!match) {
-                continue;
-            }
-        }
+    const Rule* rule = rule_table_lookup(TABLE_ICON_USE, cmd, res_name,
+                                         class_name, title);
+    if (!rule || !rule->result) {
+        return USE_DEFAULT;
+    }
 #ifdef DEBUG
-        g_debug("%s: iter->res_name = %s, res_name = %s", __func__, iter->res_name, res_name);
+    g_debug("%s: setting to %s for %s", __func__, rule->result, title);
 #endif
-        if (iter->res_name) {
-            match = res_name && g_regex_match_simple(iter->res_name, res_name, 0, 0);
-            if (!match) {
-                continue;
-            }
+    if (g_strcmp0(rule->result, "never") == 0) {
+        return USE_NEVER;
+    } else if (g_strcmp0(rule->result, "always") == 0) {
+        return USE_ALWAYS;
+    }
+    return USE_DEFAULT;
+}
+
+/*
+ Process information cache
+
+ Matching windows to launchers and desktop files needs the command line and
+ the parents of the window's process, which were read from /proc for every
+ launcher and every window. They're now read once per process and dropped
+ when the last window of the process closes. The start time of the process
+ is checked when a window of a known pid opens, so reused pids are noticed.
+ */
+static GHashTable* proc_infos = NULL;
+
+static void
+proc_info_free(TaskProcInfo* info)
+{
+    g_free(info->cmd);
+    g_free(info->full_cmd);
+    g_free(info);
+}
+
+static guint64
+get_proc_start_time(gint pid)
+{
+    glibtop_proc_time buf;
+
+    glibtop_get_proc_time(&buf, pid);
+    return buf.start_time;
+}
+
+static gboolean
+pid_has_other_windows(gint pid, WnckWindow* window)
+{
+    GList* iter;
+
+    for (iter = wnck_screen_get_windows(wnck_screen_get_default());
+            iter; iter = iter->next) {
+        if (iter->data != window &&
+                wnck_window_get_pid(WNCK_WINDOW(iter->data)) == pid) {
+            return TRUE;
         }
-#ifdef DEBUG
-        g_debug("%s: iter->class_name = %s, class_name = %s", __func__, iter->class_name, class_name);
-#endif
-        if (iter->class_name) {
-            match = class_name && g_regex_match_simple(iter->class_name, class_name, 0, 0);
-            if (!match) {
-                continue;
-            }
+    }
+    return FALSE;
+}
+
+static void
+on_proc_window_opened(WnckScreen* screen, WnckWindow* window, gpointer data)
+{
+    gint pid = wnck_window_get_pid(window);
+    TaskProcInfo* info;
+
+    info = (TaskProcInfo*)g_hash_table_lookup(proc_infos, GINT_TO_POINTER(pid));
+    if (info && !pid_has_other_windows(pid, window) &&
+            info->start_time != get_proc_start_time(pid)) {
+        g_hash_table_remove(proc_infos, GINT_TO_POINTER(pid));
+    }
+}
+
+static void
+on_proc_window_closed(WnckScreen* screen, WnckWindow* window, gpointer data)
+{
+    gint pid = wnck_window_get_pid(window);
+
+    if (!pid_has_other_windows(pid, window)) {
+        g_hash_table_remove(proc_infos, GINT_TO_POINTER(pid));
+    }
+}
+
+const TaskProcInfo*
+get_proc_info(gint pid)
+{
+    static TaskProcInfo no_info = { 0, 0, 0, NULL, NULL };
+    TaskProcInfo* info;
+
+    if (pid <= 0) {
+        return &no_info;
+    }
+
+    if (!proc_infos) {
+        proc_infos = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+                                           (GDestroyNotify)proc_info_free);
+        g_signal_connect(wnck_screen_get_default(), "window-opened",
+                         G_CALLBACK(on_proc_window_opened), NULL);
+        g_signal_connect(wnck_screen_get_default(), "window-closed",
+                         G_CALLBACK(on_proc_window_closed), NULL);
+    }
+
+    info = (TaskProcInfo*)g_hash_table_lookup(proc_infos, GINT_TO_POINTER(pid));
+    if (!info) {
+        glibtop_proc_args buf;
+        glibtop_proc_uid buf_proc_uid;
+        gchar** cmd_argv;
+
+        info = g_new0(TaskProcInfo, 1);
+
+        cmd_argv = glibtop_get_proc_argv(&buf, pid, 1024);
+        if (cmd_argv && cmd_argv[0]) {
+            info->cmd = g_strdup(cmd_argv[0]);
+            info->full_cmd = g_strjoinv(" ", cmd_argv);
         }
-#ifdef DEBUG
-        g_debug("%s: iter->title = %s, title = %s", __func__, iter->title, title);
-#endif
-        if (iter->title) {
-            match = title && g_regex_match_simple(iter->title, title, 0, 0);
-            if (!match) {
-                continue;
-            }
+        g_strfreev(cmd_argv);
+
+        glibtop_get_proc_uid(&buf_proc_uid, pid);
+        info->ppid = buf_proc_uid.ppid;
+        if (info->ppid > 0) {
+            glibtop_get_proc_uid(&buf_proc_uid, info->ppid);
+            info->parent_ppid = buf_proc_uid.ppid;
         }
-#ifdef DEBUG
-        g_debug("%s: setting to %d for %s", __func__, iter->use, title);
-#endif
-        return iter->use;
+        info->start_time = get_proc_start_time(pid);
+
+        g_hash_table_insert(proc_infos, GINT_TO_POINTER(pid), info);
     }
-    return USE_DEFAULT;
+    return info;
 }
 
 gchar*
 get_full_cmd_from_pid(gint pid)
 {
-    gchar*    full_cmd = NULL;
-    gchar**   cmd_argv;
-    glibtop_proc_args buf;
-    gchar* temp;
-
-    cmd_argv = glibtop_get_proc_argv(&buf, pid, 1024);
-    if (cmd_argv) {
-        gchar** iter;
-        for (iter = cmd_argv; *iter; iter++) {
-            temp = full_cmd;
-            full_cmd = g_strdup_printf("%s%s%s", full_cmd ? full_cmd : "", full_cmd ? " " : "", *iter);
-            g_free(temp);
-        }
-    }
-    g_strfreev(cmd_argv);
-    return full_cmd;
+    return g_strdup(get_proc_info(pid)->full_cmd);
 }
 
 
@@ -33,6 +33,21 @@ GSList* get_special_desktop_from_window_data(gchar* cmd, gchar* res_name,
         gchar* class_name,
         const gchar* title);
 
+/* information about a process, see get_proc_info () */
+typedef struct {
+    gint     ppid;
+    /* ppid of the parent */
+    gint     parent_ppid;
+    guint64  start_time;
+    /* the first argument */
+    gchar*   cmd;
+    /* all arguments separated by spaces */
+    gchar*   full_cmd;
+} TaskProcInfo;
+
+/* cached until the last window of the process is closed, don't free */
+const TaskProcInfo* get_proc_info(gint pid);
+
 gchar* get_full_cmd_from_pid(gint pid);
 
 gboolean check_no_display_override(const gchar* fname);
@@ -333,14 +333,9 @@ argbdata_to_pixdata(gulong* argb_data, int len, guchar** pixdata)
 
 static gboolean
 read_rgb_icon(Window xwindow,
-              int ideal_width,
-              int ideal_height,
-              int ideal_mini_width,
-              int ideal_mini_height,
               int* width,
               int* height,
-              guchar** pixdata,
-              int* mini_width, int* mini_height, guchar** mini_pixdata)
+              guchar** pixdata)
 {
     Atom type;
     int format;
@@ -350,8 +345,6 @@ read_rgb_icon(Window xwindow,
     gulong* data;
     gulong* best;
     int w, h;
-    gulong* best_mini;
-    int mini_w, mini_h;
 
     _wnck_error_trap_push();
     type = None;
@@ -374,15 +367,8 @@ read_rgb_icon(Window xwindow,
         return FALSE;
     }
 
-    if (!find_best_size(data, nitems,
-                        ideal_width, ideal_height, &w, &h, &best)) {
-        XFree(data);
-        return FALSE;
-    }
-
-    if (!find_best_size(data, nitems,
-                        ideal_mini_width, ideal_mini_height,
-                        &mini_w, &mini_h, &best_mini)) {
+    /* the largest one, smaller sizes are scaled from it */
+    if (!find_best_size(data, nitems, -1, -1, &w, &h, &best)) {
         XFree(data);
         return FALSE;
     }
@@ -390,11 +376,7 @@ read_rgb_icon(Window xwindow,
     *width = w;
     *height = h;
 
-    *mini_width = mini_w;
-    *mini_height = mini_h;
-
     argbdata_to_pixdata(best, w * h, pixdata);
-    argbdata_to_pixdata(best_mini, mini_w * mini_h, mini_pixdata);
 
     XFree(data);
 
@@ -575,11 +557,7 @@ _wnck_gdk_pixbuf_get_from_pixmap(GdkPixbuf* dest,
 static gboolean
 try_pixmap_and_mask(Pixmap src_pixmap,
                     Pixmap src_mask,
-                    GdkPixbuf** iconp,
-                    int ideal_width,
-                    int ideal_height,
-                    GdkPixbuf** mini_iconp,
-                    int ideal_mini_width, int ideal_mini_height)
+                    GdkPixbuf** iconp)
 {
     GdkPixbuf* unscaled = NULL;
     GdkPixbuf* mask = NULL;
@@ -616,22 +594,7 @@ try_pixmap_and_mask(Pixmap src_pixmap,
     }
 
     if (unscaled) {
-        *iconp =
-            gdk_pixbuf_scale_simple(unscaled,
-                                    ideal_width > 0 ? ideal_width :
-                                    gdk_pixbuf_get_width(unscaled),
-                                    ideal_height > 0 ? ideal_height :
-                                    gdk_pixbuf_get_height(unscaled),
-                                    GDK_INTERP_BILINEAR);
-        *mini_iconp =
-            gdk_pixbuf_scale_simple(unscaled,
-                                    ideal_mini_width > 0 ? ideal_mini_width :
-                                    gdk_pixbuf_get_width(unscaled),
-                                    ideal_mini_height > 0 ? ideal_mini_height :
-                                    gdk_pixbuf_get_height(unscaled),
-                                    GDK_INTERP_BILINEAR);
-
-        g_object_unref(G_OBJECT(unscaled));
+        *iconp = unscaled;
         return TRUE;
     } else {
         return FALSE;
@@ -710,10 +673,9 @@ struct _WnckIconCache {
 
 
 static GdkPixbuf*
-scaled_from_pixdata(guchar* pixdata, int w, int h, int new_w, int new_h)
+pixbuf_from_pixdata(guchar* pixdata, int w, int h)
 {
     GdkPixbuf* src;
-    GdkPixbuf* dest;
 
     src = gdk_pixbuf_new_from_data(pixdata,
                                    GDK_COLORSPACE_RGB,
@@ -743,47 +705,23 @@ scaled_from_pixdata(guchar* pixdata, int w, int h, int new_w, int new_h)
         }
     }
 
-    if (w != new_w || h != new_h) {
-        dest = gdk_pixbuf_scale_simple(src, new_w, new_h, GDK_INTERP_BILINEAR);
-
-        g_object_unref(G_OBJECT(src));
-    } else {
-        dest = src;
-    }
-
-    return dest;
+    return src;
 }
 
-static gboolean
-_wnck_read_icons_(Window xwindow,
-                  GtkWidget* icon_cache,
-                  GdkPixbuf** iconp,
-                  int ideal_width,
-                  int ideal_height,
-                  GdkPixbuf** mini_iconp,
-                  int ideal_mini_width, int ideal_mini_height)
+/* reads the largest icon of the window, unscaled */
+static GdkPixbuf*
+_wnck_read_icon(Window xwindow)
 {
     guchar* pixdata;
     int w, h;
-    guchar* mini_pixdata;
-    int mini_w, mini_h;
     Pixmap pixmap;
     Pixmap mask;
     XWMHints* hints;
+    GdkPixbuf* icon = NULL;
 
-    *iconp = NULL;
-    *mini_iconp = NULL;
     pixdata = NULL;
-    if (read_rgb_icon(xwindow,
-                      ideal_width, ideal_height,
-                      ideal_mini_width, ideal_mini_height,
-                      &w, &h, &pixdata, &mini_w, &mini_h, &mini_pixdata)) {
-        *iconp = scaled_from_pixdata(pixdata, w, h, ideal_width, ideal_height);
-
-        *mini_iconp = scaled_from_pixdata(mini_pixdata, mini_w, mini_h,
-                                          ideal_mini_width, ideal_mini_height);
-
-        return TRUE;
+    if (read_rgb_icon(xwindow, &w, &h, &pixdata)) {
+        return pixbuf_from_pixdata(pixdata, w, h);
     }
 
 
@@ -805,48 +743,178 @@ _wnck_read_icons_(Window xwindow,
     }
 
 
-    if (try_pixmap_and_mask(pixmap, mask,
-                            iconp, ideal_width, ideal_height,
-                            mini_iconp, ideal_mini_width, ideal_mini_height)) {
-        return TRUE;
+    if (try_pixmap_and_mask(pixmap, mask, &icon)) {
+        return icon;
     }
 
     get_kwm_win_icon(xwindow, &pixmap, &mask);
 
-    if (try_pixmap_and_mask(pixmap, mask,
-                            iconp, ideal_width, ideal_height,
-                            mini_iconp, ideal_mini_width, ideal_mini_height)) {
-        return TRUE;
+    if (try_pixmap_and_mask(pixmap, mask, &icon)) {
+        return icon;
     }
-    return FALSE;
+    return NULL;
 }
 
+/*
+ * Per window icon cache
+ *
+ * _NET_WM_ICON can be huge and some windows (browsers, chat clients) change
+ * it often, so the largest icon of every window is decoded only once, the
+ * scaled variants are kept as well. The icon is read again only when wnck
+ * reports a change of the icon properties and the scaled variants are
+ * dropped only if the pixels really changed.
+ */
+typedef struct {
+    /* largest icon of the window, NULL if it doesn't have any */
+    GdkPixbuf*  icon;
+    guint32     hash;
+    /* size (width << 16 | height) -> scaled GdkPixbuf */
+    GHashTable* scaled;
+} WindowIcon;
+
+/* XID -> WindowIcon */
+static GHashTable* window_icons = NULL;
+
+static void
+window_icon_free(WindowIcon* wicon)
+{
+    if (wicon->icon) {
+        g_object_unref(wicon->icon);
+    }
+    g_hash_table_destroy(wicon->scaled);
+    g_free(wicon);
+}
+
+static void
+on_icon_window_closed(WnckScreen* screen, WnckWindow* window, gpointer data)
+{
+    g_hash_table_remove(window_icons,
+                        GSIZE_TO_POINTER(wnck_window_get_xid(window)));
+}
+
+static guint32
+pixbuf_hash(GdkPixbuf* pixbuf)
+{
+    guint32 hash = 2166136261U;
+
+    if (!pixbuf) {
+        return 0;
+    }
+
+    gint width = gdk_pixbuf_get_width(pixbuf);
+    gint height = gdk_pixbuf_get_height(pixbuf);
+    gint rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+    gint row_len = width * gdk_pixbuf_get_n_channels(pixbuf);
+    const guchar* pixels = gdk_pixbuf_get_pixels(pixbuf);
+
+    /* FNV-1a */
+    hash = (hash ^ width) * 16777619U;
+    hash = (hash ^ height) * 16777619U;
+    for (gint y = 0; y < height; y++) {
+        const guchar* row = pixels + y * rowstride;
+        for (gint x = 0; x < row_len; x++) {
+            hash = (hash ^ row[x]) * 16777619U;
+        }
+    }
+    return hash;
+}
+
+static WindowIcon*
+get_window_icon(WnckWindow* window)
+{
+    gulong xid = wnck_window_get_xid(window);
+    WindowIcon* wicon;
+
+    if (!window_icons) {
+        /* XIDs fit into 32 bits */
+        window_icons = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                             NULL,
+                                             (GDestroyNotify)window_icon_free);
+        g_signal_connect(wnck_screen_get_default(), "window-closed",
+                         G_CALLBACK(on_icon_window_closed), NULL);
+    }
+
+    wicon = (WindowIcon*)g_hash_table_lookup(window_icons,
+                                             GSIZE_TO_POINTER(xid));
+    if (!wicon) {
+        wicon = g_new0(WindowIcon, 1);
+        wicon->icon = _wnck_read_icon(xid);
+        wicon->hash = pixbuf_hash(wicon->icon);
+        wicon->scaled = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                              NULL, g_object_unref);
+        g_hash_table_insert(window_icons, GSIZE_TO_POINTER(xid), wicon);
+    }
+    return wicon;
+}
+
+/*
+ * Rereads the icon of @window, returns TRUE if the icon really changed.
+ * Should be called when wnck emits WnckWindow::icon-changed.
+ */
+gboolean
+_wnck_window_icon_changed(WnckWindow* window)
+{
+    gulong xid = wnck_window_get_xid(window);
+    GdkPixbuf* icon;
+    guint32 hash;
+    WindowIcon* wicon;
+
+    if (!window_icons ||
+            !g_hash_table_lookup(window_icons, GSIZE_TO_POINTER(xid))) {
+        get_window_icon(window);
+        return TRUE;
+    }
+
+    wicon = get_window_icon(window);
+    icon = _wnck_read_icon(xid);
+    hash = pixbuf_hash(icon);
+
+    if ((icon == NULL) == (wicon->icon == NULL) && hash == wicon->hash) {
+        if (icon) {
+            g_object_unref(icon);
+        }
+        return FALSE;
+    }
+
+    if (wicon->icon) {
+        g_object_unref(wicon->icon);
+    }
+    wicon->icon = icon;
+    wicon->hash = hash;
+    g_hash_table_remove_all(wicon->scaled);
+
+    return TRUE;
+}
 
 GdkPixbuf*
 _wnck_get_icon_at_size(WnckWindow* window,
                        gint        width,
                        gint        height)
 {
-    GdkPixbuf* icon, *icon_scaled, *mini_icon;
-    gboolean res;
-
-    icon = NULL;
-    icon_scaled = NULL;
-    mini_icon = NULL;
+    GdkPixbuf* icon, *icon_scaled;
+    WindowIcon* wicon = get_window_icon(window);
 
-    res = _wnck_read_icons_(wnck_window_get_xid(window),
-                            NULL,
-                            &icon, width, width,
-                            &mini_icon, 24, 24);
+    if (wicon->icon) {
+        gpointer key = GINT_TO_POINTER(width << 16 | height);
 
-    if (res) {
-        if (mini_icon) {
-            g_object_unref(mini_icon);
-        }
+        icon_scaled = (GdkPixbuf*)g_hash_table_lookup(wicon->scaled, key);
+        if (!icon_scaled) {
+            gint w = gdk_pixbuf_get_width(wicon->icon);
+            gint h = gdk_pixbuf_get_height(wicon->icon);
 
-        if (icon) {
-            return icon;
+            if (w == width && h == height) {
+                icon_scaled = GDK_PIXBUF(g_object_ref(wicon->icon));
+            } else {
+                /* bilinear loses too much detail when shrinking large
+                 * icons, it's done only once per size, so use hyper */
+                icon_scaled = gdk_pixbuf_scale_simple(wicon->icon, width, height,
+                                                      w > width * 2 || h > height * 2 ?
+                                                      GDK_INTERP_HYPER :
+                                                      GDK_INTERP_BILINEAR);
+            }
+            g_hash_table_insert(wicon->scaled, key, icon_scaled);
         }
+        return GDK_PIXBUF(g_object_ref(icon_scaled));
     }
 
     icon = wnck_window_get_icon(window);
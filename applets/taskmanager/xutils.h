@@ -44,6 +44,9 @@ _wnck_get_icon_at_size(WnckWindow* window,
                        gint        width,
                        gint        height);
 
+gboolean
+_wnck_window_icon_changed(WnckWindow* window);
+
 GdkPixbuf*
 xutils_get_named_icon(const gchar* icon_name,
                       gint         width,
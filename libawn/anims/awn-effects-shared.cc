@@ -21,8 +21,11 @@ gboolean
 awn_effect_force_timeout(AwnEffectsAnimation* anim,
                          const gint timeout, GSourceFunc func)
 {
+    /* steps of the new timer are timeout ms long, but they're still
+     * driven by the elapsed time */
     AwnEffectsPrivate* priv = anim->effects->priv;
-    priv->timer_id = g_timeout_add(timeout, func, anim);
+    priv->timer_id = awn_effects_schedule_animation(anim->effects, func, anim,
+                                                    timeout);
     return FALSE;
 }
 
@@ -31,6 +31,58 @@ typedef enum {
 
 typedef struct _AwnEffectsAnimation AwnEffectsAnimation;
 
+/* everything the composited icon depends on besides the painted content,
+ * compared with memcmp, so always zero it before filling
+ */
+typedef struct {
+    guint content_serial;
+    guint props_serial;
+
+    gint window_width, window_height;
+    gint icon_width, icon_height;
+
+    gint position;
+    gint icon_offset;
+    gint refl_offset;
+    gint border_clip;
+    gint arrows_count;
+    gfloat icon_alpha;
+    gfloat refl_alpha;
+    gfloat progress;
+    gboolean do_reflection;
+    gboolean make_shadow;
+    gboolean is_active;
+    gboolean depressed;
+
+    gdouble side_offset;
+    gdouble top_offset;
+    gdouble curve_offset;
+    gfloat width_mod;
+    gfloat height_mod;
+    GtkAllocation clip_region;
+    gdouble rotate_degrees;
+    gfloat alpha;
+    gfloat spotlight_alpha;
+    gfloat saturation;
+    gfloat glow_amount;
+    gint icon_depth;
+    gint icon_depth_direction;
+    gboolean clip;
+    gboolean flip;
+    gboolean spotlight;
+    gboolean simple_rect;
+} AwnEffectsCacheKey;
+
+/* image surfaces kept by every AwnEffects instance, see
+ * awn_effects_get_scratch_surface()
+ */
+typedef enum {
+    AWN_EFFECTS_SCRATCH_TARGET,
+    AWN_EFFECTS_SCRATCH_TEMP,
+
+    AWN_EFFECTS_SCRATCH_LAST
+} AwnEffectsScratch;
+
 struct _AwnEffectsAnimation {
     AwnEffects* effects;
     AwnEffect this_effect;
@@ -43,6 +95,9 @@ struct _AwnEffectsPrivate {
     GList* overlays;
 
     GSourceFunc sleeping_func;
+    GSourceFunc animation_func;
+    gdouble animation_time;
+    gdouble animation_step;
 
     gint icon_width, icon_height;
     gint window_width, window_height;
@@ -86,6 +141,16 @@ struct _AwnEffectsPrivate {
 
     guint timer_id;
     gboolean already_exposed;
+
+    /* result of the last render, replayed if nothing changed */
+    cairo_surface_t* cache_surface;
+    AwnEffectsCacheKey cache_key;
+    guint cache_props_serial;
+    guint cache_content_serial;
+
+    /* post-ops run on an image surface uploaded once at the end */
+    gboolean image_paint;
+    cairo_surface_t* scratch_surfaces[AWN_EFFECTS_SCRATCH_LAST];
 };
 
 typedef enum {
@@ -135,6 +200,14 @@ gboolean awn_effect_force_timeout(AwnEffectsAnimation* anim,
                                   const gint timeout,
                                   GSourceFunc func);
 
+guint awn_effects_schedule_animation(AwnEffects* fx,
+                                     GSourceFunc func,
+                                     AwnEffectsAnimation* anim,
+                                     guint interval);
+
+cairo_surface_t* awn_effects_get_scratch_surface(AwnEffects* fx,
+                                                 AwnEffectsScratch which);
+
 void awn_effect_emit_anim_start(AwnEffectsAnimation* anim);
 void awn_effect_emit_anim_end(AwnEffectsAnimation* anim);
 
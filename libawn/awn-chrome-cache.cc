@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2009 Michal Hruby <michal.mhr@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* awn-chrome-cache.c */
+
+/*
+    The frame of a tooltip is a filled and outlined rounded rectangle, which
+    only differs from one size to another in the length of its straight
+    edges. A frame is therefore rendered once into a small surface holding
+    the corners and a single pixel of every edge, and painted nine-slice
+    style: the corners as they are, the edges and the middle stretched.
+    Frames are shared by everything in the process using the same radius,
+    line width and colours.
+
+    Shape masks are kept for the last few sizes, tooltips keep changing
+    between a handful of sizes as their text changes.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "awn-chrome-cache.h"
+#include "awn-cairo-utils.h"
+
+#define MASK_CACHE_SIZE 8
+
+typedef struct {
+    gdouble  radius;
+    gdouble  line_width;
+    gdouble  bg[4];
+    gdouble  outline[4];
+    gboolean has_outline;
+} AwnChromeFrameKey;
+
+struct _AwnChromeFrame {
+    /* needs to be the first member, it's the key in the frames table */
+    AwnChromeFrameKey key;
+    gint              ref_count;
+    /* size of the corner slices, the surface is 2 * corner + 1 wide */
+    gint              corner;
+    cairo_surface_t*  surface;
+};
+
+typedef struct {
+    gint       width;
+    gint       height;
+    gdouble    radius;
+    GdkBitmap* mask;
+} AwnChromeMask;
+
+/* AwnChromeFrameKey -> AwnChromeFrame */
+static GHashTable* frames = NULL;
+/* AwnChromeMask, most recently used first */
+static GList* masks = NULL;
+
+static guint
+_frame_key_hash(gconstpointer key)
+{
+    const guchar* data = (const guchar*)key;
+    guint hash = 2166136261u;
+
+    for (gsize i = 0; i < sizeof(AwnChromeFrameKey); i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static gboolean
+_frame_key_equal(gconstpointer a, gconstpointer b)
+{
+    return memcmp(a, b, sizeof(AwnChromeFrameKey)) == 0;
+}
+
+static void
+_frame_draw(const AwnChromeFrameKey* key, cairo_t* cr,
+            gdouble width, gdouble height)
+{
+    cairo_set_line_width(cr, key->line_width);
+    cairo_set_source_rgba(cr, key->bg[0], key->bg[1], key->bg[2], key->bg[3]);
+
+    awn_cairo_rounded_rect(cr, 0, 0, width, height, key->radius, ROUND_ALL);
+
+    if (key->has_outline) {
+        cairo_fill_preserve(cr);
+        cairo_set_source_rgba(cr, key->outline[0], key->outline[1],
+                              key->outline[2], key->outline[3]);
+        cairo_stroke(cr);
+    } else {
+        cairo_fill(cr);
+    }
+}
+
+/* the caller owns the returned reference */
+AwnChromeFrame*
+awn_chrome_frame_get(gdouble radius, gdouble line_width,
+                     DesktopAgnosticColor* bg, DesktopAgnosticColor* outline)
+{
+    AwnChromeFrameKey key;
+    AwnChromeFrame* frame;
+    cairo_t* cr;
+    gint size;
+
+    g_return_val_if_fail(bg, NULL);
+
+    /* the padding would take part in the comparisons */
+    memset(&key, 0, sizeof(key));
+    key.radius = radius;
+    key.line_width = line_width;
+    desktop_agnostic_color_get_cairo_color(bg, &key.bg[0], &key.bg[1],
+                                           &key.bg[2], &key.bg[3]);
+    if (outline) {
+        key.has_outline = TRUE;
+        desktop_agnostic_color_get_cairo_color(outline, &key.outline[0],
+                                               &key.outline[1],
+                                               &key.outline[2],
+                                               &key.outline[3]);
+    }
+
+    if (!frames) {
+        frames = g_hash_table_new(_frame_key_hash, _frame_key_equal);
+    }
+
+    frame = (AwnChromeFrame*)g_hash_table_lookup(frames, &key);
+    if (frame) {
+        frame->ref_count++;
+        return frame;
+    }
+
+    frame = g_new0(AwnChromeFrame, 1);
+    frame->key = key;
+    frame->ref_count = 1;
+    /* the arc and the antialiasing of the outline */
+    frame->corner = (gint)ceil(radius + line_width) + 1;
+
+    size = frame->corner * 2 + 1;
+    frame->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, size, size);
+    cr = cairo_create(frame->surface);
+    _frame_draw(&frame->key, cr, size, size);
+    cairo_destroy(cr);
+
+    g_hash_table_insert(frames, &frame->key, frame);
+
+    return frame;
+}
+
+void
+awn_chrome_frame_unref(AwnChromeFrame* frame)
+{
+    g_return_if_fail(frame);
+
+    if (--frame->ref_count > 0) {
+        return;
+    }
+
+    g_hash_table_remove(frames, &frame->key);
+    cairo_surface_destroy(frame->surface);
+    g_free(frame);
+}
+
+static void
+_paint_slice(AwnChromeFrame* frame, cairo_t* cr,
+             gint src_x, gint src_y, gint src_w, gint src_h,
+             gint x, gint y, gint w, gint h)
+{
+    cairo_pattern_t* pattern;
+
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+
+    cairo_save(cr);
+
+    cairo_rectangle(cr, x, y, w, h);
+    cairo_clip(cr);
+
+    cairo_translate(cr, x, y);
+    cairo_scale(cr, w / (gdouble)src_w, h / (gdouble)src_h);
+    cairo_set_source_surface(cr, frame->surface, -src_x, -src_y);
+
+    /* the stretched slices are a single pixel, don't blend them with their
+     * neighbours */
+    pattern = cairo_get_source(cr);
+    cairo_pattern_set_filter(pattern, CAIRO_FILTER_NEAREST);
+    cairo_pattern_set_extend(pattern, CAIRO_EXTEND_PAD);
+
+    cairo_paint(cr);
+
+    cairo_restore(cr);
+}
+
+/* paints the frame at (0, 0) with the current operator */
+void
+awn_chrome_frame_paint(AwnChromeFrame* frame, cairo_t* cr,
+                       gint width, gint height)
+{
+    g_return_if_fail(frame);
+
+    const gint c = frame->corner;
+
+    if (width < c * 2 + 1 || height < c * 2 + 1) {
+        /* too small for the slices, the radius would be clamped anyway */
+        cairo_save(cr);
+        _frame_draw(&frame->key, cr, width, height);
+        cairo_restore(cr);
+        return;
+    }
+
+    const gint src_pos[3] = { 0, c, c + 1 };
+    const gint src_size[3] = { c, 1, c };
+    const gint x_pos[3] = { 0, c, width - c };
+    const gint x_size[3] = { c, width - c * 2, c };
+    const gint y_pos[3] = { 0, c, height - c };
+    const gint y_size[3] = { c, height - c * 2, c };
+
+    for (gint i = 0; i < 3; i++) {
+        for (gint j = 0; j < 3; j++) {
+            _paint_slice(frame, cr,
+                         src_pos[j], src_pos[i], src_size[j], src_size[i],
+                         x_pos[j], y_pos[i], x_size[j], y_size[i]);
+        }
+    }
+}
+
+/* Returns a mask of a rounded rectangle covering the whole size, the caller
+ * owns the returned reference and mustn't draw on it.
+ */
+GdkBitmap*
+awn_chrome_get_rounded_mask(gint width, gint height, gdouble radius)
+{
+    AwnChromeMask* entry;
+    GdkBitmap* mask;
+    cairo_t* cr;
+
+    for (GList* iter = masks; iter; iter = iter->next) {
+        entry = (AwnChromeMask*)iter->data;
+        if (entry->width == width && entry->height == height &&
+                entry->radius == radius) {
+            masks = g_list_remove_link(masks, iter);
+            masks = g_list_concat(iter, masks);
+            return (GdkBitmap*)g_object_ref(entry->mask);
+        }
+    }
+
+    mask = (GdkBitmap*) gdk_pixmap_new(NULL, width, height, 1);
+    if (!mask) {
+        return NULL;
+    }
+
+    cr = gdk_cairo_create(mask);
+
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    cairo_translate(cr, 0.5, 0.5);
+
+    awn_cairo_rounded_rect(cr, 0, 0, width, height, radius, ROUND_ALL);
+    cairo_fill(cr);
+
+    cairo_destroy(cr);
+
+    entry = g_new(AwnChromeMask, 1);
+    entry->width = width;
+    entry->height = height;
+    entry->radius = radius;
+    entry->mask = (GdkBitmap*)g_object_ref(mask);
+    masks = g_list_prepend(masks, entry);
+
+    if (g_list_length(masks) > MASK_CACHE_SIZE) {
+        GList* last = g_list_last(masks);
+        entry = (AwnChromeMask*)last->data;
+        g_object_unref(entry->mask);
+        g_free(entry);
+        masks = g_list_delete_link(masks, last);
+    }
+
+    return mask;
+}
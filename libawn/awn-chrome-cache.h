@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2009 Michal Hruby <michal.mhr@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* awn-chrome-cache.h */
+
+#ifndef _AWN_CHROME_CACHE
+#define _AWN_CHROME_CACHE
+
+#include <gtk/gtk.h>
+#include <libdesktop-agnostic/desktop-agnostic.h>
+
+/* Cached frames and shape masks of AwnTooltip and AwnDialog */
+
+typedef struct _AwnChromeFrame AwnChromeFrame;
+
+AwnChromeFrame* awn_chrome_frame_get(gdouble radius,
+                                     gdouble line_width,
+                                     DesktopAgnosticColor* bg,
+                                     DesktopAgnosticColor* outline);
+
+void awn_chrome_frame_unref(AwnChromeFrame* frame);
+
+void awn_chrome_frame_paint(AwnChromeFrame* frame, cairo_t* cr,
+                            gint width, gint height);
+
+GdkBitmap* awn_chrome_get_rounded_mask(gint width, gint height,
+                                       gdouble radius);
+
+#endif /* _AWN_CHROME_CACHE */
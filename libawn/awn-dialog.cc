@@ -47,6 +47,20 @@ extern "C" {
     AWN_TYPE_DIALOG, \
     AwnDialogPrivate))
 
+/* what the rendered chrome and the shape mask depend on, besides the colours.
+ * Compared with memcmp, clear it before filling it in. */
+typedef struct {
+    gint width, height;
+    GtkPositionType position;
+    gint padding;
+    /* -1 if there's no arrow */
+    gint arrow_x;
+    /* the rest is only used for the chrome, -1 if there's no titlebar */
+    gint title_height;
+    gboolean composited;
+    GdkColor title_fg;
+} AwnDialogChromeKey;
+
 struct _AwnDialogPrivate {
     GtkWidget* hbox;
     GtkWidget* title;
@@ -86,6 +100,12 @@ struct _AwnDialogPrivate {
     gint a_old_x, a_old_y, a_old_w, a_old_h;
 
     gint last_x, last_y;
+
+    /* everything but the children, see awn_dialog_paint_chrome() */
+    cairo_surface_t* chrome;
+    AwnDialogChromeKey chrome_key;
+    GdkBitmap* mask;
+    AwnDialogChromeKey mask_key;
 };
 
 enum {
@@ -128,6 +148,18 @@ static void awn_dialog_refresh_position(AwnDialog* dialog,
 static void awn_dialog_set_masks(GtkWidget* widget,
                                  gint width, gint height);
 
+/* the colours aren't part of AwnDialogChromeKey */
+static void
+awn_dialog_invalidate_chrome(AwnDialog* dialog)
+{
+    AwnDialogPrivate* priv = AWN_DIALOG_GET_PRIVATE(dialog);
+
+    if (priv->chrome) {
+        cairo_surface_destroy(priv->chrome);
+        priv->chrome = NULL;
+    }
+}
+
 static void
 _on_alpha_screen_changed(GtkWidget* pWidget,
                          GdkScreen* pOldScreen,
@@ -179,9 +211,12 @@ _on_window_state_event(GtkWidget* dialog, GdkEventWindowState* event)
     return FALSE;
 }
 
-static void
-awn_dialog_paint_border_path(AwnDialog* dialog, cairo_t* cr,
-                             gint width, gint height)
+/* Returns the position of the arrow point along the edge facing the anchor,
+ * in the coordinates awn_dialog_paint_border_path() rotates to, or -1 if
+ * there's no arrow.
+ */
+static gint
+awn_dialog_get_arrow_x(AwnDialog* dialog, gint width, gint height)
 {
     AwnDialogPrivate* priv = AWN_DIALOG_GET_PRIVATE(dialog);
 
@@ -191,33 +226,81 @@ awn_dialog_paint_border_path(AwnDialog* dialog, cairo_t* cr,
     /* FIXME: mhr3: I couldn't get the shape mask to work in non-composited env,
      *  so I disabled the arrow painting there, anyone feel free to fix it :)
      */
-    if (priv->anchor && priv->anchored &&
+    if (!(priv->anchor && priv->anchored &&
             gtk_widget_get_window(priv->anchor) &&
-            gtk_widget_is_composited(GTK_WIDGET(dialog))) {
-        GdkPoint arrow;
-        GdkPoint a_center_point = { .x = 0, .y = 0 };
-        GdkPoint o_center_point = { .x = 0, .y = 0 };
-        gint temp, aw = 0, ah = 0;
-        GdkWindow* win;
-
-        /* Calculate position of the arrow point
-         *   1) get anchored window center point in root window coordinates
-         *   2) get our origin in root window coordinates
-         *   3) calc the difference (which is different for each position)
-         */
-        win = gtk_widget_get_window(priv->anchor);
-        g_return_if_fail(win);
+            gtk_widget_is_composited(GTK_WIDGET(dialog)))) {
+        return -1;
+    }
 
-        gdk_window_get_origin(win, &a_center_point.x, &a_center_point.y);
-        gdk_drawable_get_size(GDK_DRAWABLE(win), &aw, &ah);
+    GdkPoint a_center_point = { .x = 0, .y = 0 };
+    GdkPoint o_center_point = { .x = 0, .y = 0 };
+    gint temp, arrow_x, aw = 0, ah = 0;
+    GdkWindow* win;
 
-        a_center_point.x += aw / 2;
-        a_center_point.y += ah / 2;
+    /* Calculate position of the arrow point
+     *   1) get anchored window center point in root window coordinates
+     *   2) get our origin in root window coordinates
+     *   3) calc the difference (which is different for each position)
+     */
+    win = gtk_widget_get_window(priv->anchor);
 
-        if (gtk_widget_get_realized(GTK_WIDGET(dialog))) {
-            gdk_window_get_origin(gtk_widget_get_window(GTK_WIDGET(dialog)),
-                                  &o_center_point.x, &o_center_point.y);
-        }
+    gdk_window_get_origin(win, &a_center_point.x, &a_center_point.y);
+    gdk_drawable_get_size(GDK_DRAWABLE(win), &aw, &ah);
+
+    a_center_point.x += aw / 2;
+    a_center_point.y += ah / 2;
+
+    if (gtk_widget_get_realized(GTK_WIDGET(dialog))) {
+        gdk_window_get_origin(gtk_widget_get_window(GTK_WIDGET(dialog)),
+                              &o_center_point.x, &o_center_point.y);
+    }
+
+    switch (priv->position) {
+    case GTK_POS_LEFT:
+        temp = width;
+        width = height;
+        height = temp;
+
+        arrow_x = a_center_point.y - o_center_point.y;
+        break;
+    case GTK_POS_RIGHT:
+        temp = width;
+        width = height;
+        height = temp;
+
+        arrow_x = width - (a_center_point.y - o_center_point.y);
+        break;
+    case GTK_POS_TOP:
+        arrow_x = width - (a_center_point.x - o_center_point.x);
+        break;
+    case GTK_POS_BOTTOM:
+    default:
+        arrow_x = a_center_point.x - o_center_point.x;
+        break;
+    }
+    /* Make sure we paint the arrow in our window */
+    if (BORDER * 2 + ROUND_RADIUS > width - (BORDER * 2 + ROUND_RADIUS)) {
+        arrow_x = width / 2;
+    } else {
+        arrow_x = CLAMP(arrow_x, BORDER * 2 + ROUND_RADIUS,
+                        width - (BORDER * 2 + ROUND_RADIUS));
+    }
+
+    return arrow_x;
+}
+
+static void
+awn_dialog_paint_border_path(AwnDialog* dialog, cairo_t* cr,
+                             gint width, gint height, gint arrow_x)
+{
+    AwnDialogPrivate* priv = AWN_DIALOG_GET_PRIVATE(dialog);
+
+    const int BORDER = priv->window_padding * 3 / 4;
+    const int ROUND_RADIUS = priv->window_padding / 2;
+
+    if (arrow_x >= 0) {
+        GdkPoint arrow;
+        gint temp;
 
         switch (priv->position) {
         case GTK_POS_LEFT:
@@ -226,8 +309,6 @@ awn_dialog_paint_border_path(AwnDialog* dialog, cairo_t* cr,
             temp = width;
             width = height;
             height = temp;
-
-            arrow.x = a_center_point.y - o_center_point.y;
             break;
         case GTK_POS_RIGHT:
             cairo_translate(cr, 0.0, height);
@@ -235,27 +316,16 @@ awn_dialog_paint_border_path(AwnDialog* dialog, cairo_t* cr,
             temp = width;
             width = height;
             height = temp;
-
-            arrow.x = width - (a_center_point.y - o_center_point.y);
             break;
         case GTK_POS_TOP:
             cairo_translate(cr, width, height);
             cairo_rotate(cr, M_PI);
-
-            arrow.x = width - (a_center_point.x - o_center_point.x);
             break;
         case GTK_POS_BOTTOM:
         default:
-            arrow.x = a_center_point.x - o_center_point.x;
             break;
         }
-        /* Make sure we paint the arrow in our window */
-        if (BORDER * 2 + ROUND_RADIUS > width - (BORDER * 2 + ROUND_RADIUS)) {
-            arrow.x = width / 2;
-        } else {
-            arrow.x = CLAMP(arrow.x, BORDER * 2 + ROUND_RADIUS,
-                            width - (BORDER * 2 + ROUND_RADIUS));
-        }
+        arrow.x = arrow_x;
         arrow.y = height - BORDER;
 
         GdkPoint top_left  = { .x = BORDER, .y = BORDER };
@@ -356,30 +426,16 @@ _real_hide(GtkWidget* widget)
     }
 }
 
-static gboolean
-_expose_event(GtkWidget* widget, GdkEventExpose* expose)
+/* Paints the background, borders, titlebar and shadow, which is everything
+ * but the children. */
+static void
+awn_dialog_paint_chrome(AwnDialog* dialog, cairo_t* cr,
+                        const AwnDialogChromeKey* key)
 {
-    AwnDialog* dialog;
-    AwnDialogPrivate* priv;
-    GtkWidget* child;
-    cairo_t* cr = NULL;
+    AwnDialogPrivate* priv = dialog->priv;
     cairo_path_t* path = NULL;
-    GtkAllocation alloc;
-    gint width, height;
-
-    dialog = AWN_DIALOG(widget);
-    priv = dialog->priv;
-
-    cr = gdk_cairo_create(gtk_widget_get_window(widget));
-
-    g_return_val_if_fail(cr, FALSE);
-
-    gtk_widget_get_allocation(widget, &alloc);
-    width = alloc.width;
-    height = alloc.height;
-
-    gdk_cairo_region(cr, expose->region);
-    cairo_clip(cr);
+    const gint width = key->width;
+    const gint height = key->height;
 
     /* Clear the background to transparent */
     cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
@@ -393,7 +449,7 @@ _expose_event(GtkWidget* widget, GdkEventExpose* expose)
     /* background shading */
     awn_cairo_set_source_color(cr, priv->dialog_bg);
 
-    awn_dialog_paint_border_path(dialog, cr, width, height);
+    awn_dialog_paint_border_path(dialog, cr, width, height, key->arrow_x);
     path = cairo_copy_path(cr);
     cairo_fill(cr);
 
@@ -424,9 +480,7 @@ _expose_event(GtkWidget* widget, GdkEventExpose* expose)
     const int ROUND_RADIUS = priv->window_padding / 2;
 
     /* fill for the titlebar */
-    if (gtk_widget_get_visible(priv->title)) {
-        GtkAllocation title_alloc;
-
+    if (key->title_height >= 0) {
         cairo_save(cr);
 
         cairo_identity_matrix(cr);
@@ -434,12 +488,10 @@ _expose_event(GtkWidget* widget, GdkEventExpose* expose)
         cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
         awn_cairo_set_source_color(cr, priv->title_bg);
 
-        gtk_widget_get_allocation(priv->title, &title_alloc);
-
         const int start_x = BORDER + 2;
         const int start_y = BORDER + 2;
         const int inner_w = width - 2 * BORDER - 4;
-        const int inner_h = title_alloc.height
+        const int inner_h = key->title_height
                             + (priv->window_padding - BORDER);
         const int round_radius = priv->window_padding / 2;
 
@@ -459,7 +511,7 @@ _expose_event(GtkWidget* widget, GdkEventExpose* expose)
                                       priv->window_padding / 2, ROUND_TOP,
                                       SHADOW_RADIUS, 0.4);
 #endif
-        const GdkColor* color = &priv->title->style->fg[GTK_STATE_PRELIGHT];
+        const GdkColor* color = &key->title_fg;
         double r = color->red / 65535.0;
         double g = color->green / 65535.0;
         double b = color->blue / 65535.0;
@@ -488,7 +540,7 @@ _expose_event(GtkWidget* widget, GdkEventExpose* expose)
 
     /* draw shadow */
     // FIXME: add property to disable it? (setting padding to <= 1 will do it now)
-    if (gtk_widget_is_composited(widget) && priv->window_padding > 1) {
+    if (key->composited && priv->window_padding > 1) {
         const double SHADOW_RADIUS = MIN(priv->window_padding / 2, 15);
 
         int w, h;
@@ -524,6 +576,68 @@ _expose_event(GtkWidget* widget, GdkEventExpose* expose)
     }
 
     cairo_path_destroy(path);
+}
+
+static gboolean
+_expose_event(GtkWidget* widget, GdkEventExpose* expose)
+{
+    AwnDialog* dialog;
+    AwnDialogPrivate* priv;
+    GtkWidget* child;
+    cairo_t* cr = NULL;
+    GtkAllocation alloc;
+    AwnDialogChromeKey key;
+
+    dialog = AWN_DIALOG(widget);
+    priv = dialog->priv;
+
+    cr = gdk_cairo_create(gtk_widget_get_window(widget));
+
+    g_return_val_if_fail(cr, FALSE);
+
+    gtk_widget_get_allocation(widget, &alloc);
+
+    memset(&key, 0, sizeof(key));
+    key.width = alloc.width;
+    key.height = alloc.height;
+    key.position = priv->position;
+    key.padding = priv->window_padding;
+    key.arrow_x = awn_dialog_get_arrow_x(dialog, alloc.width, alloc.height);
+    key.title_height = -1;
+    if (gtk_widget_get_visible(priv->title)) {
+        GtkAllocation title_alloc;
+
+        gtk_widget_get_allocation(priv->title, &title_alloc);
+        key.title_height = title_alloc.height;
+        key.title_fg = priv->title->style->fg[GTK_STATE_PRELIGHT];
+        key.title_fg.pixel = 0;
+    }
+    key.composited = gtk_widget_is_composited(widget);
+
+    /* the chrome only changes with the size and the anchor, not when the
+     * children redraw */
+    if (!priv->chrome || memcmp(&key, &priv->chrome_key, sizeof(key)) != 0) {
+        cairo_t* chrome_cr;
+
+        if (priv->chrome) {
+            cairo_surface_destroy(priv->chrome);
+        }
+        priv->chrome = cairo_surface_create_similar(cairo_get_target(cr),
+                       CAIRO_CONTENT_COLOR_ALPHA,
+                       key.width, key.height);
+        chrome_cr = cairo_create(priv->chrome);
+        awn_dialog_paint_chrome(dialog, chrome_cr, &key);
+        cairo_destroy(chrome_cr);
+        priv->chrome_key = key;
+    }
+
+    gdk_cairo_region(cr, expose->region);
+    cairo_clip(cr);
+
+    /* replaces the previous contents, transparent where there's no chrome */
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cr, priv->chrome, 0, 0);
+    cairo_paint(cr);
 
     /* Clean up */
     cairo_destroy(cr);
@@ -607,10 +721,26 @@ _on_active_changed(GObject* dialog, GParamSpec* spec, gpointer null)
 static void
 awn_dialog_set_masks(GtkWidget* widget, gint width, gint height)
 {
-    GdkBitmap* shaped_bitmap;
-    shaped_bitmap = (GdkBitmap*) gdk_pixmap_new(NULL, width, height, 1);
+    AwnDialogPrivate* priv = AWN_DIALOG_GET_PRIVATE(widget);
+    AwnDialogChromeKey key;
+
+    memset(&key, 0, sizeof(key));
+    key.width = width;
+    key.height = height;
+    key.position = priv->position;
+    key.padding = priv->window_padding;
+    key.arrow_x = awn_dialog_get_arrow_x(AWN_DIALOG(widget), width, height);
+
+    /* dialogs often go back and forth between the same sizes, only
+     * rasterize the shape when it really changed */
+    if (!priv->mask || memcmp(&key, &priv->mask_key, sizeof(key)) != 0) {
+        GdkBitmap* shaped_bitmap;
+        shaped_bitmap = (GdkBitmap*) gdk_pixmap_new(NULL, width, height, 1);
+
+        if (!shaped_bitmap) {
+            return;
+        }
 
-    if (shaped_bitmap) {
         cairo_t* cr = gdk_cairo_create(shaped_bitmap);
 
         cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
@@ -619,7 +749,8 @@ awn_dialog_set_masks(GtkWidget* widget, gint width, gint height)
         cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
         cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
         cairo_translate(cr, 0.5, 0.5);
-        awn_dialog_paint_border_path(AWN_DIALOG(widget), cr, width, height);
+        awn_dialog_paint_border_path(AWN_DIALOG(widget), cr, width, height,
+                                     key.arrow_x);
 
         cairo_fill_preserve(cr);
         cairo_set_line_width(cr, 1.0);
@@ -627,15 +758,19 @@ awn_dialog_set_masks(GtkWidget* widget, gint width, gint height)
 
         cairo_destroy(cr);
 
-        if (gtk_widget_is_composited(widget)) {
-            gtk_widget_input_shape_combine_mask(widget, NULL, 0, 0);
-            gtk_widget_input_shape_combine_mask(widget, shaped_bitmap, 0, 0);
-        } else {
-            gtk_widget_shape_combine_mask(widget, NULL, 0, 0);
-            gtk_widget_shape_combine_mask(widget, shaped_bitmap, 0, 0);
+        if (priv->mask) {
+            g_object_unref(priv->mask);
         }
+        priv->mask = shaped_bitmap;
+        priv->mask_key = key;
+    }
 
-        g_object_unref(shaped_bitmap);
+    if (gtk_widget_is_composited(widget)) {
+        gtk_widget_input_shape_combine_mask(widget, NULL, 0, 0);
+        gtk_widget_input_shape_combine_mask(widget, priv->mask, 0, 0);
+    } else {
+        gtk_widget_shape_combine_mask(widget, NULL, 0, 0);
+        gtk_widget_shape_combine_mask(widget, priv->mask, 0, 0);
     }
 }
 
@@ -851,6 +986,7 @@ awn_dialog_set_property(GObject*      object,
             g_object_unref(priv->dialog_bg);
         }
         priv->dialog_bg = (DesktopAgnosticColor*)g_value_dup_object(value);
+        awn_dialog_invalidate_chrome(AWN_DIALOG(object));
         gtk_widget_queue_draw(GTK_WIDGET(object));
         break;
     case PROP_TITLE_BG:
@@ -858,6 +994,7 @@ awn_dialog_set_property(GObject*      object,
             g_object_unref(priv->title_bg);
         }
         priv->title_bg = (DesktopAgnosticColor*)g_value_dup_object(value);
+        awn_dialog_invalidate_chrome(AWN_DIALOG(object));
         gtk_widget_queue_draw(GTK_WIDGET(object));
         break;
     case PROP_BORDER:
@@ -865,6 +1002,7 @@ awn_dialog_set_property(GObject*      object,
             g_object_unref(priv->border_color);
         }
         priv->border_color = (DesktopAgnosticColor*)g_value_dup_object(value);
+        awn_dialog_invalidate_chrome(AWN_DIALOG(object));
         gtk_widget_queue_draw(GTK_WIDGET(object));
         break;
     case PROP_HILIGHT:
@@ -872,6 +1010,7 @@ awn_dialog_set_property(GObject*      object,
             g_object_unref(priv->hilight_color);
         }
         priv->hilight_color = (DesktopAgnosticColor*)g_value_dup_object(value);
+        awn_dialog_invalidate_chrome(AWN_DIALOG(object));
         gtk_widget_queue_draw(GTK_WIDGET(object));
         break;
 
@@ -948,6 +1087,13 @@ awn_dialog_finalize(GObject* object)
         priv->hilight_color = NULL;
     }
 
+    awn_dialog_invalidate_chrome(AWN_DIALOG(object));
+
+    if (priv->mask) {
+        g_object_unref(priv->mask);
+        priv->mask = NULL;
+    }
+
     G_OBJECT_CLASS(awn_dialog_parent_class)->finalize(object);
 }
 
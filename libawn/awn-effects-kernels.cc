@@ -0,0 +1,482 @@
+/*
+ *  Copyright (C) 2009 Michal Hruby <michal.mhr@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+    All the kernels use integer math only, so the vectorized versions can
+    produce exactly the same output as the plain C ones:
+
+    - blur divides by the kernel size using (sum * recip) >> 16
+    - saturation uses 8-bit fixed point weights (77, 151, 28)
+    - tint uses (a * k) >> 8 for alpha and (x + 1 + (x >> 8)) >> 8 as exact
+      division by 255 for the color channels
+
+    Only the row functions are vectorized, the loops over rows and the
+    horizontal blur pass (which is serial by nature) are shared.
+ */
+
+#include "awn-effects-kernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AWN_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+/* sums of the blur window have to fit into 16 bits */
+#define MAX_FAST_BLUR_RADIUS 128
+
+typedef struct {
+    void (*blur_alpha_v_row)(const guchar* sub_row, const guchar* add_row,
+                             guchar* dest_row, gint* sums,
+                             gint width, guint recip);
+    void (*saturate_row)(const guchar* src, guchar* dest,
+                         gint width, guint s);
+    void (*tint_row)(guchar* pixels, gint width, const guchar* color, guint k);
+} AwnKernelTable;
+
+/* --- plain C --- */
+
+static void
+blur_alpha_v_row_c(const guchar* sub_row, const guchar* add_row,
+                   guchar* dest_row, gint* sums, gint width, guint recip)
+{
+    for (gint x = 0; x < width; x++) {
+        sums[x] += add_row[x * 4 + 3] - sub_row[x * 4 + 3];
+        dest_row[x * 4 + 3] = (guchar)(((guint)sums[x] * recip) >> 16);
+    }
+}
+
+static void
+saturate_row_c(const guchar* src, guchar* dest, gint width, guint s)
+{
+    for (gint x = 0; x < width; x++, src += 4, dest += 4) {
+        guint intensity = (src[0] * 77 + src[1] * 151 + src[2] * 28) >> 8;
+
+        dest[0] = (intensity * (256 - s) + src[0] * s) >> 8;
+        dest[1] = (intensity * (256 - s) + src[1] * s) >> 8;
+        dest[2] = (intensity * (256 - s) + src[2] * s) >> 8;
+        dest[3] = src[3];
+    }
+}
+
+static void
+tint_row_c(guchar* pixels, gint width, const guchar* color, guint k)
+{
+    for (gint x = 0; x < width; x++, pixels += 4) {
+        guint a = MIN(0xFF, (pixels[3] * k) >> 8);
+
+        for (gint c = 0; c < 4; c++) {
+            guint v = color[c] * a;
+            pixels[c] = (v + 1 + (v >> 8)) >> 8;
+        }
+    }
+}
+
+#ifdef AWN_KERNELS_X86
+
+/* --- SSE2 --- */
+
+__attribute__((target("sse2")))
+static void
+blur_alpha_v_row_sse2(const guchar* sub_row, const guchar* add_row,
+                      guchar* dest_row, gint* sums, gint width, guint recip)
+{
+    const __m128i rgb_mask = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i recip_v = _mm_set1_epi32(recip);
+    gint x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(sums + x));
+        __m128i add = _mm_loadu_si128((const __m128i*)(add_row + x * 4));
+        __m128i sub = _mm_loadu_si128((const __m128i*)(sub_row + x * 4));
+        __m128i dest = _mm_loadu_si128((const __m128i*)(dest_row + x * 4));
+
+        s = _mm_add_epi32(s, _mm_srli_epi32(add, 24));
+        s = _mm_sub_epi32(s, _mm_srli_epi32(sub, 24));
+        _mm_storeu_si128((__m128i*)(sums + x), s);
+
+        /* high halves of both operands are zero */
+        __m128i alpha = _mm_slli_epi32(_mm_mulhi_epu16(s, recip_v), 24);
+        dest = _mm_or_si128(_mm_and_si128(dest, rgb_mask), alpha);
+        _mm_storeu_si128((__m128i*)(dest_row + x * 4), dest);
+    }
+
+    blur_alpha_v_row_c(sub_row + x * 4, add_row + x * 4, dest_row + x * 4,
+                       sums + x, width - x, recip);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+saturate_2px_sse2(__m128i px, __m128i weights, __m128i s, __m128i inv_s,
+                  __m128i alpha_mask)
+{
+    __m128i i = _mm_madd_epi16(px, weights);
+    i = _mm_add_epi32(i, _mm_shuffle_epi32(i, _MM_SHUFFLE(2, 3, 0, 1)));
+    i = _mm_srli_epi32(i, 8);
+    i = _mm_or_si128(i, _mm_slli_epi32(i, 16));
+
+    __m128i res = _mm_add_epi16(_mm_mullo_epi16(i, inv_s),
+                                _mm_mullo_epi16(px, s));
+    res = _mm_srli_epi16(res, 8);
+
+    return _mm_or_si128(_mm_andnot_si128(alpha_mask, res),
+                        _mm_and_si128(alpha_mask, px));
+}
+
+__attribute__((target("sse2")))
+static void
+saturate_row_sse2(const guchar* src, guchar* dest, gint width, guint s)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i weights = _mm_setr_epi16(77, 151, 28, 0, 77, 151, 28, 0);
+    const __m128i alpha_mask = _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+    const __m128i s_v = _mm_set1_epi16(s);
+    const __m128i inv_s = _mm_set1_epi16(256 - s);
+    gint x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(src + x * 4));
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+
+        lo = saturate_2px_sse2(lo, weights, s_v, inv_s, alpha_mask);
+        hi = saturate_2px_sse2(hi, weights, s_v, inv_s, alpha_mask);
+        _mm_storeu_si128((__m128i*)(dest + x * 4), _mm_packus_epi16(lo, hi));
+    }
+
+    saturate_row_c(src + x * 4, dest + x * 4, width - x, s);
+}
+
+__attribute__((target("sse2")))
+static inline __m128i
+tint_2px_sse2(__m128i px, __m128i color, __m128i k)
+{
+    const __m128i max = _mm_set1_epi16(0xFF);
+    const __m128i one = _mm_set1_epi16(1);
+
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(px, 0xFF), 0xFF);
+    a = _mm_mulhi_epu16(_mm_slli_epi16(a, 8), k);
+    a = _mm_sub_epi16(a, _mm_subs_epu16(a, max));
+
+    __m128i v = _mm_mullo_epi16(a, color);
+    v = _mm_add_epi16(_mm_add_epi16(v, one), _mm_srli_epi16(v, 8));
+    return _mm_srli_epi16(v, 8);
+}
+
+__attribute__((target("sse2")))
+static void
+tint_row_sse2(guchar* pixels, gint width, const guchar* color, guint k)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i color_v = _mm_setr_epi16(color[0], color[1], color[2], color[3],
+                                           color[0], color[1], color[2], color[3]);
+    const __m128i k_v = _mm_set1_epi16(k);
+    gint x = 0;
+
+    for (; x + 4 <= width; x += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(pixels + x * 4));
+        __m128i lo = tint_2px_sse2(_mm_unpacklo_epi8(px, zero), color_v, k_v);
+        __m128i hi = tint_2px_sse2(_mm_unpackhi_epi8(px, zero), color_v, k_v);
+
+        _mm_storeu_si128((__m128i*)(pixels + x * 4), _mm_packus_epi16(lo, hi));
+    }
+
+    tint_row_c(pixels + x * 4, width - x, color, k);
+}
+
+/* --- AVX2 --- */
+
+__attribute__((target("avx2")))
+static void
+blur_alpha_v_row_avx2(const guchar* sub_row, const guchar* add_row,
+                      guchar* dest_row, gint* sums, gint width, guint recip)
+{
+    const __m256i rgb_mask = _mm256_set1_epi32(0x00FFFFFF);
+    const __m256i recip_v = _mm256_set1_epi32(recip);
+    gint x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i*)(sums + x));
+        __m256i add = _mm256_loadu_si256((const __m256i*)(add_row + x * 4));
+        __m256i sub = _mm256_loadu_si256((const __m256i*)(sub_row + x * 4));
+        __m256i dest = _mm256_loadu_si256((const __m256i*)(dest_row + x * 4));
+
+        s = _mm256_add_epi32(s, _mm256_srli_epi32(add, 24));
+        s = _mm256_sub_epi32(s, _mm256_srli_epi32(sub, 24));
+        _mm256_storeu_si256((__m256i*)(sums + x), s);
+
+        __m256i alpha = _mm256_slli_epi32(_mm256_mulhi_epu16(s, recip_v), 24);
+        dest = _mm256_or_si256(_mm256_and_si256(dest, rgb_mask), alpha);
+        _mm256_storeu_si256((__m256i*)(dest_row + x * 4), dest);
+    }
+
+    blur_alpha_v_row_sse2(sub_row + x * 4, add_row + x * 4, dest_row + x * 4,
+                          sums + x, width - x, recip);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+saturate_2px_avx2(__m256i px, __m256i weights, __m256i s, __m256i inv_s,
+                  __m256i alpha_mask)
+{
+    __m256i i = _mm256_madd_epi16(px, weights);
+    i = _mm256_add_epi32(i, _mm256_shuffle_epi32(i, _MM_SHUFFLE(2, 3, 0, 1)));
+    i = _mm256_srli_epi32(i, 8);
+    i = _mm256_or_si256(i, _mm256_slli_epi32(i, 16));
+
+    __m256i res = _mm256_add_epi16(_mm256_mullo_epi16(i, inv_s),
+                                   _mm256_mullo_epi16(px, s));
+    res = _mm256_srli_epi16(res, 8);
+
+    return _mm256_or_si256(_mm256_andnot_si256(alpha_mask, res),
+                           _mm256_and_si256(alpha_mask, px));
+}
+
+__attribute__((target("avx2")))
+static void
+saturate_row_avx2(const guchar* src, guchar* dest, gint width, guint s)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i weights = _mm256_setr_epi16(77, 151, 28, 0, 77, 151, 28, 0,
+                                              77, 151, 28, 0, 77, 151, 28, 0);
+    const __m256i alpha_mask = _mm256_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1,
+                                                 0, 0, 0, -1, 0, 0, 0, -1);
+    const __m256i s_v = _mm256_set1_epi16(s);
+    const __m256i inv_s = _mm256_set1_epi16(256 - s);
+    gint x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(src + x * 4));
+        /* unpack and pack both work within 128-bit lanes, so the order of
+         * the pixels is preserved */
+        __m256i lo = _mm256_unpacklo_epi8(px, zero);
+        __m256i hi = _mm256_unpackhi_epi8(px, zero);
+
+        lo = saturate_2px_avx2(lo, weights, s_v, inv_s, alpha_mask);
+        hi = saturate_2px_avx2(hi, weights, s_v, inv_s, alpha_mask);
+        _mm256_storeu_si256((__m256i*)(dest + x * 4),
+                            _mm256_packus_epi16(lo, hi));
+    }
+
+    saturate_row_sse2(src + x * 4, dest + x * 4, width - x, s);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+tint_2px_avx2(__m256i px, __m256i color, __m256i k)
+{
+    const __m256i max = _mm256_set1_epi16(0xFF);
+    const __m256i one = _mm256_set1_epi16(1);
+
+    __m256i a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(px, 0xFF), 0xFF);
+    a = _mm256_mulhi_epu16(_mm256_slli_epi16(a, 8), k);
+    a = _mm256_sub_epi16(a, _mm256_subs_epu16(a, max));
+
+    __m256i v = _mm256_mullo_epi16(a, color);
+    v = _mm256_add_epi16(_mm256_add_epi16(v, one), _mm256_srli_epi16(v, 8));
+    return _mm256_srli_epi16(v, 8);
+}
+
+__attribute__((target("avx2")))
+static void
+tint_row_avx2(guchar* pixels, gint width, const guchar* color, guint k)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i color_v = _mm256_setr_epi16(
+                                color[0], color[1], color[2], color[3],
+                                color[0], color[1], color[2], color[3],
+                                color[0], color[1], color[2], color[3],
+                                color[0], color[1], color[2], color[3]);
+    const __m256i k_v = _mm256_set1_epi16(k);
+    gint x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+        __m256i px = _mm256_loadu_si256((const __m256i*)(pixels + x * 4));
+        __m256i lo = tint_2px_avx2(_mm256_unpacklo_epi8(px, zero), color_v, k_v);
+        __m256i hi = tint_2px_avx2(_mm256_unpackhi_epi8(px, zero), color_v, k_v);
+
+        _mm256_storeu_si256((__m256i*)(pixels + x * 4),
+                            _mm256_packus_epi16(lo, hi));
+    }
+
+    tint_row_sse2(pixels + x * 4, width - x, color, k);
+}
+
+#endif /* AWN_KERNELS_X86 */
+
+static const AwnKernelTable*
+awn_kernels_get_table(void)
+{
+    static AwnKernelTable table;
+    static gboolean initialized = FALSE;
+
+    if (initialized) {
+        return &table;
+    }
+
+    table.blur_alpha_v_row = blur_alpha_v_row_c;
+    table.saturate_row = saturate_row_c;
+    table.tint_row = tint_row_c;
+
+#ifdef AWN_KERNELS_X86
+    /* AWN_NO_SIMD can be used to check the plain C versions */
+    if (!g_getenv("AWN_NO_SIMD")) {
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2")) {
+            table.blur_alpha_v_row = blur_alpha_v_row_avx2;
+            table.saturate_row = saturate_row_avx2;
+            table.tint_row = tint_row_avx2;
+        } else if (__builtin_cpu_supports("sse2")) {
+            table.blur_alpha_v_row = blur_alpha_v_row_sse2;
+            table.saturate_row = saturate_row_sse2;
+            table.tint_row = tint_row_sse2;
+        }
+    }
+#endif
+
+    initialized = TRUE;
+    return &table;
+}
+
+void
+awn_kernel_blur_alpha(guchar* pixels, guchar* scratch,
+                      gint width, gint height, gint stride, gint radius)
+{
+    const AwnKernelTable* table = awn_kernels_get_table();
+    const gint kernel_size = radius * 2 + 1;
+    gint x, y, k;
+
+    if (radius <= 0 || width <= 0 || height <= 0) {
+        return;
+    }
+
+    if (radius > MAX_FAST_BLUR_RADIUS) {
+        /* the window sums wouldn't fit the fixed point math, use
+         * the plain division for such (rather theoretical) case */
+        for (y = 0; y < height; y++) {
+            guchar* row = pixels + y * stride;
+            gint total_a = row[3] * (radius + 1);
+
+            for (k = 1; k <= MIN(radius, width - 1); k++) {
+                total_a += row[k * 4 + 3];
+            }
+            for (x = 0; x < width; x++) {
+                if (x > 0) {
+                    total_a -= row[MAX(x - radius - 1, 0) * 4 + 3];
+                    total_a += row[MIN(x + radius, width - 1) * 4 + 3];
+                }
+                scratch[y * stride + x * 4 + 3] = total_a / kernel_size;
+            }
+        }
+        for (x = 0; x < width; x++) {
+            gint total_a = scratch[x * 4 + 3] * (radius + 1);
+
+            for (k = 1; k <= MIN(radius, height - 1); k++) {
+                total_a += scratch[k * stride + x * 4 + 3];
+            }
+            for (y = 0; y < height; y++) {
+                if (y > 0) {
+                    total_a -= scratch[MAX(y - radius - 1, 0) * stride + x * 4 + 3];
+                    total_a += scratch[MIN(y + radius, height - 1) * stride + x * 4 + 3];
+                }
+                pixels[y * stride + x * 4 + 3] = total_a / kernel_size;
+            }
+        }
+        return;
+    }
+
+    /* rounded up, so the sum of a full window of 0xFF still gives 0xFF;
+     * the error this adds to other sums stays below one for any kernel
+     * up to MAX_FAST_BLUR_RADIUS */
+    const guint recip = (65536 + kernel_size - 1) / kernel_size;
+
+    /* horizontal pass, pixels -> scratch */
+    for (y = 0; y < height; y++) {
+        const guchar* row = pixels + y * stride;
+        guchar* dest = scratch + y * stride;
+        guint total_a = row[3] * (radius + 1);
+
+        for (k = 1; k <= MIN(radius, width - 1); k++) {
+            total_a += row[k * 4 + 3];
+        }
+        dest[3] = (total_a * recip) >> 16;
+
+        for (x = 1; x < width; x++) {
+            total_a -= row[MAX(x - radius - 1, 0) * 4 + 3];
+            total_a += row[MIN(x + radius, width - 1) * 4 + 3];
+            dest[x * 4 + 3] = (total_a * recip) >> 16;
+        }
+    }
+
+    /* vertical pass, scratch -> pixels, done row by row with running sums
+     * for every column, so the memory is accessed sequentially */
+    gint* sums = g_new(gint, width);
+
+    for (x = 0; x < width; x++) {
+        sums[x] = scratch[x * 4 + 3] * (radius + 1);
+    }
+    for (k = 1; k <= MIN(radius, height - 1); k++) {
+        const guchar* row = scratch + k * stride;
+        for (x = 0; x < width; x++) {
+            sums[x] += row[x * 4 + 3];
+        }
+    }
+
+    for (y = 0; y < height; y++) {
+        /* first row just stores the initial sums */
+        const guchar* sub_row = scratch + MAX(y - radius - 1, 0) * stride;
+        const guchar* add_row = y == 0 ? sub_row :
+                                scratch + MIN(y + radius, height - 1) * stride;
+
+        table->blur_alpha_v_row(sub_row, add_row, pixels + y * stride,
+                                sums, width, recip);
+    }
+
+    g_free(sums);
+}
+
+void
+awn_kernel_saturate(const guchar* src, guchar* dest,
+                    gint width, gint height,
+                    gint src_stride, gint dest_stride,
+                    gfloat saturation)
+{
+    const AwnKernelTable* table = awn_kernels_get_table();
+    guint s = (guint)(CLAMP(saturation, 0.0, 1.0) * 256 + 0.5);
+
+    for (gint y = 0; y < height; y++) {
+        table->saturate_row(src + y * src_stride, dest + y * dest_stride,
+                            width, s);
+    }
+}
+
+void
+awn_kernel_tint(guchar* pixels, gint width, gint height, gint stride,
+                guchar r, guchar g, guchar b, gfloat intensity)
+{
+    const AwnKernelTable* table = awn_kernels_get_table();
+    /* CAIRO_FORMAT_ARGB32 in native endian, alpha channel is multiplied
+     * by 0xFF, so it's unchanged */
+    const guchar color[4] = { b, g, r, 0xFF };
+    guint k = (guint)(CLAMP(intensity, 0.0, 255.0) * 256 + 0.5);
+
+    k = MIN(k, 0xFFFF);
+
+    for (gint y = 0; y < height; y++) {
+        table->tint_row(pixels + y * stride, width, color, k);
+    }
+}
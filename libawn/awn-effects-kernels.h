@@ -0,0 +1,49 @@
+/*
+ *  Copyright (C) 2009 Michal Hruby <michal.mhr@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _AWN_EFFECTS_KERNELS_H
+#define _AWN_EFFECTS_KERNELS_H
+
+#include <glib.h>
+
+/* Pixel loops used by awn-effects-ops-helpers, all of them work on
+ * CAIRO_FORMAT_ARGB32 data. The implementation is picked at runtime
+ * (AVX2, SSE2 or plain C), all of them produce identical results.
+ */
+
+/* box blur of the alpha channel, @pixels get the blurred alpha (other
+ * channels are preserved), @scratch has to be at least as big as @pixels
+ */
+void
+awn_kernel_blur_alpha(guchar* pixels, guchar* scratch,
+                      gint width, gint height, gint stride, gint radius);
+
+/* moves color of the pixels towards their intensity, @saturation has to be
+ * in the [0.0, 1.0] range, @src and @dest may be the same buffer
+ */
+void
+awn_kernel_saturate(const guchar* src, guchar* dest,
+                    gint width, gint height,
+                    gint src_stride, gint dest_stride,
+                    gfloat saturation);
+
+/* multiplies alpha by @intensity and sets color of the pixels to r, g, b */
+void
+awn_kernel_tint(guchar* pixels, gint width, gint height, gint stride,
+                guchar r, guchar g, guchar b, gfloat intensity);
+
+#endif
@@ -20,6 +20,7 @@
  */
 
 #include "awn-effects-ops-helpers.h"
+#include "awn-effects-kernels.h"
 
 
 void
@@ -257,6 +258,15 @@ darken_surface(cairo_t* cr, gint surface_width, gint surface_height)
     cairo_fill(cr);
 }
 
+static gboolean
+surface_is_argb32_image(cairo_surface_t* srfc, gint width, gint height)
+{
+    return cairo_surface_get_type(srfc) == CAIRO_SURFACE_TYPE_IMAGE &&
+           cairo_image_surface_get_format(srfc) == CAIRO_FORMAT_ARGB32 &&
+           cairo_image_surface_get_width(srfc) >= width &&
+           cairo_image_surface_get_height(srfc) >= height;
+}
+
 void
 blur_surface_shadow(cairo_surface_t* src,
                     gint surface_width, gint surface_height, const int radius)
@@ -269,20 +279,29 @@ blur_surface_shadow_rgba(cairo_surface_t* src,
                          gint surface_width, gint surface_height, const int radius,
                          guchar r, guchar g, guchar b, gfloat alpha_intensity)
 {
-    guchar* pixdest, * target_pixels_dest, * target_pixels, * pixsrc;
+    guchar* target_pixels_dest, * target_pixels;
     cairo_surface_t* temp_srfc, * temp_srfc_dest;
     cairo_t*          temp_ctx, * temp_ctx_dest;
     alpha_intensity = MAX(alpha_intensity, 0.);
 
     g_return_if_fail(src);
 
-    /* the original stuff */
-    temp_srfc = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
-                                           surface_width, surface_height);
-    temp_ctx = cairo_create(temp_srfc);
-    cairo_set_operator(temp_ctx, CAIRO_OPERATOR_SOURCE);
-    cairo_set_source_surface(temp_ctx, src, 0, 0);
-    cairo_paint(temp_ctx);
+    /* image surfaces can be blurred in place, no need to copy them */
+    gboolean in_place = surface_is_argb32_image(src,
+                                                surface_width, surface_height);
+
+    if (in_place) {
+        temp_srfc = cairo_surface_reference(src);
+        temp_ctx = NULL;
+    } else {
+        /* the original stuff */
+        temp_srfc = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                               surface_width, surface_height);
+        temp_ctx = cairo_create(temp_srfc);
+        cairo_set_operator(temp_ctx, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(temp_ctx, src, 0, 0);
+        cairo_paint(temp_ctx);
+    }
 
     /* the stuff we draw to */
     temp_srfc_dest = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
@@ -300,80 +319,12 @@ blur_surface_shadow_rgba(cairo_surface_t* src,
     /* -- blur the alpha channel (color should be only black anyway) --- */
     /* Implements standard box filter, which is separable so we'll use it to
          speed up the algorithm. */
-    int total_a;
-    int x, y, kx, ky;
-    const int kernel_size = radius * 2 + 1;
-
-    for (y = 0; y < surface_height; ++y) {
-        total_a = 0;
-
-        for (x = 0; x < surface_width; ++x) {
-            // we're filtering with ones only, so we can do this extra speedup
-            if (x == 0) {
-                pixsrc = (target_pixels + y * row_stride) + 3;
-                total_a += (*pixsrc) * (radius + 1);
-
-                int kx_max = MIN(radius, surface_width - 1);
-                for (kx = 1; kx <= kx_max; kx++) {
-                    pixsrc = (target_pixels + y * row_stride) + (kx * 4) + 3;
-                    total_a += *pixsrc;
-                }
-            } else {
-                int last_pixel = MAX(x - radius - 1, 0);
-                pixsrc = (target_pixels + y * row_stride) + (last_pixel * 4) + 3;
-                total_a -= *pixsrc;
-                int next_pixel = MIN(x + radius, surface_width - 1);
-                pixsrc = (target_pixels + y * row_stride) + (next_pixel * 4) + 3;
-                total_a += *pixsrc;
-            }
-
-            pixdest = (target_pixels_dest + y * row_stride) + (x * 4) + 3;
-            *pixdest = (guchar)(total_a / kernel_size);
-        }
-    }
+    awn_kernel_blur_alpha(target_pixels, target_pixels_dest,
+                          surface_width, surface_height, row_stride, radius);
 
-    // swap src & dest
-    target_pixels_dest = cairo_image_surface_get_data(temp_srfc);
-    target_pixels = cairo_image_surface_get_data(temp_srfc_dest);
-
-    for (x = 0; x < surface_width; ++x) {
-        total_a = 0;
-
-        for (y = 0; y < surface_height; ++y) {
-            // we're filtering with ones only, so we can do this extra speedup
-            if (y == 0) {
-                pixsrc = target_pixels + (x * 4) + 3;
-                total_a += (*pixsrc) * (radius + 1);
-
-                int ky_max = MIN(radius, surface_height - 1);
-                for (ky = 1; ky <= ky_max; ky++) {
-                    pixsrc = (target_pixels + ky * row_stride) + (x * 4) + 3;
-                    total_a += *pixsrc;
-                }
-            } else {
-                int last_pixel = MAX(y - radius - 1, 0);
-                pixsrc = (target_pixels + last_pixel * row_stride) + (x * 4) + 3;
-                total_a -= *pixsrc;
-                int next_pixel = MIN(y + radius, surface_height - 1);
-                pixsrc = (target_pixels + next_pixel * row_stride) + (x * 4) + 3;
-                total_a += *pixsrc;
-            }
-
-            pixdest = (target_pixels_dest + y * row_stride) + (x * 4) + 3;
-            *pixdest = (guchar)(total_a / kernel_size);
-        }
-    }
     if ((r + g + b) > 0 || alpha_intensity != 1.) {
-        for (y = 0; y < surface_height; ++y) {
-            for (x = 0; x < surface_width; ++x) {
-                pixdest = (target_pixels_dest + y * row_stride);
-                pixdest += x * 4;
-                pixdest[3] = MIN(0xFF, pixdest[3] * alpha_intensity);
-                pixdest[2] = r * pixdest[3] / 0xFF;
-                pixdest[1] = g * pixdest[3] / 0xFF;
-                pixdest[0] = b * pixdest[3] / 0xFF;
-            }
-        }
+        awn_kernel_tint(target_pixels, surface_width, surface_height,
+                        row_stride, r, g, b, alpha_intensity);
     }
     /* ---------- */
     cairo_surface_mark_dirty(temp_srfc);
@@ -382,20 +333,103 @@ blur_surface_shadow_rgba(cairo_surface_t* src,
         cairo_destroy(temp_ctx);
     }
 
-    temp_ctx = cairo_create(src);
-    cairo_set_operator(temp_ctx, CAIRO_OPERATOR_SOURCE);
-    g_assert(cairo_get_operator(temp_ctx) == CAIRO_OPERATOR_SOURCE);
-    cairo_set_source_surface(temp_ctx, temp_srfc, 0, 0);
-    cairo_paint(temp_ctx);
+    if (!in_place) {
+        temp_ctx = cairo_create(src);
+        cairo_set_operator(temp_ctx, CAIRO_OPERATOR_SOURCE);
+        g_assert(cairo_get_operator(temp_ctx) == CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(temp_ctx, temp_srfc, 0, 0);
+        cairo_paint(temp_ctx);
+        cairo_destroy(temp_ctx);
+    }
     cairo_surface_destroy(temp_srfc);
     cairo_surface_destroy(temp_srfc_dest);
-    cairo_destroy(temp_ctx);
     cairo_destroy(temp_ctx_dest);
 }
 
+/* does the actual work on image surfaces, @src and @dest can be the same */
+static void
+image_saturate_and_pixelate(cairo_surface_t* src,
+                            cairo_surface_t* dest,
+                            const gfloat saturation,
+                            gboolean pixelate)
+{
+    if (saturation == 1.0 && !pixelate) {
+        if (dest != src)
+            memcpy(cairo_image_surface_get_data(dest),
+                   cairo_image_surface_get_data(src),
+                   cairo_image_surface_get_height(src) *
+                   cairo_image_surface_get_stride(src));
+    } else if (saturation >= 0.0 && saturation <= 1.0 && !pixelate) {
+        /* desaturation only, fixed point version is good enough */
+        awn_kernel_saturate(cairo_image_surface_get_data(src),
+                            cairo_image_surface_get_data(dest),
+                            cairo_image_surface_get_width(src),
+                            cairo_image_surface_get_height(src),
+                            cairo_image_surface_get_stride(src),
+                            cairo_image_surface_get_stride(dest),
+                            saturation);
+    } else {
+        int i, j, t;
+        int width, height;
+        int has_alpha, src_rowstride, dest_rowstride, bytes_per_pixel;
+
+        guchar* src_line;
+        guchar* dest_line;
+        guchar* src_pixel;
+        guchar* dest_pixel;
+        guchar intensity;
+
+        has_alpha = TRUE;
+        bytes_per_pixel = has_alpha ? 4 : 3;
+        width = cairo_image_surface_get_width(src);
+        height = cairo_image_surface_get_height(src);
+        src_rowstride = cairo_image_surface_get_stride(src);
+        dest_rowstride = cairo_image_surface_get_stride(dest);
+
+        src_line = cairo_image_surface_get_data(src);
+        dest_line = cairo_image_surface_get_data(dest);
+
+#define DARK_FACTOR 0.7
+#define INTENSITY(r, g, b) ((r) * 0.30 + (g) * 0.59 + (b) * 0.11)
+#define CLAMP_UCHAR(v) (t = (v), CLAMP (t, 0, 255))
+#define SATURATE(v) ((1.0 - saturation) * intensity + saturation * (v))
+
+        for (i = 0 ; i < height ; i++) {
+            src_pixel = src_line;
+            src_line = src_line + src_rowstride;
+            dest_pixel = dest_line;
+            dest_line = dest_line + dest_rowstride;
+
+            for (j = 0 ; j < width ; j++) {
+                intensity = INTENSITY(src_pixel[0], src_pixel[1], src_pixel[2]);
+
+                if (pixelate && (i + j) % 2 == 0) {
+                    dest_pixel[0] = intensity / 2 + 127;
+                    dest_pixel[1] = intensity / 2 + 127;
+                    dest_pixel[2] = intensity / 2 + 127;
+                } else if (pixelate) {
+                    dest_pixel[0] = CLAMP_UCHAR((SATURATE(src_pixel[0])) * DARK_FACTOR);
+                    dest_pixel[1] = CLAMP_UCHAR((SATURATE(src_pixel[1])) * DARK_FACTOR);
+                    dest_pixel[2] = CLAMP_UCHAR((SATURATE(src_pixel[2])) * DARK_FACTOR);
+                } else {
+                    dest_pixel[0] = CLAMP_UCHAR(SATURATE(src_pixel[0]));
+                    dest_pixel[1] = CLAMP_UCHAR(SATURATE(src_pixel[1]));
+                    dest_pixel[2] = CLAMP_UCHAR(SATURATE(src_pixel[2]));
+                }
+
+                if (has_alpha) {
+                    dest_pixel[3] = src_pixel[3];
+                }
+
+                src_pixel = src_pixel + bytes_per_pixel;
+
+                dest_pixel = dest_pixel + bytes_per_pixel;
+            }
+        }
+    }
+}
+
 /**
- *    FIXME it would be nice to not have to use image surfaces for this effect
- *
  * Modified from gdk_pixbuf_saturate_and_pixelate();
  * Original copyright on gdk_pixbuf_saturate_and_pixelate() below
  * Copyright (C) 1999 The Free Software Foundation
@@ -431,10 +465,27 @@ surface_saturate_and_pixelate(cairo_surface_t* src,
     cairo_t* temp_dest_ctx;
     cairo_surface_t* temp_dest_srfc;
 
-    // FIXME: cairo_xlib_surface_get_width/height doesn't work correctly
-    //   during resizes, pass as param!
     g_return_if_fail(src);
     g_return_if_fail(dest);
+
+    /* image surfaces are processed directly */
+    if (cairo_surface_get_type(src) == CAIRO_SURFACE_TYPE_IMAGE &&
+            cairo_surface_get_type(dest) == CAIRO_SURFACE_TYPE_IMAGE) {
+        gint width = cairo_image_surface_get_width(src);
+        gint height = cairo_image_surface_get_height(src);
+
+        g_return_if_fail(surface_is_argb32_image(src, width, height));
+        g_return_if_fail(surface_is_argb32_image(dest, width, height));
+
+        cairo_surface_flush(src);
+        cairo_surface_flush(dest);
+        image_saturate_and_pixelate(src, dest, saturation, pixelate);
+        cairo_surface_mark_dirty(dest);
+        return;
+    }
+
+    // FIXME: cairo_xlib_surface_get_width/height doesn't work correctly
+    //   during resizes, pass as param!
     g_return_if_fail(cairo_xlib_surface_get_height(src) ==
                      cairo_xlib_surface_get_height(dest));
     g_return_if_fail(cairo_xlib_surface_get_width(src) ==
@@ -464,71 +515,9 @@ surface_saturate_and_pixelate(cairo_surface_t* src,
         cairo_destroy(temp_src_ctx);
     }
 
-    if (saturation == 1.0 && !pixelate) {
-        if (dest != src)
-            memcpy(cairo_image_surface_get_data(temp_dest_srfc),
-                   cairo_image_surface_get_data(temp_src_srfc),
-                   cairo_image_surface_get_height(temp_src_srfc) *
-                   cairo_image_surface_get_stride(temp_src_srfc));
-    } else {
-        int i, j, t;
-        int width, height;
-        int has_alpha, src_rowstride, dest_rowstride, bytes_per_pixel;
-
-        guchar* src_line;
-        guchar* dest_line;
-        guchar* src_pixel;
-        guchar* dest_pixel;
-        guchar intensity;
-
-        has_alpha = TRUE;
-        bytes_per_pixel = has_alpha ? 4 : 3;
-        width = cairo_image_surface_get_width(temp_src_srfc);
-        height = cairo_image_surface_get_height(temp_src_srfc);
-        src_rowstride = cairo_image_surface_get_stride(temp_src_srfc);
-        dest_rowstride = cairo_image_surface_get_stride(temp_dest_srfc);
-
-        src_line = cairo_image_surface_get_data(temp_src_srfc);
-        dest_line = cairo_image_surface_get_data(temp_dest_srfc);
+    image_saturate_and_pixelate(temp_src_srfc, temp_dest_srfc,
+                                saturation, pixelate);
 
-#define DARK_FACTOR 0.7
-#define INTENSITY(r, g, b) ((r) * 0.30 + (g) * 0.59 + (b) * 0.11)
-#define CLAMP_UCHAR(v) (t = (v), CLAMP (t, 0, 255))
-#define SATURATE(v) ((1.0 - saturation) * intensity + saturation * (v))
-
-        for (i = 0 ; i < height ; i++) {
-            src_pixel = src_line;
-            src_line = src_line + src_rowstride;
-            dest_pixel = dest_line;
-            dest_line = dest_line + dest_rowstride;
-
-            for (j = 0 ; j < width ; j++) {
-                intensity = INTENSITY(src_pixel[0], src_pixel[1], src_pixel[2]);
-
-                if (pixelate && (i + j) % 2 == 0) {
-                    dest_pixel[0] = intensity / 2 + 127;
-                    dest_pixel[1] = intensity / 2 + 127;
-                    dest_pixel[2] = intensity / 2 + 127;
-                } else if (pixelate) {
-                    dest_pixel[0] = CLAMP_UCHAR((SATURATE(src_pixel[0])) * DARK_FACTOR);
-                    dest_pixel[1] = CLAMP_UCHAR((SATURATE(src_pixel[1])) * DARK_FACTOR);
-                    dest_pixel[2] = CLAMP_UCHAR((SATURATE(src_pixel[2])) * DARK_FACTOR);
-                } else {
-                    dest_pixel[0] = CLAMP_UCHAR(SATURATE(src_pixel[0]));
-                    dest_pixel[1] = CLAMP_UCHAR(SATURATE(src_pixel[1]));
-                    dest_pixel[2] = CLAMP_UCHAR(SATURATE(src_pixel[2]));
-                }
-
-                if (has_alpha) {
-                    dest_pixel[3] = src_pixel[3];
-                }
-
-                src_pixel = src_pixel + bytes_per_pixel;
-
-                dest_pixel = dest_pixel + bytes_per_pixel;
-            }
-        }
-    }
     /* ---------- */
     cairo_surface_mark_dirty(temp_dest_srfc);
 
@@ -34,6 +34,25 @@ cairo_surface_t* awn_effects_quark_to_surface(AwnEffects* fx, GQuark quark)
     return surface;
 }
 
+/* surface for a temporary copy of the target, its content is undefined,
+ * so it has to be painted over completely */
+static cairo_surface_t*
+awn_effects_create_temp_surface(AwnEffects* fx, cairo_t* cr)
+{
+    AwnEffectsPrivate* priv = fx->priv;
+    cairo_surface_t* target = cairo_get_target(cr);
+
+    if (target == priv->scratch_surfaces[AWN_EFFECTS_SCRATCH_TARGET]) {
+        return cairo_surface_reference(
+                   awn_effects_get_scratch_surface(fx, AWN_EFFECTS_SCRATCH_TEMP));
+    }
+
+    return cairo_surface_create_similar(target,
+                                        CAIRO_CONTENT_COLOR_ALPHA,
+                                        priv->window_width,
+                                        priv->window_height);
+}
+
 /* returns top left coordinates of the icon (without clipping and offsets) */
 void
 awn_effects_get_base_coords(AwnEffects* fx, double* x, double* y)
@@ -538,11 +557,7 @@ gboolean awn_effects_post_op_depth(AwnEffects* fx,
         /* FIXME: we really could use the GtkAllocation here for optimization
          * copy current surface look into temp one
          */
-        cairo_surface_t* srfc = cairo_surface_create_similar(cairo_get_target(cr),
-                                CAIRO_CONTENT_COLOR_ALPHA,
-                                priv->window_width,
-                                priv->window_height
-                                                            );
+        cairo_surface_t* srfc = awn_effects_create_temp_surface(fx, cr);
         cairo_t* ctx = cairo_create(srfc);
         cairo_set_operator(ctx, CAIRO_OPERATOR_SOURCE);
         cairo_set_source_surface(ctx, cairo_get_target(cr), 0, 0);
@@ -596,10 +611,7 @@ gboolean awn_effects_post_op_shadow(AwnEffects* fx,
         cairo_t* blur_ctx;
 
         int w = priv->window_width, h = priv->window_height;
-        blur_srfc = cairo_surface_create_similar(cairo_get_target(cr),
-                    CAIRO_CONTENT_COLOR_ALPHA,
-                    w,
-                    h);
+        blur_srfc = awn_effects_create_temp_surface(fx, cr);
         blur_ctx = cairo_create(blur_srfc);
 
         cairo_set_operator(blur_ctx, CAIRO_OPERATOR_SOURCE);
@@ -730,11 +742,7 @@ gboolean awn_effects_post_op_reflection(AwnEffects* fx,
         int dx = priv->window_width - fx->icon_offset * 2 - fx->refl_offset;
         int dy = priv->window_height - fx->icon_offset * 2 - fx->refl_offset;
 
-        cairo_surface_t* srfc = cairo_surface_create_similar(cairo_get_target(cr),
-                                CAIRO_CONTENT_COLOR_ALPHA,
-                                priv->window_width,
-                                priv->window_height
-                                                            );
+        cairo_surface_t* srfc = awn_effects_create_temp_surface(fx, cr);
         cairo_t* ctx = cairo_create(srfc);
         cairo_matrix_t matrix;
         switch (fx->position) {
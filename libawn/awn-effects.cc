@@ -24,7 +24,9 @@
 #include "awn-effects.h"
 #include "awn-effects-ops-new.h"
 #include "awn-enum-types.h"
+#include "awn-frame-clock.h"
 #include "awn-overlay.h"
+#include "awn-overlay-progress.h"
 
 #include <math.h>
 #include <string.h>
@@ -54,10 +56,16 @@ extern "C" {
   AWN_TYPE_EFFECTS, \
   AwnEffectsPrivate))
 
-/* if someone wants faster/slower animations add a speed multiplier
- * property (and use it in the animations) but don't change fps
+/* animations are driven by the shared AwnFrameClock, but every animation
+ * step is designed for this rate - if the clock ticks slower (or frames get
+ * dropped) more steps are played at once, so the duration doesn't change.
+ * If someone wants faster/slower animations add a speed multiplier
+ * property (and use it in the animations) but don't change the step rate
  */
-#define AWN_FRAMES_PER_SECOND(fx) (25)
+#define AWN_ANIMATION_STEPS_PER_SECOND 25
+/* don't try to catch up more than this many steps in a single frame
+ * (on top of the steps a regular frame of a slow clock has to play) */
+#define AWN_ANIMATION_MAX_STEPS 8
 #define AWN_ANIMATIONS_PER_BUNDLE 5
 
 #define AWN_INTERNAL_ICON "__awn_internal_"
@@ -81,6 +89,7 @@ enum {
     PROP_WIDGET,
     PROP_NO_CLEAR,
     PROP_INDIRECT_PAINT,
+    PROP_IMAGE_PAINT,
     PROP_POSITION,
     PROP_CURRENT_EFFECTS,
     PROP_ICON_OFFSET,
@@ -104,6 +113,7 @@ enum {
 
 /* FORWARDS */
 static void awn_effects_prop_changed(GObject* object, GParamSpec* pspec);
+static void awn_effects_free_scratch_surfaces(AwnEffects* fx);
 
 static void
 awn_effects_dispose(GObject* object)
@@ -112,7 +122,8 @@ awn_effects_dispose(GObject* object)
 
     /* destroy animation timer */
     if (fx->priv->timer_id) {
-        g_source_remove(fx->priv->timer_id);
+        awn_frame_clock_remove(awn_frame_clock_get_default(),
+                               fx->priv->timer_id);
         fx->priv->timer_id = 0;
     }
 
@@ -121,6 +132,13 @@ awn_effects_dispose(GObject* object)
         fx->widget = NULL;
     }
 
+    if (fx->priv->cache_surface) {
+        cairo_surface_destroy(fx->priv->cache_surface);
+        fx->priv->cache_surface = NULL;
+    }
+
+    awn_effects_free_scratch_surfaces(fx);
+
     /* unref overlays in our overlay list */
     if (fx->priv->overlays) {
         for (GList* iter = fx->priv->overlays; iter != NULL;
@@ -263,6 +281,9 @@ awn_effects_widget_hidden(AwnEffects* fx)
     AwnEffectsPrivate* priv = AWN_EFFECTS_GET_PRIVATE(fx);
 
     priv->already_exposed = FALSE;
+
+    /* no need to keep the buffers around while we're not painting */
+    awn_effects_free_scratch_surfaces(fx);
 }
 
 static void
@@ -283,6 +304,9 @@ awn_effects_get_property(GObject*      object,
     case PROP_INDIRECT_PAINT:
         g_value_set_boolean(value, fx->indirect_paint);
         break;
+    case PROP_IMAGE_PAINT:
+        g_value_set_boolean(value, fx->priv->image_paint);
+        break;
     case PROP_POSITION:
         g_value_set_enum(value, fx->position);
         break;
@@ -372,6 +396,9 @@ awn_effects_set_property(GObject*      object,
     case PROP_INDIRECT_PAINT:
         fx->indirect_paint = g_value_get_boolean(value);
         break;
+    case PROP_IMAGE_PAINT:
+        fx->priv->image_paint = g_value_get_boolean(value);
+        break;
     case PROP_POSITION:
         fx->position = g_value_get_enum(value);
         break;
@@ -458,6 +485,16 @@ awn_effects_prop_changed(GObject* object, GParamSpec* pspec)
 {
     AwnEffects* fx = AWN_EFFECTS(object);
 
+    /* progress overlays notify rendered-percent when their render changes,
+     * percent-complete changes within a quantization step don't matter */
+    if (pspec->owner_type == AWN_TYPE_OVERLAY_PROGRESS &&
+            g_strcmp0(pspec->name, "percent-complete") == 0) {
+        return;
+    }
+
+    /* any property or overlay change invalidates the cached render */
+    fx->priv->cache_props_serial++;
+
     awn_effects_redraw(fx);
 }
 
@@ -716,6 +753,24 @@ awn_effects_class_init(AwnEffectsClass* klass)
                              TRUE,
                              G_PARAM_CONSTRUCT | G_PARAM_READWRITE |
                              G_PARAM_STATIC_STRINGS));
+    /**
+     * AwnEffects:image-paint:
+     *
+     * When painting indirectly, determines whether the offscreen buffer is
+     * an image surface, so the surface operations don't need to read
+     * the pixels back from the X server. The result is uploaded once when
+     * the drawing is finished. Frames which desaturate the icon use
+     * the image surface even if this is FALSE.
+     */
+    g_object_class_install_property(
+        obj_class, PROP_IMAGE_PAINT,
+        g_param_spec_boolean("image-paint",
+                             "Image paint",
+                             "Determines whether the offscreen buffer "
+                             "is kept in client memory",
+                             FALSE,
+                             G_PARAM_CONSTRUCT | G_PARAM_READWRITE |
+                             G_PARAM_STATIC_STRINGS));
     /**
      * AwnEffects:position:
      *
@@ -1108,6 +1163,68 @@ awn_effects_start_ex(AwnEffects* fx, const AwnEffect effect, gint max_loops,
     awn_effects_main_effect_loop(fx);
 }
 
+static gboolean
+awn_effects_animation_tick(gpointer data)
+{
+    AwnEffectsAnimation* anim = (AwnEffectsAnimation*)data;
+    AwnEffectsPrivate* priv = anim->effects->priv;
+    GSourceFunc func = priv->animation_func;
+    AwnFrameClock* clock = awn_frame_clock_get_default();
+    guint fps = 0;
+
+    gdouble now = awn_frame_clock_get_frame_time(clock);
+    gint steps = (gint)((now - priv->animation_time) /
+                        priv->animation_step + 0.5);
+
+    if (steps <= 0) {
+        /* clock is running faster than our step rate */
+        return TRUE;
+    }
+
+    /* a slow clock legitimately needs several steps per frame, only frames
+     * taking much longer than the clock interval count as a stall */
+    g_object_get(clock, "frames-per-second", &fps, NULL);
+    gint max_steps = AWN_ANIMATION_MAX_STEPS;
+    if (fps > 0) {
+        max_steps += (gint)(1.0 / fps / priv->animation_step + 0.5);
+    }
+
+    if (steps > max_steps) {
+        /* we were stalled for too long, don't play everything we missed */
+        steps = max_steps;
+        priv->animation_time = now;
+    } else {
+        priv->animation_time += steps * priv->animation_step;
+    }
+
+    while (steps-- > 0) {
+        /* anim is possibly freed if the step returns FALSE */
+        if (!func(anim)) {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* interval is the duration of a single step in ms, 0 for the default
+ * step rate */
+guint
+awn_effects_schedule_animation(AwnEffects* fx, GSourceFunc func,
+                               AwnEffectsAnimation* anim, guint interval)
+{
+    AwnFrameClock* clock = awn_frame_clock_get_default();
+
+    fx->priv->animation_func = func;
+    fx->priv->animation_time = awn_frame_clock_get_frame_time(clock);
+    fx->priv->animation_step = interval > 0 ?
+                               interval / 1000.0 :
+                               1.0 / AWN_ANIMATION_STEPS_PER_SECOND;
+
+    return awn_frame_clock_add(clock, interval, awn_effects_animation_tick,
+                               anim);
+}
+
 /**
  * awn_effects_stop:
  * @fx: Pointer to #AwnEffects instance.
@@ -1151,8 +1268,9 @@ awn_effects_stop(AwnEffects* fx, const AwnEffect effect)
             g_free(queue_item);
         } else if (fx->priv->sleeping_func) {
             /* wake up sleeping effect */
-            fx->priv->timer_id = g_timeout_add(1000 / AWN_FRAMES_PER_SECOND(fx),
-                                               fx->priv->sleeping_func, queue_item);
+            fx->priv->timer_id =
+                awn_effects_schedule_animation(fx, fx->priv->sleeping_func,
+                                               queue_item, 0);
             fx->priv->sleeping_func = NULL;
         }
     }
@@ -1206,8 +1324,9 @@ awn_effects_main_effect_loop(AwnEffects* fx)
 
             g_return_if_fail(queue_item);
 
-            fx->priv->timer_id = g_timeout_add(1000 / AWN_FRAMES_PER_SECOND(fx),
-                                               fx->priv->sleeping_func, queue_item);
+            fx->priv->timer_id =
+                awn_effects_schedule_animation(fx, fx->priv->sleeping_func,
+                                               queue_item, 0);
             fx->priv->sleeping_func = NULL;
         }
         return;
@@ -1230,8 +1349,8 @@ awn_effects_main_effect_loop(AwnEffects* fx)
 
     if (animation) {
         // FIXME: if we're not mapped wait with starting the timer for the map-event
-        fx->priv->timer_id = g_timeout_add(1000 / AWN_FRAMES_PER_SECOND(fx),
-                                           animation, topEffect);
+        fx->priv->timer_id = awn_effects_schedule_animation(fx, animation,
+                             topEffect, 0);
         fx->priv->current_effect = topEffect->this_effect;
         fx->priv->effect_lock = FALSE;
 
@@ -1242,7 +1361,8 @@ awn_effects_main_effect_loop(AwnEffects* fx)
             if (animation(topEffect) == FALSE) {
                 // if the animation is one-frame, we need to kill the timer ourselves,
                 //  but effect cleanup set the timer_id to 0 meanwhile
-                g_source_remove(timer_backup);
+                awn_frame_clock_remove(awn_frame_clock_get_default(),
+                                       timer_backup);
             }
         }
     } else {
@@ -1348,6 +1468,50 @@ cairo_t* awn_effects_cairo_create(AwnEffects* fx)
     return awn_effects_cairo_create_clipped(fx, NULL);
 }
 
+/*
+ * Returns image surface of the window's size, which is owned by the effects
+ * instance and reused by following frames, so its content is undefined.
+ */
+cairo_surface_t*
+awn_effects_get_scratch_surface(AwnEffects* fx, AwnEffectsScratch which)
+{
+    AwnEffectsPrivate* priv = fx->priv;
+    cairo_surface_t* srfc;
+
+    g_return_val_if_fail(which < AWN_EFFECTS_SCRATCH_LAST, NULL);
+
+    srfc = priv->scratch_surfaces[which];
+
+    if (srfc &&
+            (cairo_image_surface_get_width(srfc) != priv->window_width ||
+             cairo_image_surface_get_height(srfc) != priv->window_height)) {
+        cairo_surface_destroy(srfc);
+        srfc = NULL;
+    }
+
+    if (!srfc) {
+        srfc = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
+                                          priv->window_width,
+                                          priv->window_height);
+        priv->scratch_surfaces[which] = srfc;
+    }
+
+    return srfc;
+}
+
+static void
+awn_effects_free_scratch_surfaces(AwnEffects* fx)
+{
+    AwnEffectsPrivate* priv = fx->priv;
+
+    for (gint i = 0; i < AWN_EFFECTS_SCRATCH_LAST; i++) {
+        if (priv->scratch_surfaces[i]) {
+            cairo_surface_destroy(priv->scratch_surfaces[i]);
+            priv->scratch_surfaces[i] = NULL;
+        }
+    }
+}
+
 /**
  * awn_effects_cairo_create_clipped:
  * @fx: Pointer to #AwnEffects instance.
@@ -1419,7 +1583,18 @@ cairo_t* awn_effects_cairo_create_clipped(AwnEffects* fx,
             alloc.width, alloc.height);
 #endif
 
-    if (fx->indirect_paint) {
+    if (fx->indirect_paint && (priv->image_paint || priv->saturation < 1.0)) {
+        /* pixel operations would need to read back the xlib surface */
+        cairo_surface_t* targetSurface =
+            awn_effects_get_scratch_surface(fx, AWN_EFFECTS_SCRATCH_TARGET);
+        g_return_val_if_fail(
+            cairo_surface_status(targetSurface) == CAIRO_STATUS_SUCCESS, NULL);
+        cr = cairo_create(targetSurface);
+        /* the surface is reused, clear what was painted last time */
+        cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+        cairo_paint(cr);
+        cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    } else if (fx->indirect_paint) {
         cairo_surface_t* targetSurface = cairo_get_target(cr);
         /* we'll give to user virtual context and later paint everything on real one */
         targetSurface = cairo_surface_create_similar(targetSurface,
@@ -1456,6 +1631,129 @@ cairo_t* awn_effects_cairo_create_clipped(AwnEffects* fx,
     return cr;
 }
 
+static void
+awn_effects_get_cache_key(AwnEffects* fx, AwnEffectsCacheKey* key,
+                          guint content_serial)
+{
+    AwnEffectsPrivate* priv = fx->priv;
+    GtkAllocation alloc;
+
+    /* there might be padding in the struct */
+    memset(key, 0, sizeof(AwnEffectsCacheKey));
+
+    gtk_widget_get_allocation(fx->widget, &alloc);
+
+    key->content_serial = content_serial;
+    key->props_serial = priv->cache_props_serial;
+
+    key->window_width = alloc.width;
+    key->window_height = alloc.height;
+    key->icon_width = priv->icon_width;
+    key->icon_height = priv->icon_height;
+
+    key->position = fx->position;
+    key->icon_offset = fx->icon_offset;
+    key->refl_offset = fx->refl_offset;
+    key->border_clip = fx->border_clip;
+    key->arrows_count = fx->arrows_count;
+    key->icon_alpha = fx->icon_alpha;
+    key->refl_alpha = fx->refl_alpha;
+    key->progress = fx->progress;
+    key->do_reflection = fx->do_reflection;
+    key->make_shadow = fx->make_shadow;
+    key->is_active = fx->is_active;
+    key->depressed = fx->depressed;
+
+    key->side_offset = priv->side_offset;
+    key->top_offset = priv->top_offset;
+    key->curve_offset = priv->curve_offset;
+    key->width_mod = priv->width_mod;
+    key->height_mod = priv->height_mod;
+    key->clip_region = priv->clip_region;
+    key->rotate_degrees = priv->rotate_degrees;
+    key->alpha = priv->alpha;
+    key->spotlight_alpha = priv->spotlight_alpha;
+    key->saturation = priv->saturation;
+    key->glow_amount = priv->glow_amount;
+    key->icon_depth = priv->icon_depth;
+    key->icon_depth_direction = priv->icon_depth_direction;
+    key->clip = priv->clip;
+    key->flip = priv->flip;
+    key->spotlight = priv->spotlight;
+    key->simple_rect = priv->simple_rect;
+}
+
+/**
+ * awn_effects_cairo_paint_cached:
+ * @fx: Pointer to #AwnEffects instance.
+ * @event: #GdkEventExpose received by the widget.
+ * @content_serial: Number identifying the content which is painted on the
+ *  context, it has to change whenever the content changes. Use 0 to disable
+ *  caching.
+ *
+ * Paints the result of the last render if neither @content_serial nor any
+ * of the effect parameters changed since then, so all the post-ops don't
+ * have to run again. If it returns %FALSE, paint the icon as usual using
+ * awn_effects_cairo_create_clipped() and awn_effects_cairo_destroy(), the
+ * result will be cached for the next expose.
+ *
+ * Returns: %TRUE if the icon was painted from the cache.
+ */
+gboolean
+awn_effects_cairo_paint_cached(AwnEffects* fx, GdkEventExpose* event,
+                               guint content_serial)
+{
+    g_return_val_if_fail(AWN_IS_EFFECTS(fx) && fx->widget, FALSE);
+
+    AwnEffectsPrivate* priv = fx->priv;
+    AwnEffectsCacheKey key;
+    cairo_t* cr;
+
+    /* without indirect paint there's no surface we could keep */
+    if (content_serial == 0 || !fx->indirect_paint) {
+        priv->cache_content_serial = 0;
+        return FALSE;
+    }
+
+    awn_effects_get_cache_key(fx, &key, content_serial);
+
+    if (priv->cache_surface == NULL ||
+            memcmp(&key, &priv->cache_key, sizeof(AwnEffectsCacheKey)) != 0) {
+        /* awn_effects_cairo_destroy will store the new result */
+        priv->cache_content_serial = content_serial;
+        return FALSE;
+    }
+
+    cr = gdk_cairo_create(gtk_widget_get_window(fx->widget));
+    g_return_val_if_fail(cairo_status(cr) == CAIRO_STATUS_SUCCESS, FALSE);
+
+    /* same setup as in awn_effects_cairo_create_clipped */
+    if (event) {
+        gdk_cairo_region(cr, event->region);
+        cairo_clip(cr);
+
+        if (!gtk_widget_get_has_window(fx->widget)) {
+            GtkAllocation alloc;
+            gtk_widget_get_allocation(fx->widget, &alloc);
+            cairo_translate(cr, (double)(alloc.x), (double)(alloc.y));
+        }
+    }
+
+    priv->already_exposed = TRUE;
+
+    if (fx->no_clear == FALSE) {
+        awn_effects_pre_op_clear(fx, cr, NULL, NULL);
+    }
+
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    cairo_set_source_surface(cr, priv->cache_surface, 0, 0);
+    cairo_paint(cr);
+
+    cairo_destroy(cr);
+
+    return TRUE;
+}
+
 /**
  * awn_effects_cairo_destroy:
  * @fx: Pointer to #AwnEffects instance.
@@ -1524,11 +1822,41 @@ void awn_effects_cairo_destroy(AwnEffects* fx)
     }
 
     if (fx->indirect_paint) {
+        cairo_surface_t* result = cairo_get_target(cr);
+        gboolean scratch = result ==
+                           fx->priv->scratch_surfaces[AWN_EFFECTS_SCRATCH_TARGET];
+
+        if (scratch && fx->priv->cache_content_serial) {
+            /* the scratch surface will be reused, so upload it to a server
+             * side surface which can be kept in the cache */
+            result = cairo_surface_create_similar(cairo_get_target(fx->window_ctx),
+                                                  CAIRO_CONTENT_COLOR_ALPHA,
+                                                  fx->priv->window_width,
+                                                  fx->priv->window_height);
+            cairo_t* upload_ctx = cairo_create(result);
+            cairo_set_operator(upload_ctx, CAIRO_OPERATOR_SOURCE);
+            cairo_set_source_surface(upload_ctx, cairo_get_target(cr), 0, 0);
+            cairo_paint(upload_ctx);
+            cairo_destroy(upload_ctx);
+            scratch = FALSE;
+        }
+
         cairo_set_operator(fx->window_ctx, CAIRO_OPERATOR_OVER);
-        cairo_set_source_surface(fx->window_ctx, cairo_get_target(cr), 0, 0);
+        cairo_set_source_surface(fx->window_ctx, result, 0, 0);
         cairo_paint(fx->window_ctx);
 
-        cairo_surface_destroy(cairo_get_target(cr));
+        if (fx->priv->cache_content_serial) {
+            /* keep the surface for awn_effects_cairo_paint_cached */
+            if (fx->priv->cache_surface) {
+                cairo_surface_destroy(fx->priv->cache_surface);
+            }
+            fx->priv->cache_surface = result;
+            awn_effects_get_cache_key(fx, &fx->priv->cache_key,
+                                      fx->priv->cache_content_serial);
+            fx->priv->cache_content_serial = 0;
+        } else if (!scratch) {
+            cairo_surface_destroy(result);
+        }
         cairo_destroy(fx->virtual_ctx);
     }
     cairo_destroy(fx->window_ctx);
@@ -147,6 +147,10 @@ cairo_t* awn_effects_cairo_create_clipped(AwnEffects* fx,
 
 void awn_effects_cairo_destroy(AwnEffects* fx);
 
+gboolean awn_effects_cairo_paint_cached(AwnEffects* fx,
+                                        GdkEventExpose* event,
+                                        guint content_serial);
+
 void awn_effects_add_overlay(AwnEffects* fx, AwnOverlay* overlay);
 
 void awn_effects_remove_overlay(AwnEffects* fx, AwnOverlay* overlay);
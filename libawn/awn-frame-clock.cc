@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2009 Michal Hruby <michal.mhr@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* awn-frame-clock.c */
+
+/*
+    A single timer shared by everything that animates in the process.
+    Instead of every AwnEffects instance (and every throbber, background...)
+    running its own g_timeout, clients register a callback here and all of
+    them are dispatched from one timeout per frame. The redraws they queue
+    end up in the same GDK update pass, because GTK processes updates
+    at a lower priority than our timeout.
+ */
+
+#include "awn-frame-clock.h"
+
+extern "C" {
+    G_DEFINE_TYPE(AwnFrameClock, awn_frame_clock, G_TYPE_OBJECT)
+}
+
+#define GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), AWN_TYPE_FRAME_CLOCK, AwnFrameClockPrivate))
+
+typedef struct _AwnFrameClockPrivate AwnFrameClockPrivate;
+
+enum {
+    PROP_0,
+
+    PROP_FRAMES_PER_SECOND
+};
+
+typedef struct {
+    guint       id;
+    guint       interval;
+    gdouble     last_dispatch;
+    GSourceFunc func;
+    gpointer    data;
+    gboolean    removed;
+    gboolean    pending;
+} AwnFrameClockClient;
+
+struct _AwnFrameClockPrivate {
+    GList*      clients;
+    guint       next_id;
+    guint       source_id;
+    guint       fps;
+    gboolean    dispatching;
+    gdouble     frame_time;
+    GTimer*     timer;
+};
+
+static gboolean awn_frame_clock_tick(gpointer data);
+
+static void
+awn_frame_clock_start(AwnFrameClock* clock)
+{
+    AwnFrameClockPrivate* priv = GET_PRIVATE(clock);
+
+    if (!priv->source_id && priv->clients) {
+        priv->source_id = g_timeout_add(1000 / priv->fps,
+                                        awn_frame_clock_tick, clock);
+    }
+}
+
+static void
+awn_frame_clock_stop(AwnFrameClock* clock)
+{
+    AwnFrameClockPrivate* priv = GET_PRIVATE(clock);
+
+    if (priv->source_id) {
+        g_source_remove(priv->source_id);
+        priv->source_id = 0;
+    }
+}
+
+static void
+awn_frame_clock_get_property(GObject* object, guint property_id,
+                             GValue* value, GParamSpec* pspec)
+{
+    AwnFrameClockPrivate* priv = GET_PRIVATE(object);
+    switch (property_id) {
+    case PROP_FRAMES_PER_SECOND:
+        g_value_set_uint(value, priv->fps);
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+    }
+}
+
+static void
+awn_frame_clock_set_property(GObject* object, guint property_id,
+                             const GValue* value, GParamSpec* pspec)
+{
+    AwnFrameClockPrivate* priv = GET_PRIVATE(object);
+    switch (property_id) {
+    case PROP_FRAMES_PER_SECOND:
+        priv->fps = g_value_get_uint(value);
+        /* restart the timer with new interval */
+        if (priv->source_id) {
+            awn_frame_clock_stop(AWN_FRAME_CLOCK(object));
+            awn_frame_clock_start(AWN_FRAME_CLOCK(object));
+        }
+        break;
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+    }
+}
+
+static void
+awn_frame_clock_dispose(GObject* object)
+{
+    AwnFrameClockPrivate* priv = GET_PRIVATE(object);
+
+    awn_frame_clock_stop(AWN_FRAME_CLOCK(object));
+
+    if (priv->clients) {
+        g_list_foreach(priv->clients, (GFunc)g_free, NULL);
+        g_list_free(priv->clients);
+        priv->clients = NULL;
+    }
+
+    G_OBJECT_CLASS(awn_frame_clock_parent_class)->dispose(object);
+}
+
+static void
+awn_frame_clock_finalize(GObject* object)
+{
+    AwnFrameClockPrivate* priv = GET_PRIVATE(object);
+
+    g_timer_destroy(priv->timer);
+
+    G_OBJECT_CLASS(awn_frame_clock_parent_class)->finalize(object);
+}
+
+static void
+awn_frame_clock_class_init(AwnFrameClockClass* klass)
+{
+    GObjectClass* object_class = G_OBJECT_CLASS(klass);
+    GParamSpec*     pspec;
+
+    object_class->get_property = awn_frame_clock_get_property;
+    object_class->set_property = awn_frame_clock_set_property;
+    object_class->dispose = awn_frame_clock_dispose;
+    object_class->finalize = awn_frame_clock_finalize;
+
+    /* if someone wants faster/slower animations add a speed multiplier
+     * to the animations, this should only be lowered to save CPU
+     */
+    pspec = g_param_spec_uint("frames-per-second",
+                              "Frames per second",
+                              "Rate at which the registered callbacks are dispatched",
+                              1,
+                              100,
+                              25,
+                              G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
+    g_object_class_install_property(object_class, PROP_FRAMES_PER_SECOND, pspec);
+
+    g_type_class_add_private(klass, sizeof(AwnFrameClockPrivate));
+}
+
+static void
+awn_frame_clock_init(AwnFrameClock* self)
+{
+    AwnFrameClockPrivate* priv = GET_PRIVATE(self);
+
+    priv->clients = NULL;
+    priv->next_id = 1;
+    priv->source_id = 0;
+    priv->dispatching = FALSE;
+    priv->timer = g_timer_new();
+}
+
+/**
+ * awn_frame_clock_new:
+ *
+ * Returns: Returns a #AwnFrameClock object. You probably should be using awn_frame_clock_get_default().
+ */
+
+AwnFrameClock*
+awn_frame_clock_new(void)
+{
+    return g_object_new(AWN_TYPE_FRAME_CLOCK, NULL);
+}
+
+/**
+ * awn_frame_clock_get_default:
+ *
+ * Returns: Returns the default #AwnFrameClock object.
+ */
+
+AwnFrameClock*
+awn_frame_clock_get_default(void)
+{
+    static AwnFrameClock* def_clock = NULL;
+    if (!def_clock) {
+        def_clock = awn_frame_clock_new();
+    }
+    return def_clock;
+}
+
+static gboolean
+awn_frame_clock_tick(gpointer data)
+{
+    AwnFrameClock* clock = AWN_FRAME_CLOCK(data);
+    AwnFrameClockPrivate* priv = GET_PRIVATE(clock);
+    gdouble now = g_timer_elapsed(priv->timer, NULL);
+    /* clients with an interval are dispatched on the nearest frame */
+    gdouble half_frame = 0.5 / priv->fps;
+
+    priv->frame_time = now;
+    priv->dispatching = TRUE;
+
+    for (GList* iter = priv->clients; iter; iter = iter->next) {
+        AwnFrameClockClient* client = iter->data;
+
+        /* clients added during this tick get their first frame next time */
+        if (client->removed || client->pending) {
+            continue;
+        }
+        if (client->interval > 0 &&
+                now - client->last_dispatch + half_frame < client->interval / 1000.0) {
+            continue;
+        }
+
+        client->last_dispatch = now;
+        if (!client->func(client->data)) {
+            client->removed = TRUE;
+        }
+    }
+
+    priv->dispatching = FALSE;
+
+    /* sweep removed clients */
+    GList* iter = priv->clients;
+    while (iter) {
+        GList* next = iter->next;
+        AwnFrameClockClient* client = iter->data;
+
+        if (client->removed) {
+            g_free(client);
+            priv->clients = g_list_delete_link(priv->clients, iter);
+        } else {
+            client->pending = FALSE;
+        }
+        iter = next;
+    }
+
+    if (priv->clients == NULL) {
+        priv->source_id = 0;
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/**
+ * awn_frame_clock_add:
+ * @clock: A pointer to an #AwnFrameClock object.
+ * @interval: Minimal time between calls to @func in milliseconds, or 0 to call
+ *  it on every frame.
+ * @func: Function to call, it should return FALSE if it should be removed.
+ * @data: Data to pass to @func.
+ *
+ * Registers a callback which will be called on the clock's frames, the
+ * semantics are the same as for g_timeout_add(), but all registered callbacks
+ * are dispatched from a single timeout.
+ *
+ * Returns: the ID (greater than 0) of the callback, which can be passed
+ *  to awn_frame_clock_remove().
+ */
+
+guint
+awn_frame_clock_add(AwnFrameClock* clock, guint interval,
+                    GSourceFunc func, gpointer data)
+{
+    g_return_val_if_fail(AWN_IS_FRAME_CLOCK(clock), 0);
+    g_return_val_if_fail(func != NULL, 0);
+
+    AwnFrameClockPrivate* priv = GET_PRIVATE(clock);
+    AwnFrameClockClient* client = g_new0(AwnFrameClockClient, 1);
+
+    client->id = priv->next_id++;
+    client->interval = interval;
+    client->last_dispatch = g_timer_elapsed(priv->timer, NULL);
+    client->func = func;
+    client->data = data;
+    client->pending = priv->dispatching;
+
+    priv->clients = g_list_append(priv->clients, client);
+
+    awn_frame_clock_start(clock);
+
+    return client->id;
+}
+
+/**
+ * awn_frame_clock_remove:
+ * @clock: A pointer to an #AwnFrameClock object.
+ * @id: ID of the callback returned by awn_frame_clock_add().
+ *
+ * Unregisters a callback previously added with awn_frame_clock_add().
+ */
+
+void
+awn_frame_clock_remove(AwnFrameClock* clock, guint id)
+{
+    g_return_if_fail(AWN_IS_FRAME_CLOCK(clock));
+
+    AwnFrameClockPrivate* priv = GET_PRIVATE(clock);
+
+    for (GList* iter = priv->clients; iter; iter = iter->next) {
+        AwnFrameClockClient* client = iter->data;
+
+        if (client->id != id || client->removed) {
+            continue;
+        }
+
+        if (priv->dispatching) {
+            /* the list is swept once the tick is over */
+            client->removed = TRUE;
+        } else {
+            g_free(client);
+            priv->clients = g_list_delete_link(priv->clients, iter);
+
+            if (priv->clients == NULL) {
+                awn_frame_clock_stop(clock);
+            }
+        }
+        return;
+    }
+}
+
+/**
+ * awn_frame_clock_get_frame_time:
+ * @clock: A pointer to an #AwnFrameClock object.
+ *
+ * Gets the time of the current frame, all callbacks dispatched during one
+ * frame get the same value, so it can be used to drive time-based animations.
+ *
+ * Returns: Time of the current frame (or current time if called outside of
+ *  a frame) in seconds, measured from creation of the clock.
+ */
+
+gdouble
+awn_frame_clock_get_frame_time(AwnFrameClock* clock)
+{
+    g_return_val_if_fail(AWN_IS_FRAME_CLOCK(clock), 0.0);
+
+    AwnFrameClockPrivate* priv = GET_PRIVATE(clock);
+
+    if (priv->dispatching) {
+        return priv->frame_time;
+    }
+
+    return g_timer_elapsed(priv->timer, NULL);
+}
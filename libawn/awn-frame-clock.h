@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2009 Michal Hruby <michal.mhr@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* awn-frame-clock.h */
+
+#ifndef _AWN_FRAME_CLOCK
+#define _AWN_FRAME_CLOCK
+
+#include <glib-object.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AWN_TYPE_FRAME_CLOCK awn_frame_clock_get_type()
+
+#define AWN_FRAME_CLOCK(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST ((obj), AWN_TYPE_FRAME_CLOCK, AwnFrameClock))
+
+#define AWN_FRAME_CLOCK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST ((klass), AWN_TYPE_FRAME_CLOCK, AwnFrameClockClass))
+
+#define AWN_IS_FRAME_CLOCK(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), AWN_TYPE_FRAME_CLOCK))
+
+#define AWN_IS_FRAME_CLOCK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE ((klass), AWN_TYPE_FRAME_CLOCK))
+
+#define AWN_FRAME_CLOCK_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), AWN_TYPE_FRAME_CLOCK, AwnFrameClockClass))
+
+typedef struct {
+    GObject parent;
+} AwnFrameClock;
+
+typedef struct {
+    GObjectClass parent_class;
+} AwnFrameClockClass;
+
+GType awn_frame_clock_get_type(void);
+
+AwnFrameClock* awn_frame_clock_new(void);
+
+AwnFrameClock* awn_frame_clock_get_default(void);
+
+guint awn_frame_clock_add(AwnFrameClock* clock,
+                          guint interval,
+                          GSourceFunc func,
+                          gpointer data);
+
+void awn_frame_clock_remove(AwnFrameClock* clock, guint id);
+
+gdouble awn_frame_clock_get_frame_time(AwnFrameClock* clock);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+
+#endif /* _AWN_FRAME_CLOCK */
@@ -0,0 +1,753 @@
+/*
+ * Copyright (C) 2009 Michal Hruby <michal.mhr@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* awn-icon-disk-cache.c */
+
+/*
+    Resolving a themed icon means walking the theme directories, decoding
+    the image (often an SVG) and scaling it, and AwnThemedIcon does that
+    for every scope, state and size of every icon on startup.
+
+    This cache keeps the resolved icons in $XDG_CACHE_HOME/awn/icons, one
+    file per theme, scope, icon name and size. Failed lookups aren't
+    stored, most of them are for scopes which don't override the icon and
+    answering them from the theme is cheap. Every file starts with a stamp of the theme it was resolved from,
+    which is a hash of the theme name, its search path and the mtimes of
+    every directory GtkIconTheme scans for the theme and the themes it
+    inherits (plus their icon-theme.cache files). The stamp is computed once
+    per theme and recomputed after awn_icon_disk_cache_invalidate(), entries
+    with a different stamp are treated as missing and get overwritten.
+
+    Names of the files are read once per process, so icons which were never
+    cached don't cost any I/O, and the files themselves can be read by
+    awn_icon_disk_cache_read() from any thread. The files are written by
+    awn_icon_disk_cache_write() in the thread which decoded the icon, or in
+    a writer thread for icons inserted by the main thread. When the directory
+    grows over DISK_CACHE_MAX_SIZE, a thread started with the first lookup
+    removes the oldest files.
+
+    Files are replaced atomically, so several processes can share the cache.
+ */
+
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "awn-icon-disk-cache.h"
+
+#define DISK_CACHE_MAGIC "AWNICOD1"
+/* pruning removes the oldest files until 3/4 of this is left */
+#define DISK_CACHE_MAX_SIZE (32 * 1024 * 1024)
+/* writing is given up after this many failures in a row */
+#define DISK_CACHE_MAX_FAILURES 5
+/* most themes hashed for a stamp, protects against cycles in Inherits */
+#define DISK_CACHE_MAX_THEMES 16
+
+#define ALIGN8(x) (((x) + 7) & ~7)
+
+typedef struct {
+    gchar   magic[8];
+    guint64 stamp;
+    guint32 key_len;
+    /* 0 if the icon couldn't be loaded */
+    gint32  width;
+    gint32  height;
+    gint32  rowstride;
+    guint32 has_alpha;
+    guint32 padding;
+} DiskRecord;
+
+struct _AwnIconDiskCache {
+    gchar*      dir;
+    /* GtkIconTheme -> guint64 stamp */
+    GHashTable* stamps;
+    /* names of the files in dir, guarded by the index lock */
+    GHashTable* index;
+    gboolean    disabled;
+    /* failed writes in a row, both guarded by the writes lock */
+    gint        failures;
+    gboolean    writes_disabled;
+    /* writes queued by awn_icon_disk_cache_insert() */
+    GThreadPool* write_pool;
+};
+
+typedef struct {
+    guint64    stamp;
+    gchar*     theme_name;
+    gchar*     scope;
+    gchar*     icon_name;
+    gint       size;
+    GdkPixbuf* pixbuf;
+} DiskCacheWrite;
+
+typedef struct {
+    gchar*  name;
+    time_t  mtime;
+    goffset size;
+} DiskCacheFile;
+
+G_LOCK_DEFINE_STATIC(disk_cache_index);
+G_LOCK_DEFINE_STATIC(disk_cache_writes);
+
+static gint
+disk_cache_file_compare(gconstpointer a, gconstpointer b)
+{
+    const DiskCacheFile* f1 = a;
+    const DiskCacheFile* f2 = b;
+
+    return f1->mtime < f2->mtime ? -1 : f1->mtime > f2->mtime;
+}
+
+static gpointer
+disk_cache_prune_thread(gpointer data)
+{
+    AwnIconDiskCache* cache = data;
+    GArray* files = g_array_new(FALSE, FALSE, sizeof(DiskCacheFile));
+    GDir* dir = g_dir_open(cache->dir, 0, NULL);
+    const gchar* name;
+    goffset total = 0;
+
+    while (dir && (name = g_dir_read_name(dir)) != NULL) {
+        gchar* path = g_build_filename(cache->dir, name, NULL);
+        struct stat st;
+
+        if (g_stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            DiskCacheFile file;
+
+            file.name = g_strdup(name);
+            file.mtime = st.st_mtime;
+            file.size = st.st_size;
+            g_array_append_val(files, file);
+            total += st.st_size;
+        }
+        g_free(path);
+    }
+    if (dir) {
+        g_dir_close(dir);
+    }
+
+    if (total > DISK_CACHE_MAX_SIZE) {
+        g_array_sort(files, disk_cache_file_compare);
+
+        for (guint i = 0; i < files->len &&
+                total > DISK_CACHE_MAX_SIZE / 4 * 3; i++) {
+            DiskCacheFile* file = &g_array_index(files, DiskCacheFile, i);
+            gchar* path = g_build_filename(cache->dir, file->name, NULL);
+
+            G_LOCK(disk_cache_index);
+            g_unlink(path);
+            g_hash_table_remove(cache->index, file->name);
+            G_UNLOCK(disk_cache_index);
+
+            total -= file->size;
+            g_free(path);
+        }
+    }
+
+    for (guint i = 0; i < files->len; i++) {
+        g_free(g_array_index(files, DiskCacheFile, i).name);
+    }
+    g_array_free(files, TRUE);
+
+    return NULL;
+}
+
+/* reads the names of the cached files and starts the pruning */
+static void
+disk_cache_load_index(AwnIconDiskCache* cache)
+{
+    GDir* dir = g_dir_open(cache->dir, 0, NULL);
+    const gchar* name;
+
+    if (!dir) {
+        return;
+    }
+
+    G_LOCK(disk_cache_index);
+    while ((name = g_dir_read_name(dir)) != NULL) {
+        g_hash_table_insert(cache->index, g_strdup(name), GINT_TO_POINTER(1));
+    }
+    G_UNLOCK(disk_cache_index);
+
+    g_dir_close(dir);
+
+    /* stat()ing all the files isn't something the main thread should do */
+    if (!g_thread_supported() ||
+            !g_thread_create(disk_cache_prune_thread, cache, FALSE, NULL)) {
+        disk_cache_prune_thread(cache);
+    }
+}
+
+/**
+ * awn_icon_disk_cache_get_default:
+ *
+ * Returns: the process-wide #AwnIconDiskCache.
+ */
+
+AwnIconDiskCache*
+awn_icon_disk_cache_get_default(void)
+{
+    static AwnIconDiskCache* def_cache = NULL;
+    if (!def_cache) {
+        def_cache = g_new0(AwnIconDiskCache, 1);
+        def_cache->dir = g_build_filename(g_get_user_cache_dir(),
+                                          "awn", "icons", NULL);
+        def_cache->stamps = g_hash_table_new_full(g_direct_hash,
+                            g_direct_equal,
+                            NULL, g_free);
+        def_cache->index = g_hash_table_new_full(g_str_hash, g_str_equal,
+                           g_free, NULL);
+
+        if (g_mkdir_with_parents(def_cache->dir, 0700) != 0) {
+            g_warning("Unable to create icon cache directory \"%s\"",
+                      def_cache->dir);
+            def_cache->disabled = TRUE;
+        } else {
+            disk_cache_load_index(def_cache);
+        }
+    }
+    return def_cache;
+}
+
+static guint64
+disk_cache_hash(guint64 hash, gconstpointer data, gsize len)
+{
+    const guchar* p = data;
+
+    /* FNV-1a */
+    for (gsize i = 0; i < len; i++) {
+        hash = (hash ^ p[i]) * G_GUINT64_CONSTANT(1099511628211);
+    }
+    return hash;
+}
+
+static guint64
+disk_cache_hash_dir_mtime(guint64 hash, const gchar* dir)
+{
+    struct stat st;
+    gint64 mtime = 0;
+
+    if (g_stat(dir, &st) == 0) {
+        mtime = st.st_mtime;
+    }
+    return disk_cache_hash(hash, &mtime, sizeof(mtime));
+}
+
+/* hashes mtimes of the directories GtkIconTheme scans for the theme,
+ * followed by the themes it inherits from */
+static guint64
+disk_cache_hash_theme(guint64 hash, gchar** search_path, gint n_elements,
+                      const gchar* theme_name, GHashTable* visited)
+{
+    GKeyFile* index_theme = NULL;
+    gchar** dirs = NULL;
+    gchar** inherits = NULL;
+
+    if (g_hash_table_lookup(visited, theme_name) ||
+            g_hash_table_size(visited) >= DISK_CACHE_MAX_THEMES) {
+        return hash;
+    }
+    g_hash_table_insert(visited, g_strdup(theme_name), GINT_TO_POINTER(1));
+
+    hash = disk_cache_hash(hash, theme_name, strlen(theme_name) + 1);
+
+    /* the first index.theme found is the one GtkIconTheme uses */
+    for (gint i = 0; i < n_elements && !index_theme; i++) {
+        gchar* path = g_build_filename(search_path[i], theme_name,
+                                       "index.theme", NULL);
+        index_theme = g_key_file_new();
+        if (!g_key_file_load_from_file(index_theme, path, G_KEY_FILE_NONE,
+                                       NULL)) {
+            g_key_file_free(index_theme);
+            index_theme = NULL;
+        }
+        g_free(path);
+    }
+
+    if (index_theme) {
+        dirs = g_key_file_get_string_list(index_theme, "Icon Theme",
+                                          "Directories", NULL, NULL);
+        inherits = g_key_file_get_string_list(index_theme, "Icon Theme",
+                                              "Inherits", NULL, NULL);
+        g_key_file_free(index_theme);
+    }
+
+    for (gint i = 0; i < n_elements; i++) {
+        gchar* dir = g_build_filename(search_path[i], theme_name, NULL);
+        gchar* cache_file = g_build_filename(dir, "icon-theme.cache", NULL);
+
+        hash = disk_cache_hash_dir_mtime(hash, dir);
+        hash = disk_cache_hash_dir_mtime(hash, cache_file);
+
+        if (dirs) {
+            for (gchar** subdir = dirs; *subdir; subdir++) {
+                gchar* path = g_build_filename(dir, *subdir, NULL);
+                hash = disk_cache_hash_dir_mtime(hash, path);
+                g_free(path);
+            }
+        } else {
+            /* no index.theme (like the awn-theme, which only has
+             * the scalable subdirectory), take whatever is there */
+            GDir* gdir = g_dir_open(dir, 0, NULL);
+            const gchar* name;
+
+            while (gdir && (name = g_dir_read_name(gdir)) != NULL) {
+                gchar* path = g_build_filename(dir, name, NULL);
+                hash = disk_cache_hash(hash, name, strlen(name) + 1);
+                hash = disk_cache_hash_dir_mtime(hash, path);
+                g_free(path);
+            }
+            if (gdir) {
+                g_dir_close(gdir);
+            }
+        }
+
+        g_free(cache_file);
+        g_free(dir);
+    }
+
+    for (gchar** parent = inherits; parent && *parent; parent++) {
+        hash = disk_cache_hash_theme(hash, search_path, n_elements,
+                                     *parent, visited);
+    }
+
+    g_strfreev(inherits);
+    g_strfreev(dirs);
+
+    return hash;
+}
+
+/**
+ * awn_icon_disk_cache_get_stamp:
+ * @cache: A pointer to an #AwnIconDiskCache.
+ * @theme: The #GtkIconTheme.
+ * @theme_name: Name of the icon theme.
+ *
+ * Has to be called from the main thread.
+ *
+ * Returns: the stamp of the current contents of the theme.
+ */
+
+guint64
+awn_icon_disk_cache_get_stamp(AwnIconDiskCache* cache, GtkIconTheme* theme,
+                              const gchar* theme_name)
+{
+    guint64* stamp = g_hash_table_lookup(cache->stamps, theme);
+    if (stamp) {
+        return *stamp;
+    }
+
+    GHashTable* visited = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                g_free, NULL);
+    gchar** search_path;
+    gint n_elements;
+    guint64 hash = G_GUINT64_CONSTANT(14695981039346656037);
+
+    gtk_icon_theme_get_search_path(theme, &search_path, &n_elements);
+
+    for (gint i = 0; i < n_elements; i++) {
+        hash = disk_cache_hash(hash, search_path[i],
+                               strlen(search_path[i]) + 1);
+        /* unthemed icons are looked up directly in the search path */
+        hash = disk_cache_hash_dir_mtime(hash, search_path[i]);
+    }
+
+    hash = disk_cache_hash_theme(hash, search_path, n_elements,
+                                 theme_name, visited);
+    hash = disk_cache_hash_theme(hash, search_path, n_elements,
+                                 "hicolor", visited);
+
+    g_hash_table_destroy(visited);
+    g_strfreev(search_path);
+
+    stamp = g_new(guint64, 1);
+    *stamp = hash;
+    g_hash_table_insert(cache->stamps, theme, stamp);
+
+    return hash;
+}
+
+static gchar*
+disk_cache_get_key(const gchar* theme_name, const gchar* scope,
+                   const gchar* icon_name, gint size)
+{
+    return g_strdup_printf("%s\n%s\n%s\n%d", theme_name,
+                           scope ? scope : "", icon_name, size);
+}
+
+static gchar*
+disk_cache_get_filename(const gchar* key)
+{
+    return g_strdup_printf("%08x", g_str_hash(key));
+}
+
+static void
+disk_cache_free_contents(guchar* pixels, gpointer data)
+{
+    g_free(data);
+}
+
+/**
+ * awn_icon_disk_cache_has_entry:
+ * @cache: A pointer to an #AwnIconDiskCache.
+ * @theme_name: Name of the icon theme.
+ * @scope: Scope of the icon (can be NULL).
+ * @icon_name: Name of the icon.
+ * @size: Requested size of the icon.
+ *
+ * Checks without any I/O whether the icon might be cached. Files written
+ * by other processes after the cache was opened aren't known.
+ *
+ * Returns: FALSE if awn_icon_disk_cache_read() would certainly fail.
+ */
+
+gboolean
+awn_icon_disk_cache_has_entry(AwnIconDiskCache* cache,
+                              const gchar* theme_name,
+                              const gchar* scope,
+                              const gchar* icon_name,
+                              gint size)
+{
+    g_return_val_if_fail(cache != NULL, FALSE);
+    g_return_val_if_fail(theme_name && icon_name, FALSE);
+
+    if (cache->disabled) {
+        return FALSE;
+    }
+
+    gchar* key = disk_cache_get_key(theme_name, scope, icon_name, size);
+    gchar* filename = disk_cache_get_filename(key);
+
+    G_LOCK(disk_cache_index);
+    gboolean found = g_hash_table_lookup(cache->index, filename) != NULL;
+    G_UNLOCK(disk_cache_index);
+
+    g_free(filename);
+    g_free(key);
+
+    return found;
+}
+
+/**
+ * awn_icon_disk_cache_read:
+ * @cache: A pointer to an #AwnIconDiskCache.
+ * @stamp: Stamp of the theme from awn_icon_disk_cache_get_stamp().
+ * @theme_name: Name of the icon theme.
+ * @scope: Scope of the icon (can be NULL).
+ * @icon_name: Name of the icon.
+ * @size: Requested size of the icon.
+ * @null_result: Set to TRUE if the icon is known to be missing in the theme.
+ *
+ * Reads an icon resolved by a previous run (or another process), can be
+ * called from any thread. Entries which turn out to be stale are forgotten,
+ * so awn_icon_disk_cache_has_entry() returns FALSE for them afterwards.
+ *
+ * Returns: a new #GdkPixbuf or NULL.
+ */
+
+GdkPixbuf*
+awn_icon_disk_cache_read(AwnIconDiskCache* cache,
+                         guint64 stamp,
+                         const gchar* theme_name,
+                         const gchar* scope,
+                         const gchar* icon_name,
+                         gint size,
+                         gboolean* null_result)
+{
+    GdkPixbuf* pixbuf = NULL;
+    gchar* contents = NULL;
+    gsize length;
+
+    *null_result = FALSE;
+
+    g_return_val_if_fail(cache != NULL, NULL);
+    g_return_val_if_fail(theme_name && icon_name, NULL);
+
+    gchar* key = disk_cache_get_key(theme_name, scope, icon_name, size);
+    gchar* filename = disk_cache_get_filename(key);
+    gchar* path = g_build_filename(cache->dir, filename, NULL);
+    gsize key_len = strlen(key);
+
+    if (g_file_get_contents(path, &contents, &length, NULL)) {
+        const DiskRecord* record = (const DiskRecord*)contents;
+        gsize data_offset = ALIGN8(sizeof(DiskRecord) + key_len);
+
+        if (length < data_offset ||
+                memcmp(record->magic, DISK_CACHE_MAGIC,
+                       sizeof(record->magic)) != 0 ||
+                record->key_len != key_len ||
+                memcmp(record + 1, key, key_len) != 0 ||
+                record->stamp != stamp) {
+            /* different key with the same hash or a stale entry */
+        } else if (record->width == 0) {
+            *null_result = TRUE;
+        } else if (record->width > 0 && record->height > 0 &&
+                   record->rowstride >=
+                   record->width * (record->has_alpha ? 4 : 3) &&
+                   data_offset +
+                   (gsize)record->rowstride * record->height <= length) {
+            pixbuf = gdk_pixbuf_new_from_data((guchar*)contents + data_offset,
+                                              GDK_COLORSPACE_RGB,
+                                              record->has_alpha, 8,
+                                              record->width, record->height,
+                                              record->rowstride,
+                                              disk_cache_free_contents,
+                                              contents);
+        }
+    }
+
+    if (!pixbuf) {
+        g_free(contents);
+    }
+    if (!pixbuf && !*null_result) {
+        /* the icon will be resolved again and the file overwritten */
+        G_LOCK(disk_cache_index);
+        g_hash_table_remove(cache->index, filename);
+        G_UNLOCK(disk_cache_index);
+    }
+
+    g_free(path);
+    g_free(filename);
+    g_free(key);
+
+    return pixbuf;
+}
+
+/**
+ * awn_icon_disk_cache_lookup:
+ * @cache: A pointer to an #AwnIconDiskCache.
+ * @theme: The #GtkIconTheme the icon is looked up in.
+ * @theme_name: Name of the icon theme.
+ * @scope: Scope of the icon (can be NULL).
+ * @icon_name: Name of the icon.
+ * @size: Requested size of the icon.
+ * @null_result: Set to TRUE if the icon is known to be missing in the theme.
+ *
+ * Looks up an icon resolved by a previous run (or another process), reading
+ * the file in the calling thread.
+ *
+ * Returns: a new #GdkPixbuf or NULL.
+ */
+
+GdkPixbuf*
+awn_icon_disk_cache_lookup(AwnIconDiskCache* cache,
+                           GtkIconTheme* theme,
+                           const gchar* theme_name,
+                           const gchar* scope,
+                           const gchar* icon_name,
+                           gint size,
+                           gboolean* null_result)
+{
+    *null_result = FALSE;
+
+    if (!awn_icon_disk_cache_has_entry(cache, theme_name, scope,
+                                       icon_name, size)) {
+        return NULL;
+    }
+
+    return awn_icon_disk_cache_read(cache,
+                                    awn_icon_disk_cache_get_stamp(cache, theme,
+                                                                  theme_name),
+                                    theme_name, scope, icon_name, size,
+                                    null_result);
+}
+
+/**
+ * awn_icon_disk_cache_write:
+ * @cache: A pointer to an #AwnIconDiskCache.
+ * @stamp: Stamp of the theme from awn_icon_disk_cache_get_stamp().
+ * @theme_name: Name of the icon theme.
+ * @scope: Scope of the icon (can be NULL).
+ * @icon_name: Name of the icon.
+ * @size: Requested size of the icon.
+ * @pbuf: The resolved icon.
+ *
+ * Stores a resolved icon, can be called from any thread.
+ */
+
+void
+awn_icon_disk_cache_write(AwnIconDiskCache* cache,
+                          guint64 stamp,
+                          const gchar* theme_name,
+                          const gchar* scope,
+                          const gchar* icon_name,
+                          gint size,
+                          GdkPixbuf* pbuf)
+{
+    GError* error = NULL;
+    gboolean writes_disabled;
+
+    g_return_if_fail(cache != NULL);
+    g_return_if_fail(theme_name && icon_name && pbuf);
+
+    G_LOCK(disk_cache_writes);
+    writes_disabled = cache->writes_disabled;
+    G_UNLOCK(disk_cache_writes);
+
+    if (cache->disabled || writes_disabled) {
+        return;
+    }
+
+    if (gdk_pixbuf_get_colorspace(pbuf) != GDK_COLORSPACE_RGB ||
+            gdk_pixbuf_get_bits_per_sample(pbuf) != 8) {
+        return;
+    }
+
+    gchar* key = disk_cache_get_key(theme_name, scope, icon_name, size);
+    gchar* filename = disk_cache_get_filename(key);
+    gchar* path = g_build_filename(cache->dir, filename, NULL);
+    gsize key_len = strlen(key);
+    gsize data_offset = ALIGN8(sizeof(DiskRecord) + key_len);
+    gint width = gdk_pixbuf_get_width(pbuf);
+    gint height = gdk_pixbuf_get_height(pbuf);
+    gint rowstride = gdk_pixbuf_get_rowstride(pbuf);
+    gsize length = data_offset + (gsize)rowstride * height;
+    gchar* contents = g_malloc0(length);
+    DiskRecord* record = (DiskRecord*)contents;
+
+    memcpy(record->magic, DISK_CACHE_MAGIC, sizeof(record->magic));
+    record->stamp = stamp;
+    record->key_len = key_len;
+    record->width = width;
+    record->height = height;
+    record->rowstride = rowstride;
+    record->has_alpha = gdk_pixbuf_get_has_alpha(pbuf);
+    memcpy(record + 1, key, key_len);
+
+    /* the last row of a pixbuf doesn't have to be padded */
+    gsize row_len = width * gdk_pixbuf_get_n_channels(pbuf);
+    guchar* pixels = gdk_pixbuf_get_pixels(pbuf);
+    for (gint y = 0; y < height; y++) {
+        memcpy(contents + data_offset + y * rowstride,
+               pixels + y * rowstride, row_len);
+    }
+
+    if (g_file_set_contents(path, contents, length, &error)) {
+        G_LOCK(disk_cache_writes);
+        cache->failures = 0;
+        G_UNLOCK(disk_cache_writes);
+
+        G_LOCK(disk_cache_index);
+        g_hash_table_replace(cache->index, filename, GINT_TO_POINTER(1));
+        G_UNLOCK(disk_cache_index);
+        filename = NULL;
+    } else {
+        g_warning("Unable to write icon cache: %s", error->message);
+        g_error_free(error);
+
+        /* a full disk might get cleaned up, don't give up right away */
+        G_LOCK(disk_cache_writes);
+        if (++cache->failures >= DISK_CACHE_MAX_FAILURES &&
+                !cache->writes_disabled) {
+            g_warning("Too many failures, not writing the icon cache "
+                      "anymore");
+            cache->writes_disabled = TRUE;
+        }
+        G_UNLOCK(disk_cache_writes);
+    }
+
+    g_free(contents);
+    g_free(filename);
+    g_free(path);
+    g_free(key);
+}
+
+static void
+disk_cache_write_thread(gpointer data, gpointer user_data)
+{
+    DiskCacheWrite* item = data;
+
+    awn_icon_disk_cache_write((AwnIconDiskCache*)user_data, item->stamp,
+                              item->theme_name, item->scope,
+                              item->icon_name, item->size, item->pixbuf);
+
+    g_object_unref(item->pixbuf);
+    g_free(item->icon_name);
+    g_free(item->scope);
+    g_free(item->theme_name);
+    g_free(item);
+}
+
+/**
+ * awn_icon_disk_cache_insert:
+ * @cache: A pointer to an #AwnIconDiskCache.
+ * @theme: The #GtkIconTheme the icon was looked up in.
+ * @theme_name: Name of the icon theme.
+ * @scope: Scope of the icon (can be NULL).
+ * @icon_name: Name of the icon.
+ * @size: Requested size of the icon.
+ * @pbuf: The resolved icon or NULL if it couldn't be loaded.
+ *
+ * Stores the result of an icon lookup made in the main thread, the file
+ * is written by a separate thread if possible. Failed lookups (@pbuf being
+ * NULL) aren't stored.
+ */
+
+void
+awn_icon_disk_cache_insert(AwnIconDiskCache* cache,
+                           GtkIconTheme* theme,
+                           const gchar* theme_name,
+                           const gchar* scope,
+                           const gchar* icon_name,
+                           gint size,
+                           GdkPixbuf* pbuf)
+{
+    g_return_if_fail(cache != NULL);
+    g_return_if_fail(theme_name && icon_name);
+
+    if (!pbuf || cache->disabled) {
+        return;
+    }
+
+    guint64 stamp = awn_icon_disk_cache_get_stamp(cache, theme, theme_name);
+
+    if (!cache->write_pool && g_thread_supported()) {
+        cache->write_pool = g_thread_pool_new(disk_cache_write_thread, cache,
+                                              1, FALSE, NULL);
+    }
+    if (!cache->write_pool) {
+        awn_icon_disk_cache_write(cache, stamp, theme_name, scope,
+                                  icon_name, size, pbuf);
+        return;
+    }
+
+    DiskCacheWrite* item = g_new(DiskCacheWrite, 1);
+    item->stamp = stamp;
+    item->theme_name = g_strdup(theme_name);
+    item->scope = g_strdup(scope);
+    item->icon_name = g_strdup(icon_name);
+    item->size = size;
+    item->pixbuf = g_object_ref(pbuf);
+
+    g_thread_pool_push(cache->write_pool, item, NULL);
+}
+
+/**
+ * awn_icon_disk_cache_invalidate:
+ * @cache: A pointer to an #AwnIconDiskCache.
+ *
+ * Makes the cache recheck the theme directories, should be called when
+ * an icon theme changes.
+ */
+
+void
+awn_icon_disk_cache_invalidate(AwnIconDiskCache* cache)
+{
+    g_return_if_fail(cache != NULL);
+
+    g_hash_table_remove_all(cache->stamps);
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2009 Michal Hruby <michal.mhr@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* awn-icon-disk-cache.h */
+
+#ifndef _AWN_ICON_DISK_CACHE
+#define _AWN_ICON_DISK_CACHE
+
+#include <gtk/gtk.h>
+
+/* Persistent cache of resolved and scaled theme icons, used by AwnThemedIcon */
+
+typedef struct _AwnIconDiskCache AwnIconDiskCache;
+
+AwnIconDiskCache* awn_icon_disk_cache_get_default(void);
+
+guint64 awn_icon_disk_cache_get_stamp(AwnIconDiskCache* cache,
+                                      GtkIconTheme* theme,
+                                      const gchar* theme_name);
+
+gboolean awn_icon_disk_cache_has_entry(AwnIconDiskCache* cache,
+                                       const gchar* theme_name,
+                                       const gchar* scope,
+                                       const gchar* icon_name,
+                                       gint size);
+
+GdkPixbuf* awn_icon_disk_cache_read(AwnIconDiskCache* cache,
+                                    guint64 stamp,
+                                    const gchar* theme_name,
+                                    const gchar* scope,
+                                    const gchar* icon_name,
+                                    gint size,
+                                    gboolean* null_result);
+
+GdkPixbuf* awn_icon_disk_cache_lookup(AwnIconDiskCache* cache,
+                                      GtkIconTheme* theme,
+                                      const gchar* theme_name,
+                                      const gchar* scope,
+                                      const gchar* icon_name,
+                                      gint size,
+                                      gboolean* null_result);
+
+void awn_icon_disk_cache_write(AwnIconDiskCache* cache,
+                               guint64 stamp,
+                               const gchar* theme_name,
+                               const gchar* scope,
+                               const gchar* icon_name,
+                               gint size,
+                               GdkPixbuf* pbuf);
+
+void awn_icon_disk_cache_insert(AwnIconDiskCache* cache,
+                                GtkIconTheme* theme,
+                                const gchar* theme_name,
+                                const gchar* scope,
+                                const gchar* icon_name,
+                                gint size,
+                                GdkPixbuf* pbuf);
+
+void awn_icon_disk_cache_invalidate(AwnIconDiskCache* cache);
+
+#endif /* _AWN_ICON_DISK_CACHE */
@@ -32,6 +32,9 @@
 static void awn_icon_overlayable_init(AwnOverlayableIface* iface);
 
 static AwnEffects* awn_icon_get_effects(AwnOverlayable* icon);
+static void awn_icon_bind_tooltip(AwnIcon* icon);
+static void awn_icon_unbind_tooltip(AwnIcon* icon);
+static void awn_icon_update_tooltip_pos(AwnIcon* icon);
 
 extern "C" {
     G_DEFINE_TYPE_WITH_CODE(AwnIcon, awn_icon, GTK_TYPE_DRAWING_AREA,
@@ -45,7 +48,10 @@ extern "C" {
 
 struct _AwnIconPrivate {
     AwnEffects*   effects;
+    /* lent from tooltip_pool while tooltip_shared is set */
     GtkWidget*    tooltip;
+    gboolean      tooltip_shared;
+    gchar*        tooltip_text;
 
     gboolean bind_effects;
     gboolean hover_effects_enable;
@@ -66,6 +72,8 @@ struct _AwnIconPrivate {
 
     /* Info relating to the current icon */
     cairo_surface_t* icon_srfc;
+    /* identifies content of icon_srfc for AwnEffects' cache, 0 if unknown */
+    guint icon_serial;
 };
 
 enum {
@@ -90,6 +98,17 @@ enum {
 };
 static guint32 _icon_signals[LAST_SIGNAL] = { 0 };
 
+/* source of AwnIconPrivate::icon_serial values */
+static guint icon_serial_counter = 0;
+
+/* Every AwnTooltip is a toplevel window, one per icon adds up quickly with
+ * a full taskmanager. Icons borrow a tooltip from this pool when the pointer
+ * enters them instead, see awn_icon_bind_tooltip(). The icon a tooltip is
+ * lent to is kept in its tooltip_owner_quark data.
+ */
+static GSList* tooltip_pool = NULL;
+static GQuark tooltip_owner_quark = 0;
+
 /* GObject stuff */
 static gboolean
 awn_icon_enter_notify_event(GtkWidget* widget, GdkEventCrossing* event)
@@ -100,6 +119,8 @@ awn_icon_enter_notify_event(GtkWidget* widget, GdkEventCrossing* event)
         awn_effects_start(priv->effects, AWN_EFFECT_HOVER);
     }
 
+    awn_icon_bind_tooltip(AWN_ICON(widget));
+
     return FALSE;
 }
 
@@ -169,6 +190,11 @@ awn_icon_expose_event(GtkWidget* widget, GdkEventExpose* event)
 
     g_return_val_if_fail(priv->icon_srfc, FALSE);
 
+    if (awn_effects_cairo_paint_cached(priv->effects, event,
+                                       priv->icon_serial)) {
+        return FALSE;
+    }
+
     /* clip the drawing region, nvidia likes it */
     cr = awn_effects_cairo_create_clipped(priv->effects, event);
 
@@ -467,7 +493,9 @@ awn_icon_dispose(GObject* object)
                 object, NULL);
     }
 
-    if (priv->tooltip) {
+    if (priv->tooltip_shared) {
+        awn_icon_unbind_tooltip(AWN_ICON(object));
+    } else if (priv->tooltip) {
         gtk_widget_destroy(priv->tooltip);
     }
     priv->tooltip = NULL;
@@ -496,6 +524,7 @@ awn_icon_finalize(GObject* object)
     if (priv->effects) {
         g_object_unref(priv->effects);
     }
+    g_free(priv->tooltip_text);
     G_OBJECT_CLASS(awn_icon_parent_class)->finalize(object);
 }
 
@@ -623,7 +652,10 @@ awn_icon_init(AwnIcon* icon)
     priv->size = 50;
     priv->icon_width = 0;
     priv->icon_height = 0;
-    priv->tooltip = awn_tooltip_new_for_widget(GTK_WIDGET(icon));
+    /* bound on the first enter-notify-event */
+    priv->tooltip = NULL;
+    priv->tooltip_shared = FALSE;
+    priv->tooltip_text = NULL;
 
     priv->effects = awn_effects_new_for_widget(GTK_WIDGET(icon));
     gtk_widget_add_events(GTK_WIDGET(icon), GDK_ALL_EVENTS_MASK);
@@ -667,6 +699,10 @@ awn_icon_update_tooltip_pos(AwnIcon* icon)
     g_return_if_fail(AWN_IS_ICON(icon));
     priv = icon->priv;
 
+    if (!priv->tooltip) {
+        return;
+    }
+
     /* we could set tooltip_offset = priv->offset, and use
      * different offset in AwnTooltip
      * (do we want different icon bar offset and tooltip offset?)
@@ -855,20 +891,100 @@ awn_icon_get_effects(AwnOverlayable* icon)
     return AWN_ICON_GET_PRIVATE(icon)->effects;
 }
 
+static void
+awn_icon_unbind_tooltip(AwnIcon* icon)
+{
+    AwnIconPrivate* priv = icon->priv;
+
+    awn_tooltip_set_focus_widget(AWN_TOOLTIP(priv->tooltip), NULL);
+    gtk_widget_hide(priv->tooltip);
+    g_object_set_qdata(G_OBJECT(priv->tooltip), tooltip_owner_quark, NULL);
+    priv->tooltip = NULL;
+    priv->tooltip_shared = FALSE;
+}
+
+/* Lends a tooltip from the pool to the icon, preferring one that isn't lent
+ * to any icon, then one that isn't showing. The pool only grows when all of
+ * its tooltips are on screen.
+ */
+static void
+awn_icon_bind_tooltip(AwnIcon* icon)
+{
+    AwnIconPrivate* priv = icon->priv;
+    GtkWidget* tooltip = NULL;
+    AwnIcon* owner = NULL;
+
+    if (priv->tooltip || !priv->tooltip_text) {
+        return;
+    }
+
+    if (!tooltip_owner_quark) {
+        tooltip_owner_quark = g_quark_from_static_string("awn-icon-tooltip-owner");
+    }
+
+    for (GSList* iter = tooltip_pool; iter; iter = iter->next) {
+        GtkWidget* candidate = GTK_WIDGET(iter->data);
+        AwnIcon* candidate_owner = (AwnIcon*)g_object_get_qdata(G_OBJECT(candidate),
+                                   tooltip_owner_quark);
+
+        if (!candidate_owner) {
+            tooltip = candidate;
+            owner = NULL;
+            break;
+        }
+        if (!tooltip && !gtk_widget_get_visible(candidate)) {
+            tooltip = candidate;
+            owner = candidate_owner;
+        }
+    }
+
+    if (owner) {
+        awn_icon_unbind_tooltip(owner);
+    } else if (!tooltip) {
+        tooltip = awn_tooltip_new_for_widget(NULL);
+        tooltip_pool = g_slist_prepend(tooltip_pool, tooltip);
+    }
+
+    g_object_set_qdata(G_OBJECT(tooltip), tooltip_owner_quark, icon);
+    priv->tooltip = tooltip;
+    priv->tooltip_shared = TRUE;
+
+    awn_tooltip_set_text(AWN_TOOLTIP(tooltip), priv->tooltip_text);
+    awn_icon_update_tooltip_pos(icon);
+    /* starts the show timer, the pointer is already over the icon */
+    awn_tooltip_set_focus_widget(AWN_TOOLTIP(tooltip), GTK_WIDGET(icon));
+}
+
 /**
  * awn_icon_get_tooltip:
  * @icon: an #AwnIcon.
  *
- * Gets the #AwnTooltip associated with this icon.
+ * Gets the #AwnTooltip associated with this icon. Icons normally share their
+ * tooltip windows with other icons, calling this function gives the icon a
+ * tooltip of its own which can be customized freely.
  *
  * Returns: tooltip widget.
  */
 AwnTooltip*
 awn_icon_get_tooltip(AwnIcon* icon)
 {
+    AwnIconPrivate* priv;
+
     g_return_val_if_fail(AWN_IS_ICON(icon), NULL);
+    priv = icon->priv;
 
-    return AWN_TOOLTIP(icon->priv->tooltip);
+    if (priv->tooltip_shared) {
+        /* keep the one we have, but take it out of the pool */
+        tooltip_pool = g_slist_remove(tooltip_pool, priv->tooltip);
+        g_object_set_qdata(G_OBJECT(priv->tooltip), tooltip_owner_quark, NULL);
+        priv->tooltip_shared = FALSE;
+    } else if (!priv->tooltip) {
+        priv->tooltip = awn_tooltip_new_for_widget(GTK_WIDGET(icon));
+        awn_tooltip_set_text(AWN_TOOLTIP(priv->tooltip), priv->tooltip_text);
+        awn_icon_update_tooltip_pos(icon);
+    }
+
+    return AWN_TOOLTIP(priv->tooltip);
 }
 
 /*
@@ -885,6 +1001,7 @@ free_existing_icon(AwnIcon* icon)
 
     cairo_surface_destroy(priv->icon_srfc);
     priv->icon_srfc = NULL;
+    priv->icon_serial = 0;
 }
 
 /**
@@ -920,6 +1037,9 @@ awn_icon_set_from_pixbuf(AwnIcon* icon, GdkPixbuf* pixbuf)
 
     cairo_destroy(temp_cr);
 
+    /* we own the surface, so its content can't change behind our back */
+    priv->icon_serial = ++icon_serial_counter;
+
     /* Queue a redraw */
     update_widget_size(icon);
     gtk_widget_queue_draw(GTK_WIDGET(icon));
@@ -1027,9 +1147,17 @@ void
 awn_icon_set_tooltip_text(AwnIcon*     icon,
                           const gchar* text)
 {
+    AwnIconPrivate* priv;
+
     g_return_if_fail(AWN_IS_ICON(icon));
+    priv = icon->priv;
 
-    awn_tooltip_set_text(AWN_TOOLTIP(icon->priv->tooltip), text);
+    g_free(priv->tooltip_text);
+    priv->tooltip_text = g_strdup(text);
+
+    if (priv->tooltip) {
+        awn_tooltip_set_text(AWN_TOOLTIP(priv->tooltip), text);
+    }
 }
 
 /**
@@ -1044,9 +1172,16 @@ awn_icon_set_tooltip_text(AwnIcon*     icon,
 gchar*
 awn_icon_get_tooltip_text(AwnIcon* icon)
 {
+    AwnIconPrivate* priv;
+
     g_return_val_if_fail(AWN_IS_ICON(icon), NULL);
+    priv = icon->priv;
 
-    return awn_tooltip_get_text(AWN_TOOLTIP(icon->priv->tooltip));
+    /* an own tooltip might have been given a text directly */
+    if (priv->tooltip && !priv->tooltip_shared) {
+        return awn_tooltip_get_text(AWN_TOOLTIP(priv->tooltip));
+    }
+    return g_strdup(priv->tooltip_text);
 }
 
 /**
@@ -37,6 +37,7 @@
 /* awn-overlay-progress-circle.c */
 
 #include <math.h>
+#include <string.h>
 #include "awn-cairo-utils.h"
 #include "awn-overlay-progress-circle.h"
 
@@ -49,12 +50,35 @@ extern "C" {
 
 typedef struct _AwnOverlayProgressCirclePrivate AwnOverlayProgressCirclePrivate;
 
+/* what the background disc depends on, compared with memcmp */
+typedef struct {
+    gint    width;
+    gint    height;
+    gdouble scale;
+    gdouble x;
+    gdouble y;
+    gdouble bg[4];
+} AwnProgressCircleDiscKey;
+
 struct _AwnOverlayProgressCirclePrivate {
     DesktopAgnosticColor* bg_color;
     DesktopAgnosticColor* fg_color;
     DesktopAgnosticColor* outline_color;
 
     gdouble scale;
+
+    /* The background disc, and the disc with the wedge on top for
+     * rendered_percent. Both cover the area at surface_x, surface_y. */
+    cairo_surface_t* disc;
+    AwnProgressCircleDiscKey disc_key;
+    cairo_surface_t* surface;
+    gdouble rendered_percent;
+    gdouble rendered_fg[4];
+    gdouble rendered_outline[4];
+    gint surface_x;
+    gint surface_y;
+    gint surface_width;
+    gint surface_height;
 };
 
 enum {
@@ -108,19 +132,19 @@ awn_overlay_progress_circle_set_property(GObject* object, guint property_id,
         if (priv->fg_color) {
             g_object_unref(priv->fg_color);
         }
-        priv->fg_color = g_value_get_object(value);
+        priv->fg_color = g_value_dup_object(value);
         break;
     case PROP_BACKGROUND_COLOR:
         if (priv->bg_color) {
             g_object_unref(priv->bg_color);
         }
-        priv->bg_color = g_value_get_object(value);
+        priv->bg_color = g_value_dup_object(value);
         break;
     case PROP_OUTLINE_COLOR:
         if (priv->outline_color) {
             g_object_unref(priv->outline_color);
         }
-        priv->outline_color = g_value_get_object(value);
+        priv->outline_color = g_value_dup_object(value);
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -130,6 +154,29 @@ awn_overlay_progress_circle_set_property(GObject* object, guint property_id,
 static void
 awn_overlay_progress_circle_dispose(GObject* object)
 {
+    AwnOverlayProgressCirclePrivate* priv = AWN_OVERLAY_PROGRESS_CIRCLE_GET_PRIVATE(object);
+
+    if (priv->fg_color) {
+        g_object_unref(priv->fg_color);
+        priv->fg_color = NULL;
+    }
+    if (priv->bg_color) {
+        g_object_unref(priv->bg_color);
+        priv->bg_color = NULL;
+    }
+    if (priv->outline_color) {
+        g_object_unref(priv->outline_color);
+        priv->outline_color = NULL;
+    }
+    if (priv->disc) {
+        cairo_surface_destroy(priv->disc);
+        priv->disc = NULL;
+    }
+    if (priv->surface) {
+        cairo_surface_destroy(priv->surface);
+        priv->surface = NULL;
+    }
+
     G_OBJECT_CLASS(awn_overlay_progress_circle_parent_class)->dispose(object);
 }
 
@@ -232,6 +279,35 @@ awn_overlay_progress_circle_new(void)
     return g_object_new(AWN_TYPE_OVERLAY_PROGRESS_CIRCLE, NULL);
 }
 
+static void
+_get_rgba(DesktopAgnosticColor* color, const GdkColor* fallback,
+          gdouble fallback_alpha, gdouble* rgba)
+{
+    if (color) {
+        desktop_agnostic_color_get_cairo_color(color, &rgba[0], &rgba[1],
+                                               &rgba[2], &rgba[3]);
+    } else {
+        rgba[0] = fallback->red / 65535.0;
+        rgba[1] = fallback->green / 65535.0;
+        rgba[2] = fallback->blue / 65535.0;
+        rgba[3] = fallback_alpha;
+    }
+}
+
+/* sets up cr to draw in the coordinates of the icon, scaled to [0,0] - [1,1] */
+static cairo_t*
+_create_context(AwnOverlayProgressCirclePrivate* priv, cairo_surface_t* surface,
+                const AwnProgressCircleDiscKey* key)
+{
+    cairo_t* cr = cairo_create(surface);
+
+    cairo_translate(cr, -priv->surface_x, -priv->surface_y);
+    cairo_scale(cr, key->width, key->height);
+    cairo_set_line_width(cr, 2. / (key->width + key->height));
+
+    return cr;
+}
+
 static void
 _awn_overlay_progress_circle_render(AwnOverlay* _overlay,
                                     GtkWidget* widget,
@@ -241,38 +317,17 @@ _awn_overlay_progress_circle_render(AwnOverlay* _overlay,
 {
     AwnOverlayProgressCircle* overlay = AWN_OVERLAY_PROGRESS_CIRCLE(_overlay);
     AwnOverlayProgressCirclePrivate* priv;
-    DesktopAgnosticColor* fg_color;
-    DesktopAgnosticColor* bg_color;
-    DesktopAgnosticColor* outline_color;
+    AwnProgressCircleDiscKey key;
+    const GdkColor* active_fg = &widget->style->fg[GTK_STATE_ACTIVE];
+    gdouble fg[4], outline[4];
     gdouble percent_complete, x_pos, y_pos;
     AwnOverlayCoord coord;
+    cairo_t* surface_cr;
 
     priv =  AWN_OVERLAY_PROGRESS_CIRCLE_GET_PRIVATE(overlay);
 
-    g_object_get(overlay,
-                 "percent-complete", &percent_complete,
-                 NULL);
-    if (priv->fg_color) {
-        fg_color = priv->fg_color;
-        g_object_ref(fg_color);
-    } else {
-        fg_color = desktop_agnostic_color_new(&widget->style->bg[GTK_STATE_ACTIVE],
-                                              0.7 * G_MAXUSHORT);
-    }
-    if (priv->bg_color) {
-        bg_color = priv->bg_color;
-        g_object_ref(bg_color);
-    } else {
-        bg_color = desktop_agnostic_color_new(&widget->style->fg[GTK_STATE_ACTIVE],
-                                              0.2 * G_MAXUSHORT);
-    }
-    if (priv->outline_color) {
-        outline_color = priv->outline_color;
-        g_object_ref(outline_color);
-    } else {
-        outline_color = desktop_agnostic_color_new(&widget->style->fg[GTK_STATE_ACTIVE],
-                        G_MAXUSHORT);
-    }
+    percent_complete =
+        awn_overlay_progress_get_rendered_percent(AWN_OVERLAY_PROGRESS(overlay));
 
     awn_overlay_move_to(_overlay, cr,  width, height,
                         width * priv->scale, height * priv->scale,
@@ -280,35 +335,97 @@ _awn_overlay_progress_circle_render(AwnOverlay* _overlay,
     x_pos = coord.x / width + priv->scale / 2.0;
     y_pos = coord.y / height + priv->scale / 2.0;
 
-    cairo_save(cr);
-    cairo_scale(cr, width, height);
-    cairo_set_line_width(cr, 2. / (width + height));
-
-    awn_cairo_set_source_color(cr, bg_color);
-    cairo_arc(cr, x_pos, y_pos, priv->scale / 2.0, 0, 2 * M_PI);
-    cairo_fill(cr);
-
-    cairo_arc(cr, x_pos, y_pos, priv->scale / 2.0, -0.5 * M_PI,
-              2 * (percent_complete / 100.0) * M_PI - 0.5 * M_PI);
-    cairo_line_to(cr, x_pos, y_pos);
-    cairo_close_path(cr);
-    awn_cairo_set_source_color(cr, fg_color);
-    cairo_fill(cr);
-
-    if (percent_complete > 0) {
-        cairo_arc(cr, x_pos, y_pos, priv->scale / 2.0, -0.5 * M_PI,
-                  2 * (percent_complete / 100.0) * M_PI - 0.5 * M_PI);
+    memset(&key, 0, sizeof(key));
+    key.width = width;
+    key.height = height;
+    key.scale = priv->scale;
+    key.x = coord.x;
+    key.y = coord.y;
+    _get_rgba(priv->bg_color, active_fg,
+              (gushort)(0.2 * G_MAXUSHORT) / (gdouble)G_MAXUSHORT, key.bg);
+    _get_rgba(priv->fg_color, &widget->style->bg[GTK_STATE_ACTIVE],
+              (gushort)(0.7 * G_MAXUSHORT) / (gdouble)G_MAXUSHORT, fg);
+    _get_rgba(priv->outline_color, active_fg, 1.0, outline);
+
+    /* the disc only changes with the size, position and background colour */
+    if (!priv->disc || memcmp(&key, &priv->disc_key, sizeof(key)) != 0) {
+        /* one pixel around for the outline */
+        priv->surface_x = (gint)floor(coord.x) - 1;
+        priv->surface_y = (gint)floor(coord.y) - 1;
+
+        if (priv->disc) {
+            cairo_surface_destroy(priv->disc);
+        }
+        if (priv->surface) {
+            cairo_surface_destroy(priv->surface);
+            priv->surface = NULL;
+        }
+
+        priv->surface_width =
+            (gint)ceil(coord.x + width * priv->scale) + 1 - priv->surface_x;
+        priv->surface_height =
+            (gint)ceil(coord.y + height * priv->scale) + 1 - priv->surface_y;
+        priv->disc = cairo_surface_create_similar(cairo_get_target(cr),
+                     CAIRO_CONTENT_COLOR_ALPHA,
+                     priv->surface_width, priv->surface_height);
+
+        surface_cr = _create_context(priv, priv->disc, &key);
+        cairo_set_source_rgba(surface_cr, key.bg[0], key.bg[1], key.bg[2], key.bg[3]);
+        cairo_arc(surface_cr, x_pos, y_pos, priv->scale / 2.0, 0, 2 * M_PI);
+        cairo_fill(surface_cr);
+        cairo_destroy(surface_cr);
+
+        priv->disc_key = key;
+    }
+
+    /* and the wedge only with the quantized percentage and its colours */
+    if (!priv->surface || priv->rendered_percent != percent_complete ||
+            memcmp(fg, priv->rendered_fg, sizeof(fg)) != 0 ||
+            memcmp(outline, priv->rendered_outline, sizeof(outline)) != 0) {
+        if (!priv->surface) {
+            priv->surface = cairo_surface_create_similar(priv->disc,
+                            CAIRO_CONTENT_COLOR_ALPHA,
+                            priv->surface_width, priv->surface_height);
+        }
 
-        if (percent_complete < 100) {
-            cairo_line_to(cr, x_pos, y_pos);
-            cairo_close_path(cr);
+        surface_cr = _create_context(priv, priv->surface, &key);
+
+        cairo_save(surface_cr);
+        cairo_identity_matrix(surface_cr);
+        cairo_set_operator(surface_cr, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(surface_cr, priv->disc, 0, 0);
+        cairo_paint(surface_cr);
+        cairo_restore(surface_cr);
+
+        cairo_arc(surface_cr, x_pos, y_pos, priv->scale / 2.0, -0.5 * M_PI,
+                  2 * (percent_complete / 100.0) * M_PI - 0.5 * M_PI);
+        cairo_line_to(surface_cr, x_pos, y_pos);
+        cairo_close_path(surface_cr);
+        cairo_set_source_rgba(surface_cr, fg[0], fg[1], fg[2], fg[3]);
+        cairo_fill(surface_cr);
+
+        if (percent_complete > 0) {
+            cairo_arc(surface_cr, x_pos, y_pos, priv->scale / 2.0, -0.5 * M_PI,
+                      2 * (percent_complete / 100.0) * M_PI - 0.5 * M_PI);
+
+            if (percent_complete < 100) {
+                cairo_line_to(surface_cr, x_pos, y_pos);
+                cairo_close_path(surface_cr);
+            }
+            cairo_set_source_rgba(surface_cr, outline[0], outline[1],
+                                  outline[2], outline[3]);
+            cairo_stroke(surface_cr);
         }
-        awn_cairo_set_source_color(cr, outline_color);
-        cairo_stroke(cr);
+
+        cairo_destroy(surface_cr);
+
+        priv->rendered_percent = percent_complete;
+        memcpy(priv->rendered_fg, fg, sizeof(fg));
+        memcpy(priv->rendered_outline, outline, sizeof(outline));
     }
 
+    cairo_save(cr);
+    cairo_set_source_surface(cr, priv->surface, priv->surface_x, priv->surface_y);
+    cairo_paint(cr);
     cairo_restore(cr);
-    g_object_unref(fg_color);
-    g_object_unref(bg_color);
-    g_object_unref(outline_color);
 }
@@ -37,6 +37,8 @@
 
 /* awn-overlay-progress.c */
 
+#include <math.h>
+
 #include "awn-overlay-progress.h"
 
 extern "C" {
@@ -50,13 +52,40 @@ typedef struct _AwnOverlayProgressPrivate AwnOverlayProgressPrivate;
 
 struct _AwnOverlayProgressPrivate {
     gdouble percent_complete;
+    gdouble quantization_step;
+    /* percent_complete quantized to quantization_step */
+    gdouble rendered_percent;
 };
 
 enum {
     PROP_0,
-    PROP_PERCENT_COMPLETE
+    PROP_PERCENT_COMPLETE,
+    PROP_QUANTIZATION_STEP,
+    PROP_RENDERED_PERCENT
 };
 
+static gdouble
+_quantize(gdouble percent, gdouble step)
+{
+    if (step <= 0.0 || percent >= 100.0) {
+        return percent;
+    }
+    return floor(percent / step) * step;
+}
+
+static void
+_update_rendered_percent(GObject* object)
+{
+    AwnOverlayProgressPrivate* priv = AWN_OVERLAY_PROGRESS_GET_PRIVATE(object);
+    gdouble percent = _quantize(priv->percent_complete,
+                                priv->quantization_step);
+
+    if (percent != priv->rendered_percent) {
+        priv->rendered_percent = percent;
+        g_object_notify(object, "rendered-percent");
+    }
+}
+
 static void
 awn_overlay_progress_get_property(GObject* object, guint property_id,
                                   GValue* value, GParamSpec* pspec)
@@ -66,6 +95,12 @@ awn_overlay_progress_get_property(GObject* object, guint property_id,
     case PROP_PERCENT_COMPLETE:
         g_value_set_double(value, priv->percent_complete);
         break;
+    case PROP_QUANTIZATION_STEP:
+        g_value_set_double(value, priv->quantization_step);
+        break;
+    case PROP_RENDERED_PERCENT:
+        g_value_set_double(value, priv->rendered_percent);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
     }
@@ -79,6 +114,11 @@ awn_overlay_progress_set_property(GObject* object, guint property_id,
     switch (property_id) {
     case PROP_PERCENT_COMPLETE:
         priv->percent_complete = g_value_get_double(value);
+        _update_rendered_percent(object);
+        break;
+    case PROP_QUANTIZATION_STEP:
+        priv->quantization_step = g_value_get_double(value);
+        _update_rendered_percent(object);
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -122,12 +162,52 @@ awn_overlay_progress_class_init(AwnOverlayProgressClass* klass)
                                             G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
                                             G_PARAM_STATIC_STRINGS));
 
+    /**
+     * AwnOverlayProgress:quantization-step:
+     *
+     * The completion percentage is rendered rounded down to a multiple of
+     * this step, changes of #AwnOverlayProgress:percent-complete within
+     * a step don't change #AwnOverlayProgress:rendered-percent and don't
+     * cause the overlay to be redrawn. A step of 0.0 renders every change.
+     * Default value of 1.0
+     */
+
+    g_object_class_install_property(object_class,
+                                    PROP_QUANTIZATION_STEP,
+                                    g_param_spec_double("quantization-step",
+                                            "Quantization Step",
+                                            "Quantization Step",
+                                            0.0, 100.0, 1.0,
+                                            G_PARAM_READWRITE | G_PARAM_CONSTRUCT |
+                                            G_PARAM_STATIC_STRINGS));
+
+    /**
+     * AwnOverlayProgress:rendered-percent:
+     *
+     * A read-only property of type double. The completion percentage which
+     * is rendered, #AwnOverlayProgress:percent-complete rounded down to
+     * #AwnOverlayProgress:quantization-step. Redraws are driven by changes
+     * of this property.
+     */
+
+    g_object_class_install_property(object_class,
+                                    PROP_RENDERED_PERCENT,
+                                    g_param_spec_double("rendered-percent",
+                                            "Rendered Percent",
+                                            "Rendered Percent",
+                                            0.0, 100.0, 0.0,
+                                            G_PARAM_READABLE |
+                                            G_PARAM_STATIC_STRINGS));
+
     g_type_class_add_private(klass, sizeof(AwnOverlayProgressPrivate));
 }
 
 static void
 awn_overlay_progress_init(AwnOverlayProgress* self)
 {
+    AwnOverlayProgressPrivate* priv = AWN_OVERLAY_PROGRESS_GET_PRIVATE(self);
+
+    priv->rendered_percent = 0.0;
 }
 
 /**
@@ -142,3 +222,24 @@ awn_overlay_progress_new(void)
 {
     return g_object_new(AWN_TYPE_OVERLAY_PROGRESS, NULL);
 }
+
+/**
+ * awn_overlay_progress_get_rendered_percent:
+ * @overlay: an #AwnOverlayProgress.
+ *
+ * Gets the completion percentage subclasses should render, that is
+ * #AwnOverlayProgress:percent-complete rounded down to
+ * #AwnOverlayProgress:quantization-step.
+ *
+ * Returns: the quantized completion percentage.
+ */
+gdouble
+awn_overlay_progress_get_rendered_percent(AwnOverlayProgress* overlay)
+{
+    AwnOverlayProgressPrivate* priv;
+
+    g_return_val_if_fail(AWN_IS_OVERLAY_PROGRESS(overlay), 0.0);
+    priv = AWN_OVERLAY_PROGRESS_GET_PRIVATE(overlay);
+
+    return priv->rendered_percent;
+}
@@ -59,6 +59,8 @@ GType awn_overlay_progress_get_type(void);
 
 AwnOverlayProgress* awn_overlay_progress_new(void);
 
+gdouble awn_overlay_progress_get_rendered_percent(AwnOverlayProgress* overlay);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -38,6 +38,8 @@
 
 #include <gtk/gtk.h>
 #include <pango/pangocairo.h>
+#include <math.h>
+#include <string.h>
 
 #include "awn-config.h"
 #include "awn-overlay-text.h"
@@ -52,6 +54,16 @@ extern "C" {
 
 typedef struct _AwnOverlayTextPrivate AwnOverlayTextPrivate;
 
+/* what the rendered text depends on besides the properties, compared with
+ * memcmp */
+typedef struct {
+    gint    height;
+    gdouble scale_x;
+    gdouble scale_y;
+    gdouble text_rgba[4];
+    gdouble outline_rgba[4];
+} AwnOverlayTextKey;
+
 struct _AwnOverlayTextPrivate {
     gchar* text;
     gdouble font_sizing;
@@ -63,6 +75,22 @@ struct _AwnOverlayTextPrivate {
     gint                   font_mode;
     gdouble                text_outline_width;
 
+    /* text_color_astr and text_outline_color_astr parsed */
+    DesktopAgnosticColor* text_astr_color;
+    DesktopAgnosticColor* text_outline_astr_color;
+
+    /* Badges are re-rendered with every frame of the effects, so the layout
+     * and the rendered text are kept until a property changes */
+    PangoLayout*           layout;
+    /* the height the layout was set up for, 0 if it needs to be set up */
+    gint                   layout_size;
+    gint                   layout_width;
+    gint                   layout_height;
+    cairo_surface_t*       surface;
+    AwnOverlayTextKey      surface_key;
+    /* space around the text for the outline */
+    gint                   surface_pad;
+
     DesktopAgnosticConfigClient* client;
 };
 
@@ -91,6 +119,25 @@ _awn_overlay_text_render(AwnOverlay* overlay,
                          gint width,
                          gint height);
 
+static void
+awn_overlay_text_invalidate(AwnOverlayTextPrivate* priv)
+{
+    priv->layout_size = 0;
+    if (priv->surface) {
+        cairo_surface_destroy(priv->surface);
+        priv->surface = NULL;
+    }
+}
+
+static DesktopAgnosticColor*
+_parse_color(const gchar* astr)
+{
+    if (astr && strlen(astr)) {
+        return desktop_agnostic_color_new_from_string(astr, NULL);
+    }
+    return NULL;
+}
+
 static void
 awn_overlay_text_get_property(GObject* object, guint property_id,
                               GValue* value, GParamSpec* pspec)
@@ -152,6 +199,10 @@ awn_overlay_text_set_property(GObject* object, guint property_id,
     case PROP_TEXT_COLOR_ASTR:
         g_free(priv->text_color_astr);
         priv->text_color_astr = g_value_dup_string(value);
+        if (priv->text_astr_color) {
+            g_object_unref(priv->text_astr_color);
+        }
+        priv->text_astr_color = _parse_color(priv->text_color_astr);
         break;
     case PROP_TEXT_OUTLINE_COLOR:
         if (priv->text_outline_color) {
@@ -162,6 +213,10 @@ awn_overlay_text_set_property(GObject* object, guint property_id,
     case PROP_TEXT_OUTLINE_COLOR_ASTR:
         g_free(priv->text_outline_color_astr);
         priv->text_outline_color_astr = g_value_dup_string(value);
+        if (priv->text_outline_astr_color) {
+            g_object_unref(priv->text_outline_astr_color);
+        }
+        priv->text_outline_astr_color = _parse_color(priv->text_outline_color_astr);
         break;
     case PROP_FONT_MODE:
         priv->font_mode = g_value_get_int(value);
@@ -171,7 +226,9 @@ awn_overlay_text_set_property(GObject* object, guint property_id,
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
+        return;
     }
+    awn_overlay_text_invalidate(priv);
 }
 
 static void
@@ -191,6 +248,19 @@ awn_overlay_text_dispose(GObject* object)
         g_object_unref(priv->text_outline_color);
         priv->text_outline_color = NULL;
     }
+    if (priv->text_astr_color) {
+        g_object_unref(priv->text_astr_color);
+        priv->text_astr_color = NULL;
+    }
+    if (priv->text_outline_astr_color) {
+        g_object_unref(priv->text_outline_astr_color);
+        priv->text_outline_astr_color = NULL;
+    }
+    if (priv->layout) {
+        g_object_unref(priv->layout);
+        priv->layout = NULL;
+    }
+    awn_overlay_text_invalidate(priv);
 
     G_OBJECT_CLASS(awn_overlay_text_parent_class)->dispose(object);
 }
@@ -433,81 +503,150 @@ void awn_overlay_text_get_size(AwnOverlayText* overlay,
 }
 
 static void
-_awn_overlay_text_render(AwnOverlay* _overlay,
-                         GtkWidget* widget,
-                         cairo_t* cr,
-                         gint width,
-                         gint height)
+_resolve_color(DesktopAgnosticColor* color, DesktopAgnosticColor* astr_color,
+               const GdkColor* fallback, gdouble* rgba)
 {
-    AwnOverlayText* overlay = AWN_OVERLAY_TEXT(_overlay);
-    DesktopAgnosticColor* text_colour = NULL;
-    DesktopAgnosticColor* text_outline_colour = NULL;
-    AwnOverlayTextPrivate* priv;
-    gint layout_width;
-    gint layout_height;
-    PangoLayout* layout;
-
-    priv =  AWN_OVERLAY_TEXT_GET_PRIVATE(overlay);
-
-    if (priv->text_color) {
-        text_colour = priv->text_color;
-        g_object_ref(text_colour);
-    } else if (priv->text_color_astr && strlen(priv->text_color_astr)) {
-        text_colour = desktop_agnostic_color_new_from_string(priv->text_color_astr, NULL);
-    }
-    if (!text_colour) {
-        text_colour = desktop_agnostic_color_new(&widget->style->fg[GTK_STATE_NORMAL], G_MAXUSHORT);
+    if (!color) {
+        color = astr_color;
     }
-    if (priv->text_outline_color) {
-        text_outline_colour = priv->text_outline_color;
-        g_object_ref(text_outline_colour);
-    } else if (priv->text_outline_color_astr && strlen(priv->text_outline_color_astr)) {
-        text_outline_colour = desktop_agnostic_color_new_from_string(priv->text_outline_color_astr, NULL);
-    }
-    if (!text_outline_colour) {
-        text_outline_colour = desktop_agnostic_color_new(&widget->style->bg[GTK_STATE_NORMAL], G_MAXUSHORT);
+    if (color) {
+        desktop_agnostic_color_get_cairo_color(color, &rgba[0], &rgba[1],
+                                               &rgba[2], &rgba[3]);
+    } else {
+        rgba[0] = fallback->red / 65535.0;
+        rgba[1] = fallback->green / 65535.0;
+        rgba[2] = fallback->blue / 65535.0;
+        rgba[3] = 1.0;
     }
+}
 
-    layout = pango_cairo_create_layout(cr);
-    pango_font_description_set_absolute_size(priv->font_description,
-            priv->font_sizing * PANGO_SCALE * height / 48.0);
-    pango_layout_set_font_description(layout, priv->font_description);
-    pango_layout_set_text(layout, priv->text, -1);
-    pango_layout_get_pixel_size(layout, &layout_width, &layout_height);
-    awn_overlay_move_to(_overlay, cr,  width, height, layout_width, layout_height, NULL);
-
+/* paints the layout at the current point */
+static void
+_awn_overlay_text_paint(AwnOverlayTextPrivate* priv, cairo_t* cr,
+                        const AwnOverlayTextKey* key)
+{
+    const gdouble* fill = key->text_rgba;
+    const gdouble* outline = key->outline_rgba;
 
     switch (priv->font_mode) {
     default:
     case FONT_MODE_SOLID:
-        awn_cairo_set_source_color(cr, text_colour);
-        pango_cairo_show_layout(cr, layout);
+        cairo_set_source_rgba(cr, fill[0], fill[1], fill[2], fill[3]);
+        pango_cairo_show_layout(cr, priv->layout);
         break;
     case FONT_MODE_OUTLINE:
     case FONT_MODE_OUTLINE_REVERSED:
         cairo_save(cr);
 
-        cairo_set_line_width(cr, priv->text_outline_width * height / 48.0);
+        if (priv->font_mode == FONT_MODE_OUTLINE_REVERSED) {
+            fill = key->outline_rgba;
+            outline = key->text_rgba;
+        }
+
+        cairo_set_line_width(cr, priv->text_outline_width * key->height / 48.0);
         // first paint the outline
-        /*conditional operator*/
-        awn_cairo_set_source_color(cr, priv->font_mode == FONT_MODE_OUTLINE ?
-                                   text_outline_colour : text_colour);
+        cairo_set_source_rgba(cr, outline[0], outline[1], outline[2], outline[3]);
         cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
-        pango_cairo_layout_path(cr, layout);
+        pango_cairo_layout_path(cr, priv->layout);
         cairo_stroke_preserve(cr);
 
         // now the text itself
-        awn_overlay_move_to(_overlay, cr, width, height,
-                            layout_width, layout_height, NULL);
-        /*conditional operator*/
-        awn_cairo_set_source_color(cr, priv->font_mode == FONT_MODE_OUTLINE ?
-                                   text_colour : text_outline_colour);
+        cairo_set_source_rgba(cr, fill[0], fill[1], fill[2], fill[3]);
         cairo_fill(cr);
 
         cairo_restore(cr);
         break;
     }
-    g_object_unref(text_colour);
-    g_object_unref(text_outline_colour);
-    g_object_unref(layout);
+}
+
+static void
+_awn_overlay_text_render(AwnOverlay* _overlay,
+                         GtkWidget* widget,
+                         cairo_t* cr,
+                         gint width,
+                         gint height)
+{
+    AwnOverlayText* overlay = AWN_OVERLAY_TEXT(_overlay);
+    AwnOverlayTextPrivate* priv;
+    AwnOverlayTextKey key;
+    cairo_matrix_t matrix;
+    gdouble x, y;
+
+    priv =  AWN_OVERLAY_TEXT_GET_PRIVATE(overlay);
+
+    memset(&key, 0, sizeof(key));
+    key.height = height;
+    _resolve_color(priv->text_color, priv->text_astr_color,
+                   &widget->style->fg[GTK_STATE_NORMAL], key.text_rgba);
+    _resolve_color(priv->text_outline_color, priv->text_outline_astr_color,
+                   &widget->style->bg[GTK_STATE_NORMAL], key.outline_rgba);
+
+    if (!priv->layout) {
+        priv->layout = pango_cairo_create_layout(cr);
+    } else {
+        pango_cairo_update_layout(cr, priv->layout);
+    }
+    if (priv->layout_size != height) {
+        pango_font_description_set_absolute_size(priv->font_description,
+                priv->font_sizing * PANGO_SCALE * height / 48.0);
+        pango_layout_set_font_description(priv->layout, priv->font_description);
+        pango_layout_set_text(priv->layout, priv->text, -1);
+        pango_layout_get_pixel_size(priv->layout,
+                                    &priv->layout_width, &priv->layout_height);
+        priv->layout_size = height;
+    }
+    awn_overlay_move_to(_overlay, cr,  width, height,
+                        priv->layout_width, priv->layout_height, NULL);
+
+    cairo_get_matrix(cr, &matrix);
+    if (matrix.xy != 0.0 || matrix.yx != 0.0 ||
+            matrix.xx <= 0.0 || matrix.yy <= 0.0) {
+        /* rotated or flipped, not worth caching */
+        _awn_overlay_text_paint(priv, cr, &key);
+        return;
+    }
+    key.scale_x = matrix.xx;
+    key.scale_y = matrix.yy;
+
+    if (!priv->surface ||
+            memcmp(&key, &priv->surface_key, sizeof(key)) != 0) {
+        cairo_t* surface_cr;
+
+        if (priv->surface) {
+            cairo_surface_destroy(priv->surface);
+        }
+
+        priv->surface_pad = 1;
+        if (priv->font_mode == FONT_MODE_OUTLINE ||
+                priv->font_mode == FONT_MODE_OUTLINE_REVERSED) {
+            priv->surface_pad += (gint)ceil(priv->text_outline_width * height / 96.0);
+        }
+
+        /* rendered in device pixels */
+        priv->surface = cairo_surface_create_similar(cairo_get_target(cr),
+                        CAIRO_CONTENT_COLOR_ALPHA,
+                        (gint)ceil((priv->layout_width + priv->surface_pad * 2) * key.scale_x),
+                        (gint)ceil((priv->layout_height + priv->surface_pad * 2) * key.scale_y));
+        surface_cr = cairo_create(priv->surface);
+        cairo_scale(surface_cr, key.scale_x, key.scale_y);
+        cairo_move_to(surface_cr, priv->surface_pad, priv->surface_pad);
+        pango_cairo_update_layout(surface_cr, priv->layout);
+        _awn_overlay_text_paint(priv, surface_cr, &key);
+        cairo_destroy(surface_cr);
+
+        priv->surface_key = key;
+    }
+
+    /* on whole device pixels, so the text isn't resampled */
+    cairo_get_current_point(cr, &x, &y);
+    x -= priv->surface_pad;
+    y -= priv->surface_pad;
+    cairo_user_to_device(cr, &x, &y);
+
+    cairo_save(cr);
+    cairo_identity_matrix(cr);
+    cairo_set_source_surface(cr, priv->surface, floor(x + 0.5), floor(y + 0.5));
+    cairo_paint(cr);
+    cairo_restore(cr);
+    cairo_new_path(cr);
 }
@@ -22,6 +22,7 @@
 
 #include <math.h>
 
+#include "awn-frame-clock.h"
 #include "awn-overlay-throbber.h"
 
 /**
@@ -50,11 +51,27 @@ extern "C" {
 
 typedef struct _AwnOverlayThrobberPrivate AwnOverlayThrobberPrivate;
 
+#define THROBBER_PHASES 8
+
+/* The phases rendered side by side for one size, shared by all throbbers
+ * of that size. */
+typedef struct {
+    gdouble          width;
+    gdouble          height;
+    gint             ref_count;
+    cairo_surface_t* surface;
+} AwnOverlayThrobberSprite;
+
+/* AwnOverlayThrobberSprite, there's rarely more than one size */
+static GSList* sprites = NULL;
+
 struct _AwnOverlayThrobberPrivate {
     gint        counter;
     guint       timer_id;
     guint       timeout;
     gdouble     scale;
+
+    AwnOverlayThrobberSprite* sprite;
 };
 
 enum {
@@ -70,6 +87,18 @@ _awn_overlay_throbber_render(AwnOverlay* overlay,
                              gint icon_width,
                              gint icon_height);
 
+static void
+_sprite_unref(AwnOverlayThrobberSprite* sprite)
+{
+    if (--sprite->ref_count > 0) {
+        return;
+    }
+
+    sprites = g_slist_remove(sprites, sprite);
+    cairo_surface_destroy(sprite->surface);
+    g_free(sprite);
+}
+
 static void
 awn_overlay_throbber_get_property(GObject* object, guint property_id,
                                   GValue* value, GParamSpec* pspec)
@@ -110,10 +139,15 @@ awn_overlay_throbber_dispose(GObject* object)
     AwnOverlayThrobberPrivate* priv = AWN_OVERLAY_THROBBER_GET_PRIVATE(object);
 
     if (priv->timer_id) {
-        g_source_remove(priv->timer_id);
+        awn_frame_clock_remove(awn_frame_clock_get_default(), priv->timer_id);
         priv->timer_id = 0;
     }
 
+    if (priv->sprite) {
+        _sprite_unref(priv->sprite);
+        priv->sprite = NULL;
+    }
+
     G_OBJECT_CLASS(awn_overlay_throbber_parent_class)->dispose(object);
 }
 
@@ -146,11 +180,15 @@ _awn_overlay_throbber_active_changed(GObject*    pspec,
                  NULL);
     if (active_val) {
         if (!priv->timer_id) {
-            priv->timer_id = g_timeout_add(priv->timeout, _awn_overlay_throbber_timeout, throbber);
+            priv->timer_id = awn_frame_clock_add(awn_frame_clock_get_default(),
+                                                 priv->timeout,
+                                                 _awn_overlay_throbber_timeout,
+                                                 throbber);
         }
     } else {
         if (priv->timer_id) {
-            g_source_remove(priv->timer_id);
+            awn_frame_clock_remove(awn_frame_clock_get_default(),
+                                   priv->timer_id);
             priv->timer_id = 0;
         }
     }
@@ -170,9 +208,13 @@ _awn_overlay_throbber_timeout_changed(GObject*    pspec,
                  NULL);
     if (active_val) {
         if (priv->timer_id) {
-            g_source_remove(priv->timer_id);
+            awn_frame_clock_remove(awn_frame_clock_get_default(),
+                                   priv->timer_id);
         }
-        priv->timer_id = g_timeout_add(priv->timeout, _awn_overlay_throbber_timeout, throbber);
+        priv->timer_id = awn_frame_clock_add(awn_frame_clock_get_default(),
+                                             priv->timeout,
+                                             _awn_overlay_throbber_timeout,
+                                             throbber);
     }
 }
 
@@ -263,44 +305,14 @@ awn_overlay_throbber_new(void)
                         NULL);
 }
 
+/* paints one phase to [0,0] - [1,1] */
 static void
-_awn_overlay_throbber_render(AwnOverlay* overlay,
-                             GtkWidget* widget,
-                             cairo_t* cr,
-                             gint icon_width,
-                             gint icon_height)
+_paint_phase(cairo_t* cr, gint counter)
 {
-    AwnOverlayThrobberPrivate* priv = AWN_OVERLAY_THROBBER_GET_PRIVATE(overlay);
-
     const gdouble RADIUS = 0.0625;
     const gdouble DIST = 0.3;
     const gdouble OTHER = DIST * 0.707106781; /* sqrt(2)/2 */
-    const gint COUNT = 8;
-    const gint counter = priv->counter;
-    gdouble scale;
-    AwnOverlayCoord coord;
-    gdouble scaled_height;
-    gdouble scaled_width;
-
-    g_object_get(overlay,
-                 "scale", &scale,
-                 NULL);
-
-    scaled_height = icon_height * scale;
-    scaled_width = icon_width * scale;
-    cairo_save(cr);
-    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
-    cairo_save(cr);
-    awn_overlay_move_to(overlay,
-                        cr,
-                        icon_width,
-                        icon_height,
-                        scaled_width,
-                        scaled_height,
-                        &coord);
-    cairo_restore(cr);
-    cairo_translate(cr, coord.x  , coord.y);
-    cairo_scale(cr, scaled_width, scaled_height);
+    const gint COUNT = THROBBER_PHASES;
 
     cairo_translate(cr, 0.50, 0.50);
     cairo_scale(cr, 1, -1);
@@ -336,6 +348,99 @@ _awn_overlay_throbber_render(AwnOverlay* overlay,
     cairo_set_source_rgba(cr, 1, 1, 1, ((counter + 7) % COUNT) / (float)COUNT);
     cairo_arc(cr, -OTHER, OTHER, RADIUS, 0, 2 * M_PI);
     cairo_fill(cr);
+}
+
+static AwnOverlayThrobberSprite*
+_sprite_get(gdouble width, gdouble height, cairo_t* target)
+{
+    AwnOverlayThrobberSprite* sprite;
+    gint cell_width = (gint)ceil(width);
+    cairo_t* cr;
+
+    for (GSList* iter = sprites; iter; iter = iter->next) {
+        sprite = (AwnOverlayThrobberSprite*)iter->data;
+        if (sprite->width == width && sprite->height == height) {
+            sprite->ref_count++;
+            return sprite;
+        }
+    }
+
+    sprite = g_new0(AwnOverlayThrobberSprite, 1);
+    sprite->width = width;
+    sprite->height = height;
+    sprite->ref_count = 1;
+    sprite->surface = cairo_surface_create_similar(cairo_get_target(target),
+                      CAIRO_CONTENT_COLOR_ALPHA,
+                      cell_width * THROBBER_PHASES,
+                      (gint)ceil(height));
+
+    cr = cairo_create(sprite->surface);
+    for (gint i = 0; i < THROBBER_PHASES; i++) {
+        cairo_save(cr);
+        cairo_translate(cr, i * cell_width, 0);
+        cairo_scale(cr, width, height);
+        _paint_phase(cr, i);
+        cairo_restore(cr);
+    }
+    cairo_destroy(cr);
+
+    sprites = g_slist_prepend(sprites, sprite);
+
+    return sprite;
+}
+
+static void
+_awn_overlay_throbber_render(AwnOverlay* overlay,
+                             GtkWidget* widget,
+                             cairo_t* cr,
+                             gint icon_width,
+                             gint icon_height)
+{
+    AwnOverlayThrobberPrivate* priv = AWN_OVERLAY_THROBBER_GET_PRIVATE(overlay);
+
+    gdouble scale;
+    AwnOverlayCoord coord;
+    gdouble scaled_height;
+    gdouble scaled_width;
+    gint cell_width;
+
+    g_object_get(overlay,
+                 "scale", &scale,
+                 NULL);
+
+    scaled_height = icon_height * scale;
+    scaled_width = icon_width * scale;
+    if (scaled_width <= 0.0 || scaled_height <= 0.0) {
+        return;
+    }
+
+    /* the phases are only rendered once per size */
+    if (!priv->sprite || priv->sprite->width != scaled_width ||
+            priv->sprite->height != scaled_height) {
+        if (priv->sprite) {
+            _sprite_unref(priv->sprite);
+        }
+        priv->sprite = _sprite_get(scaled_width, scaled_height, cr);
+    }
+    cell_width = (gint)ceil(scaled_width);
+
+    cairo_save(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    cairo_save(cr);
+    awn_overlay_move_to(overlay,
+                        cr,
+                        icon_width,
+                        icon_height,
+                        scaled_width,
+                        scaled_height,
+                        &coord);
+    cairo_restore(cr);
+    cairo_translate(cr, coord.x  , coord.y);
+
+    cairo_set_source_surface(cr, priv->sprite->surface,
+                             -(priv->counter % THROBBER_PHASES) * cell_width, 0);
+    cairo_rectangle(cr, 0, 0, cell_width, ceil(scaled_height));
+    cairo_fill(cr);
 
     cairo_restore(cr);
 }
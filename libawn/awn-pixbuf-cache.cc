@@ -22,20 +22,33 @@
 /* awn-pixbuf-cache.c */
 
 /*
-    Using a hash table.  Which optimizes to lookups.
-    The pruning is an expensive operation.  And will prune to PRUNE_PERCENT.
-    Set the max_cache_size prop with this in mind.
-
-    Cache pruning will not occur more frequently than every 10s (consider making
-                                                                 this a prop)
+    Keys are structs of interned scope, theme and icon name plus the size,
+    so lookups don't need to allocate or hash any strings.
+
+    Every cached pixbuf is a single entry, which is indexed by three hash
+    tables: by full size, by width only and by height only (the latter two
+    answer lookups with -1 as the other dimension). All entries are also
+    kept in a doubly linked list ordered by the time of last access, so both
+    lookups and updating the LRU order are O(1).
+
+    Size of an entry is accounted as width * height * 4 bytes, and whenever
+    an insert pushes the total over the memory-budget property, entries are
+    evicted from the tail of the list until it fits again.
+
+    The default cache is also backed by AwnSharedIconCache, so icons loaded
+    by one applet process are reused (and kept in memory only once) by the
+    other ones.
  */
 
-#define PRUNE_PERCENT 0.6
-#define MAX_PRUNE_FREQ 60
+#define DEFAULT_MEMORY_BUDGET (4 * 1024 * 1024)
+/* the deprecated max-cache-size property counted pixbufs, its default
+ * of 25 pixbufs maps onto the default budget */
+#define MAX_CACHE_SIZE_ENTRY_SIZE (DEFAULT_MEMORY_BUDGET / 25)
 
 #include "glib.h"
 
 #include "awn-pixbuf-cache.h"
+#include "awn-shared-icon-cache.h"
 
 extern "C" {
     G_DEFINE_TYPE(AwnPixbufCache, awn_pixbuf_cache, G_TYPE_OBJECT)
@@ -45,30 +58,78 @@ extern "C" {
   (G_TYPE_INSTANCE_GET_PRIVATE ((o), AWN_TYPE_PIXBUF_CACHE, AwnPixbufCachePrivate))
 
 typedef struct _AwnPixbufCachePrivate AwnPixbufCachePrivate;
+typedef struct _AwnPixbufCacheEntry AwnPixbufCacheEntry;
 
 enum {
     PROP_0,
 
+    PROP_MEMORY_BUDGET,
+    PROP_SHARED,
     PROP_MAX_CACHE_SIZE
 };
 
+typedef struct {
+    GQuark  scope;
+    GQuark  theme_name;
+    GQuark  icon_name;
+    gint    width;
+    gint    height;
+} AwnPixbufCacheKey;
+
+/* indexes the entry is registered in */
+enum {
+    INDEX_FULL      = 1 << 0,
+    INDEX_WIDTH     = 1 << 1,
+    INDEX_HEIGHT    = 1 << 2,
+    INDEX_SIMPLE    = 1 << 3
+};
+
+struct _AwnPixbufCacheEntry {
+    AwnPixbufCacheKey     key;
+    GdkPixbuf*            pixbuf; /* NULL for null results */
+    gsize                 size;
+    guint                 indexes;
+
+    AwnPixbufCacheEntry*  prev;
+    AwnPixbufCacheEntry*  next;
+};
+
 struct _AwnPixbufCachePrivate {
-    GHashTable*   pixbufs;
-    GList*                accessed;
-    /*maintain this ourselves... yes we could get this GHashTable or GList*/
-    guint               num_pixbufs;
-    guint               max_cache_size;
-    GTimeVal        last_prune;
+    /* AwnPixbufCacheKey -> AwnPixbufCacheEntry, the keys are owned
+     * by the entries */
+    GHashTable*   by_size;
+    GHashTable*   by_width;
+    GHashTable*   by_height;
+    /* GQuark -> AwnPixbufCacheEntry */
+    GHashTable*   by_simple_key;
+    /* most recently used entry is the head */
+    AwnPixbufCacheEntry* head;
+    AwnPixbufCacheEntry* tail;
+
+    gsize         total_size;
+    guint         memory_budget;
+
+    AwnSharedIconCache* shared;
 };
 
+static void awn_pixbuf_cache_evict(AwnPixbufCache* pixbuf_cache);
+static void awn_pixbuf_cache_clear(AwnPixbufCachePrivate* priv);
+
 static void
 awn_pixbuf_cache_get_property(GObject* object, guint property_id,
                               GValue* value, GParamSpec* pspec)
 {
     AwnPixbufCachePrivate* priv = GET_PRIVATE(object);
     switch (property_id) {
+    case PROP_MEMORY_BUDGET:
+        g_value_set_uint(value, priv->memory_budget);
+        break;
+    case PROP_SHARED:
+        g_value_set_boolean(value, priv->shared != NULL);
+        break;
     case PROP_MAX_CACHE_SIZE:
-        g_value_set_uint(value, priv->max_cache_size);
+        g_value_set_uint(value,
+                         priv->memory_budget / MAX_CACHE_SIZE_ENTRY_SIZE);
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -81,8 +142,19 @@ awn_pixbuf_cache_set_property(GObject* object, guint property_id,
 {
     AwnPixbufCachePrivate* priv = GET_PRIVATE(object);
     switch (property_id) {
+    case PROP_MEMORY_BUDGET:
+        priv->memory_budget = g_value_get_uint(value);
+        awn_pixbuf_cache_evict(AWN_PIXBUF_CACHE(object));
+        break;
+    case PROP_SHARED:
+        priv->shared = g_value_get_boolean(value) ?
+                       awn_shared_icon_cache_get_default() : NULL;
+        break;
     case PROP_MAX_CACHE_SIZE:
-        priv->max_cache_size = g_value_get_uint(value);
+        priv->memory_budget = g_value_get_uint(value) *
+                              MAX_CACHE_SIZE_ENTRY_SIZE;
+        awn_pixbuf_cache_evict(AWN_PIXBUF_CACHE(object));
+        g_object_notify(object, "memory-budget");
         break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, property_id, pspec);
@@ -92,22 +164,21 @@ awn_pixbuf_cache_set_property(GObject* object, guint property_id,
 static void
 awn_pixbuf_cache_dispose(GObject* object)
 {
-    AwnPixbufCachePrivate* priv = GET_PRIVATE(object);
-    if (priv->pixbufs) {
-        g_hash_table_destroy(priv->pixbufs);
-        priv->pixbufs = NULL;
-    }
-    if (priv->accessed) {
-        /* The list does not own any references to the data*/
-        g_list_free(priv->accessed);
-        priv->accessed = NULL;
-    }
+    awn_pixbuf_cache_clear(GET_PRIVATE(object));
+
     G_OBJECT_CLASS(awn_pixbuf_cache_parent_class)->dispose(object);
 }
 
 static void
 awn_pixbuf_cache_finalize(GObject* object)
 {
+    AwnPixbufCachePrivate* priv = GET_PRIVATE(object);
+
+    g_hash_table_destroy(priv->by_size);
+    g_hash_table_destroy(priv->by_width);
+    g_hash_table_destroy(priv->by_height);
+    g_hash_table_destroy(priv->by_simple_key);
+
     G_OBJECT_CLASS(awn_pixbuf_cache_parent_class)->finalize(object);
 }
 
@@ -131,35 +202,103 @@ awn_pixbuf_cache_class_init(AwnPixbufCacheClass* klass)
     object_class->finalize = awn_pixbuf_cache_finalize;
     object_class->constructed = awn_pixbuf_cache_constructed;
 
-    pspec = g_param_spec_uint("max_cache_size",
+    pspec = g_param_spec_uint("memory-budget",
+                              "Memory budget",
+                              "Maximum size of the cached pixbufs in bytes",
+                              0,
+                              G_MAXUINT,
+                              DEFAULT_MEMORY_BUDGET,
+                              G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
+    g_object_class_install_property(object_class, PROP_MEMORY_BUDGET, pspec);
+
+    pspec = g_param_spec_boolean("shared",
+                                 "Shared",
+                                 "Whether the icons are shared with other "
+                                 "processes of the user",
+                                 FALSE,
+                                 G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE);
+    g_object_class_install_property(object_class, PROP_SHARED, pspec);
+
+    /* deprecated, use memory-budget */
+    pspec = g_param_spec_uint("max-cache-size",
                               "max_cache_size",
-                              "Maximum number of pixbufs in the cache",
+                              "Maximum number of pixbufs in the cache "
+                              "(deprecated, sets memory-budget)",
                               0,
                               10000,
                               25,
-                              G_PARAM_CONSTRUCT | G_PARAM_READWRITE);
+                              G_PARAM_READWRITE);
     g_object_class_install_property(object_class, PROP_MAX_CACHE_SIZE, pspec);
 
     g_type_class_add_private(klass, sizeof(AwnPixbufCachePrivate));
 }
 
-static void
-awn_pixbuf_cache_item_unref(GObject* object)
+#define KEY_HASH_NAMES(k) \
+  (((k)->scope * 31 + (k)->theme_name) * 31 + (k)->icon_name)
+
+static guint
+awn_pixbuf_cache_key_hash(gconstpointer key)
 {
-    if (object) {
-        g_object_unref(object);
-    }
+    const AwnPixbufCacheKey* k = key;
+    return (KEY_HASH_NAMES(k) * 31 + k->width) * 31 + k->height;
+}
+
+static gboolean
+awn_pixbuf_cache_key_equal(gconstpointer a, gconstpointer b)
+{
+    const AwnPixbufCacheKey* k1 = a;
+    const AwnPixbufCacheKey* k2 = b;
+    return k1->icon_name == k2->icon_name && k1->width == k2->width &&
+           k1->height == k2->height && k1->scope == k2->scope &&
+           k1->theme_name == k2->theme_name;
+}
+
+static guint
+awn_pixbuf_cache_key_hash_width(gconstpointer key)
+{
+    const AwnPixbufCacheKey* k = key;
+    return KEY_HASH_NAMES(k) * 31 + k->width;
+}
+
+static gboolean
+awn_pixbuf_cache_key_equal_width(gconstpointer a, gconstpointer b)
+{
+    const AwnPixbufCacheKey* k1 = a;
+    const AwnPixbufCacheKey* k2 = b;
+    return k1->icon_name == k2->icon_name && k1->width == k2->width &&
+           k1->scope == k2->scope && k1->theme_name == k2->theme_name;
+}
+
+static guint
+awn_pixbuf_cache_key_hash_height(gconstpointer key)
+{
+    const AwnPixbufCacheKey* k = key;
+    return KEY_HASH_NAMES(k) * 31 + k->height;
+}
+
+static gboolean
+awn_pixbuf_cache_key_equal_height(gconstpointer a, gconstpointer b)
+{
+    const AwnPixbufCacheKey* k1 = a;
+    const AwnPixbufCacheKey* k2 = b;
+    return k1->icon_name == k2->icon_name && k1->height == k2->height &&
+           k1->scope == k2->scope && k1->theme_name == k2->theme_name;
 }
 
 static void
 awn_pixbuf_cache_init(AwnPixbufCache* self)
 {
     AwnPixbufCachePrivate* priv = GET_PRIVATE(self);
-    priv->pixbufs = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                          g_free, (GDestroyNotify)awn_pixbuf_cache_item_unref);
-    priv->accessed = NULL;
-    priv->num_pixbufs = 0;
-    g_get_current_time(&priv->last_prune);
+    priv->by_size = g_hash_table_new(awn_pixbuf_cache_key_hash,
+                                     awn_pixbuf_cache_key_equal);
+    priv->by_width = g_hash_table_new(awn_pixbuf_cache_key_hash_width,
+                                      awn_pixbuf_cache_key_equal_width);
+    priv->by_height = g_hash_table_new(awn_pixbuf_cache_key_hash_height,
+                                       awn_pixbuf_cache_key_equal_height);
+    priv->by_simple_key = g_hash_table_new(g_direct_hash, g_direct_equal);
+    priv->head = NULL;
+    priv->tail = NULL;
+    priv->total_size = 0;
 }
 
 /**
@@ -185,67 +324,231 @@ awn_pixbuf_cache_get_default(void)
 {
     static AwnPixbufCache* def_cache = NULL;
     if (!def_cache) {
-        def_cache = awn_pixbuf_cache_new();
+        def_cache = g_object_new(AWN_TYPE_PIXBUF_CACHE,
+                                 "shared", TRUE,
+                                 NULL);
     }
     return def_cache;
 }
 
-/*
- Relatively lazy about pruning the cache.  It will get done though.
- */
 static void
-awn_pixbuf_cache_prune(AwnPixbufCache* pixbuf_cache)
+awn_pixbuf_cache_unlink_entry(AwnPixbufCachePrivate* priv,
+                              AwnPixbufCacheEntry* entry)
 {
-    /*
-    Maybe it's best to use something other than a hash table.
-     But lookup speed is important*/
-    AwnPixbufCachePrivate* priv = GET_PRIVATE(pixbuf_cache);
-    GTimeVal current_time;
-
-    g_get_current_time(&current_time);
-
-    if (priv->num_pixbufs > priv->max_cache_size) {
-        if (current_time.tv_sec - priv->last_prune.tv_sec > MAX_PRUNE_FREQ) {
-            gint target_size = priv->max_cache_size * PRUNE_PERCENT;
-            GList* keys = g_hash_table_get_keys(priv->pixbufs);
-            GList* iter_keys;
-            for (iter_keys = keys; iter_keys; iter_keys = g_list_next(iter_keys)) {
-                GdkPixbuf* value = g_hash_table_lookup(priv->pixbufs, iter_keys->data);
-                if (g_list_position(priv->accessed, g_list_find(priv->accessed, value)) >= target_size) {
-                    g_message("%s: removing pixbuf %p", __func__, value);
-                    g_hash_table_remove(priv->pixbufs, iter_keys->data);
-                }
-            }
-            /*nasty*/
-            while ((gint)g_list_length(priv->accessed) >= target_size) {
-                priv->accessed = g_list_delete_link(priv->accessed, g_list_last(priv->accessed));
-                priv->num_pixbufs--;
-            }
-            priv->last_prune = current_time;
-            g_list_free(keys);
-        } else {
-            g_warning("%s: Frequent pruning is occurring last prune was %lds ago.  This should, generally, not occur (panel resizes being an acception). Consider increasing the max-cache-size property of the applet's AwnPixbufCache object", __func__, current_time.tv_sec - priv->last_prune.tv_sec);
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        priv->head = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        priv->tail = entry->prev;
+    }
+    entry->prev = NULL;
+    entry->next = NULL;
+}
+
+/* marks the entry as most recently used */
+static void
+awn_pixbuf_cache_touch_entry(AwnPixbufCachePrivate* priv,
+                             AwnPixbufCacheEntry* entry)
+{
+    if (priv->head == entry) {
+        return;
+    }
+    if (entry->prev || entry->next || priv->tail == entry) {
+        awn_pixbuf_cache_unlink_entry(priv, entry);
+    }
+
+    entry->next = priv->head;
+    if (priv->head) {
+        priv->head->prev = entry;
+    }
+    priv->head = entry;
+    if (!priv->tail) {
+        priv->tail = entry;
+    }
+}
+
+static AwnPixbufCacheEntry*
+awn_pixbuf_cache_new_entry(AwnPixbufCachePrivate* priv, GdkPixbuf* pbuf)
+{
+    AwnPixbufCacheEntry* entry = g_slice_new0(AwnPixbufCacheEntry);
+
+    if (pbuf) {
+        entry->pixbuf = g_object_ref(pbuf);
+        entry->size = gdk_pixbuf_get_width(pbuf) *
+                      gdk_pixbuf_get_height(pbuf) * 4;
+        priv->total_size += entry->size;
+    }
+
+    awn_pixbuf_cache_touch_entry(priv, entry);
+
+    return entry;
+}
+
+static void
+awn_pixbuf_cache_free_entry(AwnPixbufCachePrivate* priv,
+                            AwnPixbufCacheEntry* entry)
+{
+    awn_pixbuf_cache_unlink_entry(priv, entry);
+
+    if (entry->pixbuf) {
+        g_object_unref(entry->pixbuf);
+    }
+    priv->total_size -= entry->size;
+
+    g_slice_free(AwnPixbufCacheEntry, entry);
+}
+
+static GHashTable*
+awn_pixbuf_cache_get_index(AwnPixbufCachePrivate* priv, guint which)
+{
+    switch (which) {
+    case INDEX_FULL:
+        return priv->by_size;
+    case INDEX_WIDTH:
+        return priv->by_width;
+    case INDEX_HEIGHT:
+        return priv->by_height;
+    default:
+        return priv->by_simple_key;
+    }
+}
+
+static gpointer
+awn_pixbuf_cache_index_key(AwnPixbufCacheEntry* entry, guint which)
+{
+    if (which == INDEX_SIMPLE) {
+        return GUINT_TO_POINTER(entry->key.icon_name);
+    }
+    return &entry->key;
+}
+
+static void
+awn_pixbuf_cache_remove_entry(AwnPixbufCachePrivate* priv,
+                              AwnPixbufCacheEntry* entry)
+{
+    for (guint which = INDEX_FULL; which <= INDEX_SIMPLE; which <<= 1) {
+        if (entry->indexes & which) {
+            g_hash_table_remove(awn_pixbuf_cache_get_index(priv, which),
+                                awn_pixbuf_cache_index_key(entry, which));
+        }
+    }
+
+    awn_pixbuf_cache_free_entry(priv, entry);
+}
+
+/* registers the entry in an index, replacing whatever was there before */
+static void
+awn_pixbuf_cache_add_to_index(AwnPixbufCachePrivate* priv,
+                              AwnPixbufCacheEntry* entry, guint which)
+{
+    GHashTable* table = awn_pixbuf_cache_get_index(priv, which);
+    gpointer key = awn_pixbuf_cache_index_key(entry, which);
+    AwnPixbufCacheEntry* old_entry = g_hash_table_lookup(table, key);
+
+    if (old_entry) {
+        /* the table key points into the old entry, so remove it first */
+        g_hash_table_remove(table, key);
+        old_entry->indexes &= ~which;
+        if (old_entry->indexes == 0) {
+            awn_pixbuf_cache_free_entry(priv, old_entry);
         }
     }
+
+    g_hash_table_insert(table, key, entry);
+    entry->indexes |= which;
+}
+
+/* picks the index which answers lookups of the given size */
+static guint
+awn_pixbuf_cache_index_for_size(gint width, gint height)
+{
+    if (height == -1) {
+        return INDEX_WIDTH;
+    }
+    if (width == -1) {
+        return INDEX_HEIGHT;
+    }
+    return INDEX_FULL;
+}
+
+/* strings which were never interned can't be part of any cached key */
+static gboolean
+awn_pixbuf_cache_try_quark(const gchar* str, GQuark* quark)
+{
+    *quark = g_quark_try_string(str);
+
+    return str == NULL || *quark != 0;
+}
+
+static void
+awn_pixbuf_cache_clear(AwnPixbufCachePrivate* priv)
+{
+    while (priv->head) {
+        awn_pixbuf_cache_remove_entry(priv, priv->head);
+    }
+    g_assert(g_hash_table_size(priv->by_size) == 0);
+    g_assert(priv->total_size == 0);
 }
 
+/*
+ Drops least recently used entries until the cache fits into its budget,
+ the most recently used entry is always kept.
+ */
 static void
-awn_pixbuf_cache_check(AwnPixbufCache* pixbuf_cache, GdkPixbuf* pbuf)
+awn_pixbuf_cache_evict(AwnPixbufCache* pixbuf_cache)
 {
     AwnPixbufCachePrivate* priv = GET_PRIVATE(pixbuf_cache);
-    GList* needle;
 
-    needle = g_list_find(priv->accessed, pbuf);
-    if (needle) {
-        priv->accessed = g_list_delete_link(priv->accessed, needle);
-    } else {
-        priv->num_pixbufs++;
+    while (priv->total_size > priv->memory_budget &&
+            priv->tail && priv->tail != priv->head) {
+        awn_pixbuf_cache_remove_entry(priv, priv->tail);
     }
-    priv->accessed = g_list_prepend(priv->accessed, pbuf);
-    if (priv->num_pixbufs > priv->max_cache_size) {
-        awn_pixbuf_cache_prune(pixbuf_cache);
+}
+
+static GdkPixbuf*
+awn_pixbuf_cache_lookup_entry(AwnPixbufCachePrivate* priv, guint which,
+                              gconstpointer key, gboolean* found)
+{
+    AwnPixbufCacheEntry* entry =
+        g_hash_table_lookup(awn_pixbuf_cache_get_index(priv, which), key);
+
+    if (found) {
+        *found = entry != NULL;
     }
-    g_assert(priv->num_pixbufs == g_list_length(priv->accessed));
+    if (!entry) {
+        return NULL;
+    }
+
+    awn_pixbuf_cache_touch_entry(priv, entry);
+
+    return entry->pixbuf ? g_object_ref(entry->pixbuf) : NULL;
+}
+
+static void
+awn_pixbuf_cache_insert_local(AwnPixbufCache* pixbuf_cache,
+                              GdkPixbuf* pbuf,
+                              const gchar* scope,
+                              const gchar* theme_name,
+                              const gchar* icon_name)
+{
+    AwnPixbufCachePrivate* priv = GET_PRIVATE(pixbuf_cache);
+    AwnPixbufCacheEntry* entry = awn_pixbuf_cache_new_entry(priv, pbuf);
+
+    entry->key.scope = g_quark_from_string(scope);
+    entry->key.theme_name = g_quark_from_string(theme_name);
+    entry->key.icon_name = g_quark_from_string(icon_name);
+    entry->key.width = gdk_pixbuf_get_width(pbuf);
+    entry->key.height = gdk_pixbuf_get_height(pbuf);
+
+    awn_pixbuf_cache_add_to_index(priv, entry, INDEX_FULL);
+    awn_pixbuf_cache_add_to_index(priv, entry, INDEX_WIDTH);
+    awn_pixbuf_cache_add_to_index(priv, entry, INDEX_HEIGHT);
+
+    awn_pixbuf_cache_evict(pixbuf_cache);
 }
 
 /**
@@ -266,37 +569,15 @@ awn_pixbuf_cache_insert_pixbuf(AwnPixbufCache* pixbuf_cache,
                                const gchar* theme_name,
                                const gchar* icon_name)
 {
-    gchar* key;
     AwnPixbufCachePrivate* priv = GET_PRIVATE(pixbuf_cache);
 
-    key = g_strdup_printf("%s::%s::%s::%dx%d",
-                          scope ? scope : "__NONE__",
-                          theme_name ? theme_name : "__NONE__",
-                          icon_name,
-                          -1,
-                          gdk_pixbuf_get_height(pbuf));
-    g_hash_table_insert(priv->pixbufs, key, pbuf);
-    g_object_ref(pbuf);
-
-    key = g_strdup_printf("%s::%s::%s::%dx%d",
-                          scope ? scope : "__NONE__",
-                          theme_name ? theme_name : "__NONE__",
-                          icon_name,
-                          gdk_pixbuf_get_width(pbuf),
-                          -1
-                         );
-    g_hash_table_insert(priv->pixbufs, key, pbuf);
-    g_object_ref(pbuf);
-
-    key = g_strdup_printf("%s::%s::%s::%dx%d",
-                          scope ? scope : "__NONE__",
-                          theme_name ? theme_name : "__NONE__",
-                          icon_name,
-                          gdk_pixbuf_get_width(pbuf),
-                          gdk_pixbuf_get_height(pbuf));
-    g_hash_table_insert(priv->pixbufs, key, pbuf);
-    g_object_ref(pbuf);
-    awn_pixbuf_cache_check(pixbuf_cache, pbuf);
+    awn_pixbuf_cache_insert_local(pixbuf_cache, pbuf,
+                                  scope, theme_name, icon_name);
+
+    if (priv->shared) {
+        awn_shared_icon_cache_insert(priv->shared, scope, theme_name,
+                                     icon_name, pbuf);
+    }
 }
 
 /**
@@ -316,9 +597,12 @@ awn_pixbuf_cache_insert_pixbuf_simple_key(AwnPixbufCache* pixbuf_cache,
         const gchar* simple_key)
 {
     AwnPixbufCachePrivate* priv = GET_PRIVATE(pixbuf_cache);
+    AwnPixbufCacheEntry* entry = awn_pixbuf_cache_new_entry(priv, pbuf);
 
-    g_hash_table_insert(priv->pixbufs, g_strdup(simple_key), pbuf);
-    g_object_ref(pbuf);
+    entry->key.icon_name = g_quark_from_string(simple_key);
+    awn_pixbuf_cache_add_to_index(priv, entry, INDEX_SIMPLE);
+
+    awn_pixbuf_cache_evict(pixbuf_cache);
 }
 
 /**
@@ -342,17 +626,19 @@ awn_pixbuf_cache_insert_null_result(AwnPixbufCache* pixbuf_cache,
                                     gint width,
                                     gint height)
 {
-    gchar* key;
     AwnPixbufCachePrivate* priv = GET_PRIVATE(pixbuf_cache);
-    key = g_strdup_printf("%s::%s::%s::%dx%d",
-                          scope ? scope : "__NONE__",
-                          theme_name ? theme_name : "__NONE__",
-                          icon_name,
-                          width,
-                          height);
-
-    g_hash_table_insert(priv->pixbufs, key, NULL);
-
+    /* null results don't take any space, so they are only dropped when
+     * they become the least recently used entry during an eviction */
+    AwnPixbufCacheEntry* entry = awn_pixbuf_cache_new_entry(priv, NULL);
+
+    entry->key.scope = g_quark_from_string(scope);
+    entry->key.theme_name = g_quark_from_string(theme_name);
+    entry->key.icon_name = g_quark_from_string(icon_name);
+    entry->key.width = width;
+    entry->key.height = height;
+
+    awn_pixbuf_cache_add_to_index(priv, entry,
+                                  awn_pixbuf_cache_index_for_size(width, height));
 }
 
 /**
@@ -373,14 +659,15 @@ awn_pixbuf_cache_lookup_simple_key(AwnPixbufCache* pixbuf_cache,
                                    gint width,
                                    gint height)
 {
-    gpointer pixbuf = NULL;
     AwnPixbufCachePrivate* priv = GET_PRIVATE(pixbuf_cache);
+    GQuark quark = g_quark_try_string(simple_key);
 
-    pixbuf = g_hash_table_lookup(priv->pixbufs, simple_key);
-    if (pixbuf) {
-        g_object_ref(pixbuf);
+    if (!quark) {
+        return NULL;
     }
-    return pixbuf;
+
+    return awn_pixbuf_cache_lookup_entry(priv, INDEX_SIMPLE,
+                                         GUINT_TO_POINTER(quark), NULL);
 }
 
 
@@ -408,28 +695,38 @@ awn_pixbuf_cache_lookup(AwnPixbufCache* pixbuf_cache,
                         gint height,
                         gboolean* null_result)
 {
-    gpointer pixbuf = NULL;
-    gchar* key = g_strdup_printf("%s::%s::%s::%dx%d",
-                                 scope ? scope : "__NONE__",
-                                 theme_name ? theme_name : "__NONE__",
-                                 icon_name,
-                                 width,
-                                 height);
+    GdkPixbuf* pixbuf = NULL;
     AwnPixbufCachePrivate* priv = GET_PRIVATE(pixbuf_cache);
-    gboolean success;
+    AwnPixbufCacheKey key;
+    gboolean success = FALSE;
+
+    key.width = width;
+    key.height = height;
+
+    if (awn_pixbuf_cache_try_quark(scope, &key.scope) &&
+            awn_pixbuf_cache_try_quark(theme_name, &key.theme_name) &&
+            awn_pixbuf_cache_try_quark(icon_name, &key.icon_name)) {
+        pixbuf = awn_pixbuf_cache_lookup_entry(priv,
+                                               awn_pixbuf_cache_index_for_size(width, height),
+                                               &key, &success);
+    }
 
-    success = g_hash_table_lookup_extended(priv->pixbufs, key, NULL, &pixbuf);
-    if (pixbuf) {
-        g_object_ref(pixbuf);
+    if (!success && priv->shared) {
+        /* maybe another process has loaded it already */
+        pixbuf = awn_shared_icon_cache_lookup(priv->shared, scope, theme_name,
+                                              icon_name, width, height);
+        if (pixbuf) {
+            awn_pixbuf_cache_insert_local(pixbuf_cache, pixbuf,
+                                          scope, theme_name, icon_name);
+        }
     }
+
     if (null_result && !pixbuf) {
         *null_result = success;
     } else if (null_result) {
         *null_result = FALSE;
     }
 
-//  g_debug ("Cache lookup: %s for %s",pixbuf?"Hit":"Miss",key);
-    g_free(key);
     return pixbuf;
 }
 
@@ -446,10 +743,10 @@ awn_pixbuf_cache_invalidate(AwnPixbufCache* pixbuf_cache)
 {
     AwnPixbufCachePrivate* priv = GET_PRIVATE(pixbuf_cache);
 
-    g_hash_table_remove_all(priv->pixbufs);
-    g_list_free(priv->accessed);
-    priv->accessed = NULL;
-    priv->num_pixbufs = 0;
-    g_get_current_time(&priv->last_prune);
+    awn_pixbuf_cache_clear(priv);
+
+    if (priv->shared) {
+        awn_shared_icon_cache_invalidate(priv->shared);
+    }
 }
 
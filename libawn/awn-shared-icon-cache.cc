@@ -0,0 +1,560 @@
+/*
+ * Copyright (C) 2009 Michal Hruby <michal.mhr@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* awn-shared-icon-cache.c */
+
+/*
+    Every applet runs in its own process, so without this every one of them
+    would load and keep its own copy of the same icons.
+
+    The cache is a sparse file in the temp directory which all processes
+    of the user map read-only. It's append-only: a record (key + pixel data)
+    is pwrite()n at the end of the used area while holding an flock() on
+    the file, and only then it's published by storing its offset to the head
+    of its hash bucket. Readers therefore don't need any locking.
+
+    Nothing is ever stored through the mapping, so a full tmpfs makes
+    pwrite() fail with ENOSPC instead of raising SIGBUS. Lookups return
+    pixbufs wrapping the mapped pixels directly (each of them keeps the
+    mapping alive), that's where the memory is saved - they are read-only
+    just like the pixbufs shared through AwnPixbufCache in one process.
+
+    When the cache is invalidated (icon theme change), the file is marked
+    as retired and unlinked, processes notice that on their next access and
+    map a new one. If the file fills up, new icons simply aren't shared.
+ */
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+#include "awn-shared-icon-cache.h"
+
+#define CACHE_MAGIC "AWNICON1"
+#define CACHE_VERSION 1
+/* the file is sparse, only the used part takes memory */
+#define CACHE_SIZE (32 * 1024 * 1024)
+#define CACHE_BUCKETS 1021
+
+#define ALIGN8(x) (((x) + 7) & ~7)
+
+typedef struct {
+    gchar         magic[8];
+    guint32       version;
+    guint32       size;
+    volatile gint retired;
+    volatile gint used;
+    /* offsets of the first record in the chain, 0 if empty */
+    volatile gint buckets[CACHE_BUCKETS];
+} CacheHeader;
+
+typedef struct {
+    guint32 next;
+    guint32 hash;
+    gint32  width;
+    gint32  height;
+    gint32  rowstride;
+    guint32 has_alpha;
+    /* scope, theme and icon name, each of them NUL-terminated */
+    guint32 key_len;
+    guint32 data_offset;
+} CacheRecord;
+
+typedef struct {
+    volatile gint ref_count;
+    gint          fd;
+    guchar*       data;
+    gsize         size;
+} CacheMapping;
+
+struct _AwnSharedIconCache {
+    gchar*        path;
+    CacheMapping* mapping;
+    gboolean      disabled;
+};
+
+static void
+cache_mapping_unref(CacheMapping* mapping)
+{
+    if (g_atomic_int_dec_and_test(&mapping->ref_count)) {
+        munmap(mapping->data, mapping->size);
+        close(mapping->fd);
+        g_free(mapping);
+    }
+}
+
+static void
+cache_mapping_pixbuf_destroyed(guchar* pixels, gpointer data)
+{
+    cache_mapping_unref((CacheMapping*)data);
+}
+
+static gboolean
+cache_pwrite(gint fd, gconstpointer buf, gsize len, off_t offset)
+{
+    const guchar* p = (const guchar*)buf;
+
+    while (len > 0) {
+        ssize_t written = pwrite(fd, p, len, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return FALSE;
+        }
+        p += written;
+        len -= written;
+        offset += written;
+    }
+
+    return TRUE;
+}
+
+/* header fields are updated with pwrite() too, the mapping is read-only */
+static void
+cache_header_set(gint fd, glong field_offset, gint value)
+{
+    cache_pwrite(fd, &value, sizeof(value), field_offset);
+}
+
+static CacheMapping*
+cache_mapping_open(const gchar* path)
+{
+    struct stat st;
+    CacheMapping* mapping;
+    CacheHeader* header;
+    gint fd;
+
+    fd = open(path, O_RDWR | O_CREAT | O_NOFOLLOW, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    flock(fd, LOCK_EX);
+
+    if (fstat(fd, &st) != 0 || st.st_uid != getuid()) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+
+    if (st.st_size != 0 && st.st_size != CACHE_SIZE) {
+        /* left there by a different version, start over */
+        unlink(path);
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+
+    if (st.st_size == 0) {
+        /* the header is written out for real, the rest stays a hole
+         * (which reads back as zeroes) until records are appended */
+        CacheHeader* initial = g_new0(CacheHeader, 1);
+
+        memcpy(initial->magic, CACHE_MAGIC, sizeof(initial->magic));
+        initial->version = CACHE_VERSION;
+        initial->size = CACHE_SIZE;
+        initial->used = ALIGN8(sizeof(CacheHeader));
+
+        gboolean written = cache_pwrite(fd, initial, sizeof(CacheHeader), 0) &&
+                           ftruncate(fd, CACHE_SIZE) == 0;
+        g_free(initial);
+
+        if (!written) {
+            unlink(path);
+            flock(fd, LOCK_UN);
+            close(fd);
+            return NULL;
+        }
+    }
+
+    gpointer data = mmap(NULL, CACHE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        flock(fd, LOCK_UN);
+        close(fd);
+        return NULL;
+    }
+
+    header = data;
+    if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+               header->version != CACHE_VERSION ||
+               header->size != CACHE_SIZE) {
+        unlink(path);
+        flock(fd, LOCK_UN);
+        munmap(data, CACHE_SIZE);
+        close(fd);
+        return NULL;
+    }
+
+    flock(fd, LOCK_UN);
+
+    mapping = g_new0(CacheMapping, 1);
+    mapping->ref_count = 1;
+    mapping->fd = fd;
+    mapping->data = data;
+    mapping->size = CACHE_SIZE;
+
+    return mapping;
+}
+
+/* returns mapping of the current cache file, NULL if it can't be used */
+static CacheMapping*
+awn_shared_icon_cache_get_mapping(AwnSharedIconCache* cache)
+{
+    if (cache->mapping) {
+        CacheHeader* header = (CacheHeader*)cache->mapping->data;
+
+        if (!g_atomic_int_get(&header->retired)) {
+            return cache->mapping;
+        }
+
+        cache_mapping_unref(cache->mapping);
+        cache->mapping = NULL;
+    }
+
+    if (cache->disabled) {
+        return NULL;
+    }
+
+    /* the file might get retired (or replaced if it was invalid) between
+     * open() and flock() */
+    for (gint i = 0; i < 3 && !cache->mapping; i++) {
+        CacheMapping* mapping = cache_mapping_open(cache->path);
+        if (!mapping) {
+            continue;
+        }
+
+        if (g_atomic_int_get(&((CacheHeader*)mapping->data)->retired)) {
+            cache_mapping_unref(mapping);
+            continue;
+        }
+        cache->mapping = mapping;
+    }
+
+    if (!cache->mapping) {
+        g_warning("Unable to use shared icon cache \"%s\", icons won't be "
+                  "shared with other processes", cache->path);
+        cache->disabled = TRUE;
+    }
+
+    return cache->mapping;
+}
+
+/**
+ * awn_shared_icon_cache_get_default:
+ *
+ * Returns: the process-wide #AwnSharedIconCache.
+ */
+
+AwnSharedIconCache*
+awn_shared_icon_cache_get_default(void)
+{
+    static AwnSharedIconCache* def_cache = NULL;
+    if (!def_cache) {
+        gchar* filename = g_strdup_printf("awn-icon-cache-%u", getuid());
+
+        def_cache = g_new0(AwnSharedIconCache, 1);
+        def_cache->path = g_build_filename(g_get_tmp_dir(), filename, NULL);
+
+        g_free(filename);
+    }
+    return def_cache;
+}
+
+static guint32
+cache_key_hash(const gchar* scope, const gchar* theme_name,
+               const gchar* icon_name)
+{
+    const gchar* parts[3] = { scope, theme_name, icon_name };
+    guint32 hash = 5381;
+
+    for (gint i = 0; i < 3; i++) {
+        for (const gchar* p = parts[i]; p && *p; p++) {
+            hash = hash * 33 + *p;
+        }
+        hash = hash * 33;
+    }
+
+    return hash;
+}
+
+/* checks that the key stored in the record equals the given strings */
+static gboolean
+cache_record_key_equal(const CacheRecord* record,
+                       const gchar* scope, const gchar* theme_name,
+                       const gchar* icon_name)
+{
+    const gchar* parts[3] = { scope, theme_name, icon_name };
+    const gchar* key = (const gchar*)(record + 1);
+    const gchar* key_end = key + record->key_len;
+
+    for (gint i = 0; i < 3; i++) {
+        const gchar* part = parts[i] ? parts[i] : "";
+        gsize len = strlen(part) + 1;
+
+        if (key + len > key_end || memcmp(key, part, len) != 0) {
+            return FALSE;
+        }
+        key += len;
+    }
+
+    return key == key_end;
+}
+
+static CacheRecord*
+cache_find_record(CacheMapping* mapping, guint32 hash,
+                  const gchar* scope, const gchar* theme_name,
+                  const gchar* icon_name, gint width, gint height)
+{
+    CacheHeader* header = (CacheHeader*)mapping->data;
+    /* bucket heads are published after the used size is updated */
+    guint32 offset = g_atomic_int_get(&header->buckets[hash % CACHE_BUCKETS]);
+    /* published records are complete, but don't trust the file blindly,
+     * anyone can put a file there */
+    gsize used = MIN((gsize)(guint)g_atomic_int_get(&header->used),
+                     mapping->size);
+
+    while (offset) {
+        if (offset > used || used - offset < sizeof(CacheRecord)) {
+            return NULL;
+        }
+
+        CacheRecord* record = (CacheRecord*)(mapping->data + offset);
+        gint n_channels = record->has_alpha ? 4 : 3;
+
+        if (record->key_len > used - offset - sizeof(CacheRecord) ||
+                record->width <= 0 || record->height <= 0 ||
+                record->rowstride <= 0 ||
+                (guint64)record->rowstride <
+                (guint64)record->width * n_channels ||
+                record->data_offset > used ||
+                (guint64)record->rowstride * record->height >
+                used - record->data_offset) {
+            return NULL;
+        }
+
+        if (record->hash == hash &&
+                (width == -1 || record->width == width) &&
+                (height == -1 || record->height == height) &&
+                cache_record_key_equal(record, scope, theme_name, icon_name)) {
+            return record;
+        }
+
+        /* records only point to older ones */
+        if (record->next >= offset) {
+            return NULL;
+        }
+        offset = record->next;
+    }
+
+    return NULL;
+}
+
+/**
+ * awn_shared_icon_cache_lookup:
+ * @cache: A pointer to an #AwnSharedIconCache.
+ * @scope: Scope of the icon (can be NULL).
+ * @theme_name: Name of the icon theme (can be NULL).
+ * @icon_name: Name of the icon.
+ * @width: Width of the icon or -1 if it should be ignored.
+ * @height: Height of the icon or -1 if it should be ignored.
+ *
+ * Looks up an icon added by any process of the user.
+ *
+ * Returns: a new #GdkPixbuf sharing the pixels with other processes, or NULL.
+ * The pixels are mapped read-only and must not be modified.
+ */
+
+GdkPixbuf*
+awn_shared_icon_cache_lookup(AwnSharedIconCache* cache,
+                             const gchar* scope,
+                             const gchar* theme_name,
+                             const gchar* icon_name,
+                             gint width,
+                             gint height)
+{
+    g_return_val_if_fail(cache != NULL, NULL);
+    g_return_val_if_fail(icon_name != NULL, NULL);
+
+    CacheMapping* mapping = awn_shared_icon_cache_get_mapping(cache);
+    CacheRecord* record;
+
+    if (!mapping) {
+        return NULL;
+    }
+
+    record = cache_find_record(mapping,
+                               cache_key_hash(scope, theme_name, icon_name),
+                               scope, theme_name, icon_name, width, height);
+    if (!record) {
+        return NULL;
+    }
+
+    /* the pixbuf keeps the mapping alive even if the file is retired */
+    g_atomic_int_inc(&mapping->ref_count);
+
+    return gdk_pixbuf_new_from_data(mapping->data + record->data_offset,
+                                    GDK_COLORSPACE_RGB,
+                                    record->has_alpha != 0,
+                                    8,
+                                    record->width,
+                                    record->height,
+                                    record->rowstride,
+                                    cache_mapping_pixbuf_destroyed, mapping);
+}
+
+/**
+ * awn_shared_icon_cache_insert:
+ * @cache: A pointer to an #AwnSharedIconCache.
+ * @scope: Scope of the icon (can be NULL).
+ * @theme_name: Name of the icon theme (can be NULL).
+ * @icon_name: Name of the icon.
+ * @pbuf: The icon.
+ *
+ * Copies the icon to the shared cache, unless it's there already or
+ * the cache is full.
+ */
+
+void
+awn_shared_icon_cache_insert(AwnSharedIconCache* cache,
+                             const gchar* scope,
+                             const gchar* theme_name,
+                             const gchar* icon_name,
+                             GdkPixbuf* pbuf)
+{
+    g_return_if_fail(cache != NULL);
+    g_return_if_fail(icon_name != NULL);
+    g_return_if_fail(GDK_IS_PIXBUF(pbuf));
+
+    CacheMapping* mapping = awn_shared_icon_cache_get_mapping(cache);
+    CacheHeader* header;
+    guint32 hash = cache_key_hash(scope, theme_name, icon_name);
+    gint width = gdk_pixbuf_get_width(pbuf);
+    gint height = gdk_pixbuf_get_height(pbuf);
+    gint rowstride = gdk_pixbuf_get_rowstride(pbuf);
+
+    if (!mapping ||
+            gdk_pixbuf_get_colorspace(pbuf) != GDK_COLORSPACE_RGB ||
+            gdk_pixbuf_get_bits_per_sample(pbuf) != 8) {
+        return;
+    }
+
+    /* cheap check without the lock first */
+    if (cache_find_record(mapping, hash, scope, theme_name, icon_name,
+                          width, height)) {
+        return;
+    }
+
+    const gchar* parts[3] = { scope ? scope : "",
+                              theme_name ? theme_name : "",
+                              icon_name
+                            };
+    gsize key_len = 0;
+    for (gint i = 0; i < 3; i++) {
+        key_len += strlen(parts[i]) + 1;
+    }
+
+    gsize record_size = ALIGN8(sizeof(CacheRecord) + key_len);
+    gsize data_size = ALIGN8((gsize)rowstride * height);
+
+    header = (CacheHeader*)mapping->data;
+    flock(mapping->fd, LOCK_EX);
+
+    gsize used = (guint)header->used;
+    if (g_atomic_int_get(&header->retired) || used > mapping->size ||
+            record_size + data_size > mapping->size - used ||
+            cache_find_record(mapping, hash, scope, theme_name, icon_name,
+                              width, height)) {
+        flock(mapping->fd, LOCK_UN);
+        return;
+    }
+
+    guchar* buffer = g_malloc0(record_size + data_size);
+    CacheRecord* record = (CacheRecord*)buffer;
+    gchar* key = (gchar*)(record + 1);
+    guint bucket = hash % CACHE_BUCKETS;
+
+    record->next = header->buckets[bucket];
+    record->hash = hash;
+    record->width = width;
+    record->height = height;
+    record->rowstride = rowstride;
+    record->has_alpha = gdk_pixbuf_get_has_alpha(pbuf);
+    record->key_len = key_len;
+    record->data_offset = used + record_size;
+
+    for (gint i = 0; i < 3; i++) {
+        gsize len = strlen(parts[i]) + 1;
+        memcpy(key, parts[i], len);
+        key += len;
+    }
+
+    gsize row_len = width * gdk_pixbuf_get_n_channels(pbuf);
+    guchar* pixels = gdk_pixbuf_get_pixels(pbuf);
+    for (gint y = 0; y < height; y++) {
+        memcpy(buffer + record_size + y * rowstride,
+               pixels + y * rowstride, row_len);
+    }
+
+    /* publish the record once it's complete, if the disk is full it
+     * simply doesn't get published */
+    if (cache_pwrite(mapping->fd, buffer, record_size + data_size, used)) {
+        cache_header_set(mapping->fd, G_STRUCT_OFFSET(CacheHeader, used),
+                         used + record_size + data_size);
+        cache_header_set(mapping->fd, G_STRUCT_OFFSET(CacheHeader, buckets) +
+                         bucket * sizeof(gint), used);
+    }
+
+    flock(mapping->fd, LOCK_UN);
+    g_free(buffer);
+}
+
+/**
+ * awn_shared_icon_cache_invalidate:
+ * @cache: A pointer to an #AwnSharedIconCache.
+ *
+ * Drops all icons from the shared cache, for all processes.
+ */
+
+void
+awn_shared_icon_cache_invalidate(AwnSharedIconCache* cache)
+{
+    g_return_if_fail(cache != NULL);
+
+    CacheMapping* mapping = cache->mapping;
+
+    if (!mapping) {
+        return;
+    }
+
+    CacheHeader* header = (CacheHeader*)mapping->data;
+
+    flock(mapping->fd, LOCK_EX);
+    if (!g_atomic_int_get(&header->retired)) {
+        cache_header_set(mapping->fd, G_STRUCT_OFFSET(CacheHeader, retired), 1);
+        unlink(cache->path);
+    }
+    flock(mapping->fd, LOCK_UN);
+
+    cache_mapping_unref(mapping);
+    cache->mapping = NULL;
+}
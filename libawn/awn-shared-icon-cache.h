@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2009 Michal Hruby <michal.mhr@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* awn-shared-icon-cache.h */
+
+#ifndef _AWN_SHARED_ICON_CACHE
+#define _AWN_SHARED_ICON_CACHE
+
+#include <glib.h>
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+/* Icon cache mapped by all processes of the user, used by AwnPixbufCache */
+
+typedef struct _AwnSharedIconCache AwnSharedIconCache;
+
+AwnSharedIconCache* awn_shared_icon_cache_get_default(void);
+
+GdkPixbuf* awn_shared_icon_cache_lookup(AwnSharedIconCache* cache,
+                                        const gchar* scope,
+                                        const gchar* theme_name,
+                                        const gchar* icon_name,
+                                        gint width,
+                                        gint height);
+
+void awn_shared_icon_cache_insert(AwnSharedIconCache* cache,
+                                  const gchar* scope,
+                                  const gchar* theme_name,
+                                  const gchar* icon_name,
+                                  GdkPixbuf* pbuf);
+
+void awn_shared_icon_cache_invalidate(AwnSharedIconCache* cache);
+
+#endif /* _AWN_SHARED_ICON_CACHE */
@@ -38,6 +38,7 @@
 #include <libdesktop-agnostic/vfs.h>
 
 #include "awn-themed-icon.h"
+#include "awn-icon-disk-cache.h"
 #include "libawn.h"
 
 #include "gseal-transition.h"
@@ -77,6 +78,7 @@ extern "C" {
   AwnThemedIconPrivate))
 
 #define LOAD_FLAGS GTK_ICON_LOOKUP_FORCE_SIZE | GTK_ICON_LOOKUP_GENERIC_FALLBACK
+#define LOAD_THREADS 2
 #define AWN_ICON_THEME_NAME "awn-theme"
 #define AWN_CHANGE_ICON_UI PKGDATADIR"/awn-themed-icon.ui"
 
@@ -154,6 +156,13 @@ struct _AwnThemedIconPrivate {
     GtkWidget* remove_custom_icon_item;
 
     GList* preload_list;
+
+    /* set while ensure_icon() looks for the icon, icons which aren't cached
+     * are then decoded by the load threads and load_pending is set */
+    gboolean async_load;
+    gboolean load_pending;
+    /* whether a real icon (not a placeholder) was set already */
+    gboolean has_pixbuf;
 };
 
 typedef struct {
@@ -163,6 +172,30 @@ typedef struct {
     guint         id;
 } AwnThemedIconPreloadItem;
 
+typedef struct {
+    gchar*          key;
+    GtkIconTheme*   theme;
+    gchar*          theme_name;
+    gchar*          scope;
+    gchar*          icon_name;
+    /* NULL if the icon is read from the disk cache */
+    gchar*          filename;
+    guint64         stamp;
+    gint            size;
+    guint           generation;
+    GdkPixbuf*      pixbuf;
+    /* the disk cache had the icon as missing, or didn't have it at all */
+    gboolean        null_result;
+    gboolean        disk_miss;
+    GSList*         waiters;
+} AwnThemedIconLoadJob;
+
+/* icons being decoded by the load threads, shared by all AwnThemedIcons */
+static GThreadPool* load_pool = NULL;
+static GHashTable*  load_jobs = NULL;
+/* increased on theme changes, results of older jobs are thrown away */
+static guint        load_generation = 0;
+
 enum {
     SCOPE_UID = 0,
     SCOPE_APPLET,
@@ -203,6 +236,10 @@ static GtkIconTheme* get_awn_theme(void);
 
 static GdkPixbuf* try_and_load_image_from_disk(const gchar* filename, gint size);
 
+static GdkPixbuf* scale_to_size(GdkPixbuf* pixbuf, gint size);
+
+static gboolean awn_themed_icon_load_done(gpointer data);
+
 void    awn_themed_icon_drag_data_received_internal(GtkWidget*        widget,
         GdkDragContext*   context,
         gint              x,
@@ -218,12 +255,23 @@ enum {
     PROP_DRAG_AND_DROP
 };
 
+/*
+ Called when contents of the icon themes might have changed.
+ */
+static void
+awn_themed_icon_invalidate_theme_caches(void)
+{
+    awn_icon_disk_cache_invalidate(awn_icon_disk_cache_get_default());
+    load_generation++;
+}
+
 static void
 awn_theme_dir_changed(DesktopAgnosticVFSFileMonitor* self,
                       DesktopAgnosticVFSFile* other,
                       DesktopAgnosticVFSFileMonitorEvent event)
 {
     awn_pixbuf_cache_invalidate(awn_pixbuf_cache_get_default());
+    awn_themed_icon_invalidate_theme_caches();
     gtk_icon_theme_set_custom_theme(get_awn_theme(), NULL);
     gtk_icon_theme_set_custom_theme(get_awn_theme(), AWN_ICON_THEME_NAME);
 }
@@ -276,6 +324,215 @@ get_awn_theme(void)
  scope probably isn't necessary... if the theme_name is always provided.
  */
 
+/*
+ Runs in one of the load threads, only touches the job itself and
+ the (thread-safe) disk cache.
+ */
+static void
+awn_themed_icon_load_thread(gpointer data, gpointer user_data)
+{
+    AwnThemedIconLoadJob* job = data;
+
+    if (!job->filename) {
+        job->pixbuf = awn_icon_disk_cache_read(awn_icon_disk_cache_get_default(),
+                                               job->stamp, job->theme_name,
+                                               job->scope, job->icon_name,
+                                               job->size, &job->null_result);
+        job->disk_miss = !job->pixbuf && !job->null_result;
+        g_idle_add(awn_themed_icon_load_done, job);
+        return;
+    }
+
+    job->pixbuf = gdk_pixbuf_new_from_file_at_size(job->filename,
+                  job->size, job->size,
+                  NULL);
+    if (job->pixbuf) {
+        job->pixbuf = scale_to_size(job->pixbuf, job->size);
+        awn_icon_disk_cache_write(awn_icon_disk_cache_get_default(),
+                                  job->stamp, job->theme_name,
+                                  job->scope, job->icon_name,
+                                  job->size, job->pixbuf);
+    }
+    g_idle_add(awn_themed_icon_load_done, job);
+}
+
+static GThreadPool*
+awn_themed_icon_get_load_pool(void)
+{
+    if (!load_pool && g_thread_supported()) {
+        load_pool = g_thread_pool_new(awn_themed_icon_load_thread, NULL,
+                                      LOAD_THREADS, FALSE, NULL);
+        load_jobs = g_hash_table_new(g_str_hash, g_str_equal);
+    }
+    return load_pool;
+}
+
+/*
+ Queues decoding of the icon file (or reading of the cached icon if filename
+ is NULL), requests for the same icon share one job.
+ */
+static void
+awn_themed_icon_queue_load(AwnThemedIcon* icon, GtkIconTheme* theme,
+                           const gchar* scope, const gchar* icon_name,
+                           const gchar* filename, gint size)
+{
+    AwnThemedIconLoadJob* job;
+    gchar* key;
+
+    key = g_strdup_printf("%s\n%s\n%s\n%d", theme->priv->current_theme,
+                          scope ? scope : "", icon_name, size);
+    job = g_hash_table_lookup(load_jobs, key);
+
+    if (job) {
+        g_free(key);
+    } else {
+        job = g_new0(AwnThemedIconLoadJob, 1);
+        job->key = key;
+        job->theme = g_object_ref(theme);
+        job->theme_name = g_strdup(theme->priv->current_theme);
+        job->scope = g_strdup(scope);
+        job->icon_name = g_strdup(icon_name);
+        job->filename = g_strdup(filename);
+        job->stamp = awn_icon_disk_cache_get_stamp(
+                         awn_icon_disk_cache_get_default(),
+                         theme, job->theme_name);
+        job->size = size;
+        job->generation = load_generation;
+
+        g_hash_table_insert(load_jobs, job->key, job);
+        g_thread_pool_push(load_pool, job, NULL);
+    }
+
+    if (icon && !g_slist_find(job->waiters, icon)) {
+        job->waiters = g_slist_prepend(job->waiters, icon);
+    }
+}
+
+/*
+ Back in the main thread, caches the decoded icon and updates the icons
+ waiting for it.
+ */
+static gboolean
+awn_themed_icon_load_done(gpointer data)
+{
+    AwnThemedIconLoadJob* job = data;
+    GSList* iter;
+
+    g_hash_table_remove(load_jobs, job->key);
+
+    /* on a disk cache miss the waiters resolve the icon through the theme */
+    if (job->generation == load_generation && !job->disk_miss) {
+        if (job->pixbuf) {
+            awn_pixbuf_cache_insert_pixbuf(awn_pixbuf_cache_get_default(),
+                                           job->pixbuf,
+                                           job->scope,
+                                           job->theme_name,
+                                           job->icon_name);
+        } else {
+            awn_pixbuf_cache_insert_null_result(awn_pixbuf_cache_get_default(),
+                                                job->scope,
+                                                job->theme_name,
+                                                job->icon_name,
+                                                -1,
+                                                job->size);
+        }
+    }
+
+    /* if the theme changed meanwhile this just queues a new job */
+    for (iter = job->waiters; iter; iter = iter->next) {
+        ensure_icon(iter->data);
+    }
+
+    if (job->pixbuf) {
+        g_object_unref(job->pixbuf);
+    }
+    g_object_unref(job->theme);
+    g_slist_free(job->waiters);
+    g_free(job->filename);
+    g_free(job->icon_name);
+    g_free(job->scope);
+    g_free(job->theme_name);
+    g_free(job->key);
+    g_free(job);
+
+    return FALSE;
+}
+
+static void
+awn_themed_icon_remove_waiter(gpointer key, gpointer value, gpointer icon)
+{
+    AwnThemedIconLoadJob* job = value;
+
+    job->waiters = g_slist_remove(job->waiters, icon);
+}
+
+/*
+ Loads an icon from a theme, the result (already scaled to size) is kept in
+ the persistent AwnIconDiskCache, so the lookup isn't repeated on next start.
+ If priv->async_load is set, reading of the cached icon or decoding of the file
+ is left to the load threads and NULL is returned with priv->load_pending set.
+ */
+static GdkPixbuf*
+awn_themed_icon_load_theme_pixbuf(AwnThemedIcon* icon, GtkIconTheme* theme,
+                                  const gchar* scope,
+                                  const gchar* icon_name, gint size)
+{
+    AwnThemedIconPrivate* priv = icon->priv;
+    AwnIconDiskCache* disk_cache = awn_icon_disk_cache_get_default();
+    const gchar* theme_name = theme->priv->current_theme;
+    GdkPixbuf* pixbuf;
+    gboolean null_result;
+
+    if (priv->async_load && awn_themed_icon_get_load_pool()) {
+        const gchar* names[2] = {NULL, NULL};
+        GtkIconInfo* info;
+        const gchar* filename = NULL;
+
+        if (awn_icon_disk_cache_has_entry(disk_cache, theme_name, scope,
+                                          icon_name, size)) {
+            awn_themed_icon_queue_load(icon, theme, scope, icon_name,
+                                       NULL, size);
+            priv->load_pending = TRUE;
+            return NULL;
+        }
+
+        names[0] = icon_name;
+        info = gtk_icon_theme_choose_icon(theme, names, size, LOAD_FLAGS);
+        if (info) {
+            filename = gtk_icon_info_get_filename(info);
+        }
+        if (filename) {
+            awn_themed_icon_queue_load(icon, theme, scope, icon_name,
+                                       filename, size);
+            gtk_icon_info_free(info);
+            priv->load_pending = TRUE;
+            return NULL;
+        }
+
+        /* builtin icons don't need decoding */
+        pixbuf = NULL;
+        if (info) {
+            pixbuf = gtk_icon_info_load_icon(info, NULL);
+            gtk_icon_info_free(info);
+        }
+    } else {
+        pixbuf = awn_icon_disk_cache_lookup(disk_cache, theme, theme_name,
+                                            scope, icon_name, size,
+                                            &null_result);
+        if (pixbuf || null_result) {
+            return pixbuf;
+        }
+
+        pixbuf = theme_load_icon(theme, icon_name, size, LOAD_FLAGS, NULL);
+    }
+    if (pixbuf) {
+        pixbuf = scale_to_size(pixbuf, size);
+    }
+    awn_icon_disk_cache_insert(disk_cache, theme, theme_name,
+                               scope, icon_name, size, pixbuf);
+    return pixbuf;
+}
+
 static GdkPixbuf*
 awn_themed_icon_lookup_pixbuf(AwnThemedIcon* icon, const gchar* scope,
                               GtkIconTheme* theme,
@@ -308,8 +565,11 @@ awn_themed_icon_lookup_pixbuf(AwnThemedIcon* icon, const gchar* scope,
 
     if (!null_result) {
         if (theme) {
-            pixbuf = theme_load_icon(theme, icon_name,
-                                     size, LOAD_FLAGS, NULL);
+            pixbuf = awn_themed_icon_load_theme_pixbuf(icon, theme, scope,
+                     icon_name, size);
+            if (priv->load_pending) {
+                return NULL;
+            }
         } else {
             pixbuf = try_and_load_image_from_disk(priv->current_item->original_name,
                                                   size);
@@ -420,6 +680,9 @@ awn_themed_icon_dispose(GObject* object)
         g_signal_handler_disconnect(priv->gtk_theme, priv->sig_id_for_gtk_theme);
         priv->sig_id_for_gtk_theme = 0;
     }
+    if (load_jobs) {
+        g_hash_table_foreach(load_jobs, awn_themed_icon_remove_waiter, object);
+    }
 
     G_OBJECT_CLASS(awn_themed_icon_parent_class)->dispose(object);
 }
@@ -605,6 +868,9 @@ awn_themed_icon_init(AwnThemedIcon* icon)
     priv->preload_list = NULL;
     priv->pixbufs = awn_pixbuf_cache_get_default();
     priv->cache_sentinel = 0;
+    priv->async_load = FALSE;
+    priv->load_pending = FALSE;
+    priv->has_pixbuf = FALSE;
 
     /* Set-up the gtk-theme */
     priv->gtk_theme = gtk_icon_theme_get_default();
@@ -711,6 +977,26 @@ try_and_load_image_from_disk(const gchar* filename, gint size)
 }
 
 
+/*
+ Scales the pixbuf down if it's taller than size, takes ownership of pixbuf.
+ */
+static GdkPixbuf*
+scale_to_size(GdkPixbuf* pixbuf, gint size)
+{
+    if (gdk_pixbuf_get_height(pixbuf) > size) {
+        GdkPixbuf* temp = pixbuf;
+        gint       width, height;
+
+        width = gdk_pixbuf_get_width(temp);
+        height = gdk_pixbuf_get_height(temp);
+
+        pixbuf = gdk_pixbuf_scale_simple(temp, width * size / height, size,
+                                         GDK_INTERP_HYPER);
+        g_object_unref(temp);
+    }
+    return pixbuf;
+}
+
 /*
  This function exists because gtk_icon_theme_load_icon() seems to insist
  on returning crappy builtin icons in certain situation  even when
@@ -867,6 +1153,11 @@ get_pixbuf_at_size(AwnThemedIcon* icon, gint size, const gchar* state)
                     g_free(name);
                 }
 
+                /* the icon is being loaded in the background */
+                if (priv->load_pending) {
+                    return NULL;
+                }
+
                 /* Check if we got a valid pixbuf on this run */
                 if (pixbuf) {
                     /* FIXME: Should we make this position-aware? */
@@ -876,17 +1167,7 @@ get_pixbuf_at_size(AwnThemedIcon* icon, gint size, const gchar* state)
                         gtk_widget_hide(priv->remove_custom_icon_item);
                     }
 
-                    if (gdk_pixbuf_get_height(pixbuf) > size) {
-                        GdkPixbuf* temp = pixbuf;
-                        gint       width, height;
-
-                        width = gdk_pixbuf_get_width(temp);
-                        height = gdk_pixbuf_get_height(temp);
-
-                        pixbuf = gdk_pixbuf_scale_simple(temp, width * size / height, size,
-                                                         GDK_INTERP_HYPER);
-                        g_object_unref(temp);
-                    }
+                    pixbuf = scale_to_size(pixbuf, size);
                     if (!name) {
                         g_free(priv->custom_icon_name);
                         priv->custom_icon_name = NULL;
@@ -918,8 +1199,24 @@ ensure_icon(AwnThemedIcon* icon)
         /* We're not ready yet */
         return;
     }
-    /* Get the icon first */
+    /* Get the icon first, if it has to be loaded, ensure_icon() is called
+     * again once it's ready */
+    priv->async_load = TRUE;
+    priv->load_pending = FALSE;
     pixbuf = get_pixbuf_at_size(icon, priv->current_size, priv->current_item->state);
+    priv->async_load = FALSE;
+
+    if (!pixbuf && priv->load_pending) {
+        if (priv->has_pixbuf) {
+            /* keep showing the previous icon until then */
+            return;
+        }
+        pixbuf = gdk_pixbuf_new(GDK_COLORSPACE_RGB, TRUE, 8,
+                                priv->current_size, priv->current_size);
+        gdk_pixbuf_fill(pixbuf, 0x00000000);
+    } else {
+        priv->has_pixbuf = TRUE;
+    }
 
     if (priv->rotate) {
         GdkPixbuf* rotated;
@@ -1342,6 +1639,7 @@ awn_themed_icon_override_gtk_theme(AwnThemedIcon* icon,
     if (priv->override_theme) {
         g_object_unref(priv->override_theme);
         awn_themed_icon_invalidate_pixbuf_cache(icon);
+        awn_themed_icon_invalidate_theme_caches();
     }
 
     if (theme_name && strlen(theme_name)) {
@@ -1596,6 +1894,7 @@ on_icon_theme_changed(GtkIconTheme* theme, AwnThemedIcon* icon)
      */
     if (g_strcmp0(priv->old_theme_name, priv->gtk_theme->priv->current_theme) != 0) {
         awn_themed_icon_invalidate_pixbuf_cache(icon);
+        awn_themed_icon_invalidate_theme_caches();
         g_free(priv->old_theme_name);
         priv->old_theme_name = g_strdup(priv->gtk_theme->priv->current_theme);
     }
@@ -1617,11 +1916,16 @@ on_idle_preload(gpointer data)
     }
 
     /*CONDITIONAL operator*/
+    priv->async_load = TRUE;
+    priv->load_pending = FALSE;
     pixbuf = get_pixbuf_at_size(item->icon,
                                 item->size > 0 ? item->size : priv->current_size,
                                 item->state);
+    priv->async_load = FALSE;
 
-    g_object_unref(pixbuf);
+    if (pixbuf) {
+        g_object_unref(pixbuf);
+    }
     priv->preload_list = g_list_remove(priv->preload_list, item);
     g_free(item->state);
     g_free(item);
@@ -1799,6 +2103,7 @@ awn_themed_icon_drag_data_received(GtkWidget*        widget,
     /* Make sure we don't have any conflicting icons */
     awn_themed_icon_clear_icons(icon, scope);
     awn_pixbuf_cache_invalidate(awn_pixbuf_cache_get_default());
+    awn_themed_icon_invalidate_theme_caches();
     if (svg) {
         check_dest_or_copy(sdata, dest_filename);
     } else
@@ -1921,6 +2226,7 @@ _select_icon(GtkMenuItem* menuitem, gchar* dest_filename_minus_ext)
         gchar** last;
 
         awn_pixbuf_cache_invalidate(awn_pixbuf_cache_get_default());
+        awn_themed_icon_invalidate_theme_caches();
 
         src_filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dialog));
         /*
@@ -2013,6 +2319,7 @@ _remove_icon(GtkMenuItem* menuitem, AwnThemedIcon* icon)
         return;
     }
     awn_pixbuf_cache_invalidate(awn_pixbuf_cache_get_default());
+    awn_themed_icon_invalidate_theme_caches();
     gchar* dest_filename_minus_ext = g_build_filename(priv->icon_dir,
                                      "awn-theme", "scalable",
                                      priv->custom_icon_name, NULL);
@@ -31,6 +31,7 @@
 
 #include "awn-cairo-utils.h"
 #include "awn-config.h"
+#include "awn-chrome-cache.h"
 
 #include "gseal-transition.h"
 
@@ -64,6 +65,10 @@ struct _AwnTooltipPrivate {
     DesktopAgnosticColor* font_color;
     gint      icon_offset;
 
+    /* bg and outline_color rendered, NULL until the next expose after
+     * they change */
+    AwnChromeFrame* frame;
+
     gboolean  smart_behavior, toggle_on_click;
     gboolean  inhibit_show;
 
@@ -130,20 +135,14 @@ awn_tooltip_expose_event(GtkWidget* widget, GdkEventExpose* expose)
     cairo_paint(cr);
 
     cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
-    cairo_set_line_width(cr, 1.0);
 
     /* Draw */
-    awn_cairo_set_source_color(cr, priv->bg);
-
-    awn_cairo_rounded_rect(cr, 0, 0, width, height,
-                           TOOLTIP_ROUND_RADIUS, ROUND_ALL);
-
-    if (priv->outline_color) {
-        cairo_fill_preserve(cr);
-        awn_cairo_set_source_color(cr, priv->outline_color);
-        cairo_stroke(cr);
-    } else {
-        cairo_fill(cr);
+    if (!priv->frame && priv->bg) {
+        priv->frame = awn_chrome_frame_get(TOOLTIP_ROUND_RADIUS, 1.0,
+                                           priv->bg, priv->outline_color);
+    }
+    if (priv->frame) {
+        awn_chrome_frame_paint(priv->frame, cr, width, height);
     }
 
     /* Clean up */
@@ -163,25 +162,11 @@ awn_tooltip_set_mask(AwnTooltip* tooltip, gint width, gint height)
 
     if (gtk_widget_is_composited(widget) == FALSE) {
         GdkBitmap* shaped_bitmap;
-        shaped_bitmap = (GdkBitmap*) gdk_pixmap_new(NULL, width, height, 1);
+        /* shared with the other tooltips of the same size */
+        shaped_bitmap = awn_chrome_get_rounded_mask(width, height,
+                        TOOLTIP_ROUND_RADIUS);
 
         if (shaped_bitmap) {
-            cairo_t* cr = gdk_cairo_create(shaped_bitmap);
-
-            cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
-            cairo_paint(cr);
-
-            cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
-            cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
-            cairo_translate(cr, 0.5, 0.5);
-
-
-            awn_cairo_rounded_rect(cr, 0, 0, width, height,
-                                   TOOLTIP_ROUND_RADIUS, ROUND_ALL);
-            cairo_fill(cr);
-
-            cairo_destroy(cr);
-
             gtk_widget_shape_combine_mask(widget, NULL, 0, 0);
             gtk_widget_shape_combine_mask(widget, shaped_bitmap, 0, 0);
 
@@ -450,6 +435,10 @@ awn_tooltip_finalize(GObject* obj)
         g_object_unref(priv->outline_color);
         priv->outline_color = NULL;
     }
+    if (priv->frame) {
+        awn_chrome_frame_unref(priv->frame);
+        priv->frame = NULL;
+    }
 
     G_OBJECT_CLASS(awn_tooltip_parent_class)->finalize(obj);
 }
@@ -891,6 +880,7 @@ awn_tooltip_set_focus_widget(AwnTooltip* tooltip,
         g_signal_handler_disconnect(priv->focus, priv->enter_id);
         g_signal_handler_disconnect(priv->focus, priv->leave_id);
         g_signal_handler_disconnect(priv->focus, priv->press_id);
+        priv->focus = NULL;
     }
 
     if (!GTK_IS_WIDGET(widget)) {
@@ -905,6 +895,19 @@ awn_tooltip_set_focus_widget(AwnTooltip* tooltip,
                      G_CALLBACK(awn_tooltip_hide), tooltip);
     priv->press_id = g_signal_connect(widget, "button-press-event",
                                       G_CALLBACK(on_button_press), tooltip);
+
+    /* the tooltip can be handed to a widget the pointer is already over,
+     * behave as if it just entered */
+    if (gtk_widget_get_realized(widget)) {
+        GtkAllocation alloc;
+        gint x, y;
+
+        gtk_widget_get_allocation(widget, &alloc);
+        gtk_widget_get_pointer(widget, &x, &y);
+        if (x >= 0 && y >= 0 && x < alloc.width && y < alloc.height) {
+            awn_tooltip_show(tooltip, NULL, widget);
+        }
+    }
 }
 
 void
@@ -970,6 +973,11 @@ awn_tooltip_set_outline_color(AwnTooltip*           tooltip,
             desktop_agnostic_color_new_from_string("#00000000", NULL);
     }
 
+    if (priv->frame) {
+        awn_chrome_frame_unref(priv->frame);
+        priv->frame = NULL;
+    }
+
     gtk_widget_queue_draw(GTK_WIDGET(tooltip));
 }
 
@@ -993,6 +1001,11 @@ awn_tooltip_set_background_color(AwnTooltip*           tooltip,
         priv->bg = desktop_agnostic_color_new_from_string("#000000B3", NULL);
     }
 
+    if (priv->frame) {
+        awn_chrome_frame_unref(priv->frame);
+        priv->frame = NULL;
+    }
+
     gtk_widget_queue_draw(GTK_WIDGET(tooltip));
 }
 
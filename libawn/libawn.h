@@ -31,6 +31,7 @@
 #include <libawn/awn-defines.h>
 #include <libawn/awn-dialog.h>
 #include <libawn/awn-effects.h>
+#include <libawn/awn-frame-clock.h>
 #include <libawn/awn-icon.h>
 #include <libawn/awn-icon-box.h>
 #include <libawn/awn-image.h>
@@ -66,8 +66,26 @@ struct _AwnAppletManagerPrivate {
     GQuark           touch_quark;
     GQuark           visibility_quark;
     GQuark           shape_mask_quark;
+
+    /* input mask of the applets, see awn_applet_manager_ensure_mask */
+    GdkRegion*       mask;
+    GArray*          mask_spans;
+    AwnPathType      mask_path_type;
+    gfloat           mask_offset_modifier;
 };
 
+/* part of the mask covered by one applet */
+typedef struct {
+    /* extent along the panel */
+    gint       start;
+    gint       end;
+    /* largest end of this and all the preceding spans */
+    gint       reach;
+    GdkRectangle rect;
+    /* shape mask of the applet (already offset), NULL if it's just rect */
+    GdkRegion* region;
+} AwnAppletSpan;
+
 enum {
     PROP_0,
 
@@ -104,6 +122,9 @@ static void on_icon_size_alloc(GtkWidget* widget,
                                GtkAllocation* alloc,
                                AwnAppletManager* manager);
 static void free_list(GSList** list);
+static void awn_applet_manager_invalidate_mask(AwnAppletManager* manager);
+static void on_size_allocate(GtkWidget* widget, GtkAllocation* alloc,
+                             AwnAppletManager* manager);
 
 /*
  * GOBJECT CODE
@@ -277,6 +298,12 @@ awn_applet_manager_dispose(GObject* object)
         priv->extra_widgets = NULL;
     }
 
+    if (priv->mask_spans) {
+        awn_applet_manager_invalidate_mask(AWN_APPLET_MANAGER(object));
+        g_array_free(priv->mask_spans, TRUE);
+        priv->mask_spans = NULL;
+    }
+
     desktop_agnostic_config_client_unbind_all_for_object(priv->client,
             object, NULL);
 
@@ -418,6 +445,12 @@ awn_applet_manager_init(AwnAppletManager* manager)
     priv->applets = g_hash_table_new_full(g_str_hash, g_str_equal,
                                           g_free, NULL);
     priv->extra_widgets = g_hash_table_new(g_direct_hash, g_direct_equal);
+    priv->mask = NULL;
+    priv->mask_spans = g_array_new(FALSE, FALSE, sizeof(AwnAppletSpan));
+
+    /* runs after the children were allocated */
+    g_signal_connect(manager, "size-allocate",
+                     G_CALLBACK(on_size_allocate), manager);
 
     gtk_widget_show_all(GTK_WIDGET(manager));
 }
@@ -505,12 +538,14 @@ awn_applet_manager_set_applet_flags(AwnAppletManager* manager,
                 g_object_set_qdata_full(G_OBJECT(applet), priv->shape_mask_quark,
                                         xutils_get_input_shape(win),
                                         (GDestroyNotify) gdk_region_destroy);
+                awn_applet_manager_invalidate_mask(manager);
                 g_signal_emit(manager, _applet_manager_signals[SHAPE_MASK_CHANGED], 0);
             } else {
                 gpointer region = g_object_get_qdata(G_OBJECT(applet),
                                                      priv->shape_mask_quark);
                 if (region) {
                     g_object_set_qdata(G_OBJECT(applet), priv->shape_mask_quark, NULL);
+                    awn_applet_manager_invalidate_mask(manager);
                     g_signal_emit(manager, _applet_manager_signals[SHAPE_MASK_CHANGED],
                                   0);
                 }
@@ -563,6 +598,7 @@ awn_applet_manager_set_size(AwnAppletManager* manager,
     AwnAppletManagerPrivate* priv = manager->priv;
 
     priv->size = size;
+    awn_applet_manager_invalidate_mask(manager);
 
     /* update size on all running applets (if they'd crash) */
     g_hash_table_foreach(priv->applets,
@@ -587,6 +623,7 @@ awn_applet_manager_set_offset(AwnAppletManager* manager,
     AwnAppletManagerPrivate* priv = manager->priv;
 
     priv->offset = offset;
+    awn_applet_manager_invalidate_mask(manager);
 
     /* update size on all running applets (if they'd crash) */
     g_hash_table_foreach(priv->applets,
@@ -614,6 +651,7 @@ awn_applet_manager_set_pos_type(AwnAppletManager* manager,
     AwnAppletManagerPrivate* priv = manager->priv;
 
     priv->position = position;
+    awn_applet_manager_invalidate_mask(manager);
 
     awn_box_set_orientation_from_pos_type(AWN_BOX(manager), position);
 
@@ -1181,30 +1219,82 @@ awn_applet_manager_redraw_throbbers(AwnAppletManager* manager)
     g_list_free(list);
 }
 
-GdkRegion*
-awn_applet_manager_get_mask(AwnAppletManager* manager,
-                            AwnPathType path_type,
-                            gfloat offset_modifier)
+static void
+awn_applet_manager_invalidate_mask(AwnAppletManager* manager)
+{
+    AwnAppletManagerPrivate* priv = manager->priv;
+
+    if (priv->mask) {
+        gdk_region_destroy(priv->mask);
+        priv->mask = NULL;
+    }
+
+    for (guint i = 0; i < priv->mask_spans->len; i++) {
+        AwnAppletSpan* span = &g_array_index(priv->mask_spans, AwnAppletSpan, i);
+        if (span->region) {
+            gdk_region_destroy(span->region);
+        }
+    }
+    g_array_set_size(priv->mask_spans, 0);
+}
+
+static void
+on_size_allocate(GtkWidget* widget, GtkAllocation* alloc,
+                 AwnAppletManager* manager)
+{
+    awn_applet_manager_invalidate_mask(manager);
+}
+
+static gint
+awn_applet_span_compare(gconstpointer a, gconstpointer b)
+{
+    const AwnAppletSpan* span_a = (const AwnAppletSpan*)a;
+    const AwnAppletSpan* span_b = (const AwnAppletSpan*)b;
+
+    return span_a->start - span_b->start;
+}
+
+/*
+ * The mask is cached until the applets are reallocated, their shape masks
+ * change or the panel is reconfigured. Besides the region we keep the parts
+ * of every applet sorted along the panel, for awn_applet_manager_point_in_mask.
+ */
+static void
+awn_applet_manager_ensure_mask(AwnAppletManager* manager,
+                               AwnPathType path_type,
+                               gfloat offset_modifier)
 {
-    g_return_val_if_fail(AWN_IS_APPLET_MANAGER(manager), NULL);
     AwnAppletManagerPrivate* priv = manager->priv;
+    gboolean vertical = priv->position == GTK_POS_LEFT ||
+                        priv->position == GTK_POS_RIGHT;
+
+    if (priv->mask && priv->mask_path_type == path_type &&
+            priv->mask_offset_modifier == offset_modifier) {
+        return;
+    }
+
+    awn_applet_manager_invalidate_mask(manager);
+
+    priv->mask = gdk_region_new();
+    priv->mask_path_type = path_type;
+    priv->mask_offset_modifier = offset_modifier;
 
-    GdkRegion* region = gdk_region_new();
     GList* children = gtk_container_get_children(GTK_CONTAINER(manager));
 
     for (GList* iter = children; iter != NULL; iter = g_list_next(iter)) {
         GtkWidget* widget = (GtkWidget*)iter->data;
         if (gtk_widget_get_visible(widget) && gtk_widget_get_has_window(widget)) {
+            AwnAppletSpan span;
             gpointer mask = g_object_get_qdata(G_OBJECT(widget),
                                                priv->shape_mask_quark);
             if (mask) {
-                GdkRegion* temp_region = gdk_region_copy(mask);
                 GtkAllocation alloc;
 
+                span.region = gdk_region_copy((GdkRegion*)mask);
                 gtk_widget_get_allocation(widget, &alloc);
-                gdk_region_offset(temp_region, alloc.x, alloc.y);
-                gdk_region_union(region, temp_region);
-                gdk_region_destroy(temp_region);
+                gdk_region_offset(span.region, alloc.x, alloc.y);
+                gdk_region_union(priv->mask, span.region);
+                gdk_region_get_clipbox(span.region, &span.rect);
             } else {
                 // GtkAllocation and GdkRectangle are the same, we can do this
                 GtkAllocation manager_alloc;
@@ -1237,13 +1327,99 @@ awn_applet_manager_get_mask(AwnAppletManager* manager,
                     rect.width = size;
                     break;
                 }
-                gdk_region_union_with_rect(region, &rect);
+                gdk_region_union_with_rect(priv->mask, &rect);
+
+                span.region = NULL;
+                span.rect = rect;
+            }
+
+            if (span.rect.width <= 0 || span.rect.height <= 0) {
+                if (span.region) {
+                    gdk_region_destroy(span.region);
+                }
+                continue;
             }
+            span.start = vertical ? span.rect.y : span.rect.x;
+            span.end = span.start + (vertical ? span.rect.height : span.rect.width);
+            g_array_append_val(priv->mask_spans, span);
         }
     }
 
     g_list_free(children);
 
-    return region;
+    g_array_sort(priv->mask_spans, awn_applet_span_compare);
+
+    /* shaped applets can reach into their neighbours */
+    gint reach = G_MININT;
+    for (guint i = 0; i < priv->mask_spans->len; i++) {
+        AwnAppletSpan* span = &g_array_index(priv->mask_spans, AwnAppletSpan, i);
+        reach = MAX(reach, span->end);
+        span->reach = reach;
+    }
+}
+
+GdkRegion*
+awn_applet_manager_get_mask(AwnAppletManager* manager,
+                            AwnPathType path_type,
+                            gfloat offset_modifier)
+{
+    g_return_val_if_fail(AWN_IS_APPLET_MANAGER(manager), NULL);
+
+    awn_applet_manager_ensure_mask(manager, path_type, offset_modifier);
+
+    return gdk_region_copy(manager->priv->mask);
+}
+
+/*
+ * Equivalent to gdk_region_point_in() on the region returned by
+ * awn_applet_manager_get_mask, but it only has to look at the applets
+ * whose spans contain the point (usually just one).
+ */
+gboolean
+awn_applet_manager_point_in_mask(AwnAppletManager* manager,
+                                 AwnPathType path_type,
+                                 gfloat offset_modifier,
+                                 gint x, gint y)
+{
+    g_return_val_if_fail(AWN_IS_APPLET_MANAGER(manager), FALSE);
+    AwnAppletManagerPrivate* priv = manager->priv;
+
+    awn_applet_manager_ensure_mask(manager, path_type, offset_modifier);
+
+    gint pos = priv->position == GTK_POS_LEFT ||
+               priv->position == GTK_POS_RIGHT ? y : x;
+    guint lo = 0, hi = priv->mask_spans->len;
+
+    /* find the last span starting before pos */
+    while (lo < hi) {
+        guint mid = (lo + hi) / 2;
+        if (g_array_index(priv->mask_spans, AwnAppletSpan, mid).start <= pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    /* spans can overlap, walk back while some earlier span reaches pos */
+    while (lo > 0) {
+        AwnAppletSpan* span = &g_array_index(priv->mask_spans, AwnAppletSpan,
+                                             --lo);
+        if (span->reach <= pos) {
+            break;
+        }
+        if (pos >= span->end) {
+            continue;
+        }
+
+        if (span->region) {
+            if (gdk_region_point_in(span->region, x, y)) {
+                return TRUE;
+            }
+        } else if (x >= span->rect.x && x < span->rect.x + span->rect.width &&
+                   y >= span->rect.y && y < span->rect.y + span->rect.height) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
 }
 
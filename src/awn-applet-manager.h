@@ -101,6 +101,11 @@ GdkRegion*  awn_applet_manager_get_mask(AwnAppletManager* manager,
                                         AwnPathType path_type,
                                         gfloat offset_modifier);
 
+gboolean    awn_applet_manager_point_in_mask(AwnAppletManager* manager,
+        AwnPathType path_type,
+        gfloat offset_modifier,
+        gint x, gint y);
+
 /* UA stuff */
 
 gboolean    awn_ua_get_all_server_flags(AwnAppletManager* manager,
@@ -25,6 +25,7 @@
 
 #include <gdk/gdk.h>
 #include <libawn/awn-cairo-utils.h>
+#include <libawn/awn-frame-clock.h>
 #include <math.h>
 
 #include "awn-applet-manager.h"
@@ -84,6 +85,15 @@ awn_background_lucido_get_needs_redraw(AwnBackground* bg,
                                        GtkPositionType position,
                                        GdkRectangle* area);
 
+static gboolean
+awn_background_lucido_add_resize_damage(AwnBackground* bg,
+                                        GtkPositionType position,
+                                        GdkRectangle* old_area,
+                                        GdkRectangle* new_area);
+
+static gboolean
+_invalidate_separators(AwnBackground* bg);
+
 
 static void
 _set_special_widget_width_and_transparent(AwnBackground* bg,
@@ -198,7 +208,7 @@ awn_background_lucido_dispose(GObject* object)
     }
     /* remove animation timer */
     if (priv->tid) {
-        g_source_remove(priv->tid);
+        awn_frame_clock_remove(awn_frame_clock_get_default(), priv->tid);
         priv->tid = 0;
     }
 
@@ -220,6 +230,7 @@ awn_background_lucido_class_init(AwnBackgroundLucidoClass* klass)
     bg_class->get_shape_mask = awn_background_lucido_get_shape_mask;
     bg_class->get_input_shape_mask = awn_background_lucido_get_shape_mask;
     bg_class->get_needs_redraw = awn_background_lucido_get_needs_redraw;
+    bg_class->add_resize_damage = awn_background_lucido_add_resize_damage;
 
     g_type_class_add_private(obj_class, sizeof(AwnBackgroundLucidoPrivate));
 }
@@ -282,7 +293,9 @@ awn_background_lucido_redraw(AwnBackgroundLucido* lbg)
     priv = AWN_BACKGROUND_LUCIDO_GET_PRIVATE(lbg);
 
     if (priv->needs_animation) {
-        awn_background_invalidate(bg);
+        if (!_invalidate_separators(bg)) {
+            awn_background_invalidate(bg);
+        }
         gtk_widget_queue_draw(GTK_WIDGET(bg->panel));
         return TRUE;
     } else {
@@ -300,7 +313,8 @@ static void _restart_timeout(AwnBackground* bg,
 {
     priv->needs_animation = TRUE;
     if (!priv->tid) {
-        priv->tid = g_timeout_add(ANIM_TIMEOUT, (GSourceFunc)awn_background_lucido_redraw, bg);
+        priv->tid = awn_frame_clock_add(awn_frame_clock_get_default(), ANIM_TIMEOUT,
+                                        (GSourceFunc)awn_background_lucido_redraw, bg);
     }
 }
 
@@ -1047,9 +1061,124 @@ awn_background_lucido_get_needs_redraw(AwnBackground* bg,
         AWN_BACKGROUND_LUCIDO_GET_PRIVATE(AWN_BACKGROUND_LUCIDO(bg));
     if (priv->expw != wcheck) {
         priv->expw = wcheck;
-        return TRUE;
+        return !_invalidate_separators(bg);
     }
     return FALSE;
 }
 
+/*
+ * _invalidate_separators:
+ * marks the curves of separators which aren't at their final position
+ * as damaged, returns FALSE if the whole bar has to be redrawn
+ */
+static gboolean
+_invalidate_separators(AwnBackground* bg)
+{
+    AwnBackgroundLucidoPrivate* priv =
+        AWN_BACKGROUND_LUCIDO_GET_PRIVATE(AWN_BACKGROUND_LUCIDO(bg));
+    GtkPositionType position = GTK_POS_BOTTOM;
+    gboolean partial = TRUE;
+
+    if (!awn_panel_get_composited(bg->panel) ||
+            awn_panel_get_docklet_mode(bg->panel)) {
+        return FALSE;
+    }
+    g_object_get(bg->panel, "position", &position, NULL);
+
+    GList* widgets = _get_applet_widgets(bg);
+    if (widgets && awn_background_do_rtl_swap(bg)) {
+        widgets = g_list_reverse(widgets);
+    }
+    GList* i = widgets;
+    /* the first separator isn't drawn as a curve (see _create_path_lucido) */
+    if (i && IS_SPECIAL(i->data)) {
+        i = i->next;
+    }
+    gint d = TRANSFORM_RADIUS(bg->corner_radius);
+    gint j = -1;
+    gint wx, wy;
+    for (; i; i = i->next) {
+        GtkWidget* widget = GTK_WIDGET(i->data);
+        if (!IS_SPECIAL(widget)) {
+            continue;
+        }
+        ++j;
+        if (j >= priv->pos_size) {
+            /* new separator */
+            partial = FALSE;
+            break;
+        }
+        gtk_widget_translate_coordinates(widget, gtk_widget_get_toplevel(widget),
+                                         0, 0, &wx, &wy);
+        gint curx = position == GTK_POS_LEFT || position == GTK_POS_RIGHT ?
+                    wy : wx;
+        gint lastx = lroundf(g_array_index(priv->pos, gfloat, j));
+        if (curx != lastx) {
+            /* the curve moves somewhere between the two positions,
+             * leave some space for antialiasing and the border */
+            awn_background_invalidate_span(bg, MIN(curx, lastx) - 2,
+                                           MAX(curx, lastx) + d + 2);
+        }
+    }
+    g_list_free(widgets);
+
+    /* a separator was removed */
+    if (j + 1 != priv->pos_size) {
+        partial = FALSE;
+    }
+    return partial;
+}
+
+/*
+ * awn_background_lucido_add_resize_damage:
+ * the bar looks the same in the middle when it grows or shrinks,
+ * only the end caps and the separators which moved need to be redrawn
+ */
+static gboolean
+awn_background_lucido_add_resize_damage(AwnBackground* bg,
+                                        GtkPositionType position,
+                                        GdkRectangle* old_area,
+                                        GdkRectangle* new_area)
+{
+    gint old_start, old_end, new_start, new_end;
+    gboolean expand = FALSE;
+    g_object_get(bg->panel, "expand", &expand, NULL);
+
+    if (expand || !awn_panel_get_composited(bg->panel)) {
+        return FALSE;
+    }
+
+    switch (position) {
+    case GTK_POS_LEFT:
+    case GTK_POS_RIGHT:
+        if (old_area->x != new_area->x || old_area->width != new_area->width) {
+            return FALSE;
+        }
+        old_start = old_area->y;
+        old_end = old_area->y + old_area->height;
+        new_start = new_area->y;
+        new_end = new_area->y + new_area->height;
+        break;
+    default:
+        if (old_area->y != new_area->y || old_area->height != new_area->height) {
+            return FALSE;
+        }
+        old_start = old_area->x;
+        old_end = old_area->x + old_area->width;
+        new_start = new_area->x;
+        new_end = new_area->x + new_area->width;
+        break;
+    }
+
+    gint d = TRANSFORM_RADIUS(bg->corner_radius);
+    awn_background_invalidate_span(bg, MIN(old_start, new_start) - 2,
+                                   MAX(old_start, new_start) + d + 2);
+    /* separators are pushed in front of the end cap */
+    awn_background_invalidate_span(bg, MIN(old_end, new_end) - d * 2 - 2,
+                                   MAX(old_end, new_end) + 2);
+    /* the redraw moves all separators to their new positions, damage
+     * the curves along the way too */
+    return _invalidate_separators(bg);
+}
+
 /* vim: set et ts=2 sts=2 sw=2 : */
@@ -34,6 +34,9 @@ extern "C" {
     G_DEFINE_ABSTRACT_TYPE(AwnBackground, awn_background, G_TYPE_OBJECT)
 }
 
+/* size of the tiles damaged spans are rounded to */
+#define DAMAGE_TILE_SIZE 64
+
 enum {
     PROP_0,
 
@@ -425,6 +428,12 @@ awn_background_finalize(GObject* object)
         cairo_surface_finish(bg->helper_surface);
         cairo_surface_destroy(bg->helper_surface);
     }
+    if (bg->glow_surface != NULL) {
+        cairo_surface_destroy(bg->glow_surface);
+    }
+    if (bg->damage) {
+        gdk_region_destroy(bg->damage);
+    }
 
     G_OBJECT_CLASS(awn_background_parent_class)->finalize(object);
 }
@@ -446,6 +455,7 @@ awn_background_class_init(AwnBackgroundClass* klass)
     klass->get_strut_offsets    = NULL;
     klass->draw                 = awn_background_draw_none;
     klass->get_needs_redraw     = awn_background_get_needs_redraw;
+    klass->add_resize_damage    = NULL;
 
     /* Object properties */
     g_object_class_install_property(obj_class,
@@ -712,26 +722,56 @@ awn_background_init(AwnBackground* bg)
     bg->sep_color = NULL;
     bg->needs_redraw = TRUE;
     bg->helper_surface = NULL;
+    bg->damage = NULL;
+    bg->glow_surface = NULL;
+    bg->glow_valid = FALSE;
     bg->cache_enabled = TRUE;
     bg->draw_glow = FALSE;
 }
 
+/*
+ * Blurs the background in helper_surface and stores the result (without
+ * the background itself) in glow_surface. The glow is kept as an alpha
+ * mask, the colour is applied when it's painted. If @clip isn't NULL, only
+ * the glow inside of it is updated, which requires only the background
+ * around @clip.
+ */
 static void
-awn_background_draw_glow(AwnBackground* bg, cairo_t* cr,
-                         GdkRectangle* area, gint rad,
-                         GtkPositionType  position)
+awn_background_update_glow(AwnBackground* bg,
+                           GdkRectangle* area, gint rad,
+                           GtkPositionType  position,
+                           GdkRectangle* clip)
 {
-    gfloat x, y, width, height;
+    GdkRectangle glow_rect;
+    gint x, y, width, height;
     gboolean non_null_draw;
 
-    x = area->x - rad;
-    y = area->y - rad;
-    width = area->width + rad * 2.;
-    height = area->height + rad * 2.;
+    if (bg->glow_surface == NULL) {
+        bg->glow_surface = cairo_image_surface_create(CAIRO_FORMAT_A8,
+                           cairo_image_surface_get_width(bg->helper_surface),
+                           cairo_image_surface_get_height(bg->helper_surface));
+    }
+
+    glow_rect.x = area->x - rad;
+    glow_rect.y = area->y - rad;
+    glow_rect.width = area->width + rad * 2;
+    glow_rect.height = area->height + rad * 2;
+    if (clip) {
+        GdkRectangle needed = {
+            clip->x - rad, clip->y - rad,
+            clip->width + rad * 2, clip->height + rad * 2
+        };
+        if (!gdk_rectangle_intersect(&glow_rect, &needed, &glow_rect)) {
+            return;
+        }
+    }
+    x = glow_rect.x;
+    y = glow_rect.y;
+    width = glow_rect.width;
+    height = glow_rect.height;
     non_null_draw =
         AWN_BACKGROUND_GET_CLASS(bg)->draw != awn_background_draw_none;
 
-    cairo_save(cr);
     /* Create a surface to apply the glow */
     cairo_surface_t* blur_srfc = cairo_image_surface_create
                                  (CAIRO_FORMAT_ARGB32,
@@ -741,10 +781,10 @@ awn_background_draw_glow(AwnBackground* bg, cairo_t* cr,
     cairo_t* blur_ctx = cairo_create(blur_srfc);
     cairo_push_group(blur_ctx);
     if (non_null_draw) {
-        cairo_set_source_surface(blur_ctx, cairo_get_target(cr), -x, -y);
+        cairo_set_source_surface(blur_ctx, bg->helper_surface, -x, -y);
         cairo_paint(blur_ctx);
     } else {
-        cairo_translate(blur_ctx, -area->x + rad, -area->y + rad);
+        cairo_translate(blur_ctx, -x, -y);
         awn_background_get_input_shape_mask(bg, blur_ctx, position, area);
     }
     cairo_pattern_t* pat = cairo_pop_group(blur_ctx);
@@ -752,13 +792,8 @@ awn_background_draw_glow(AwnBackground* bg, cairo_t* cr,
     cairo_set_source(blur_ctx, pat);
     cairo_set_operator(blur_ctx, CAIRO_OPERATOR_SOURCE);
     cairo_paint(blur_ctx);
-    GdkColor bg_color =
-        gtk_widget_get_style(GTK_WIDGET(bg->panel))->bg[GTK_STATE_SELECTED];
     blur_surface_shadow_rgba(blur_srfc, width, height, MAX(1, rad),
-                             bg_color.red / 256,
-                             bg_color.green / 256,
-                             bg_color.blue / 256,
-                             2.5);
+                             0, 0, 0, 2.5);
     if (non_null_draw) {
         cairo_set_source(blur_ctx, pat);
         cairo_set_operator(blur_ctx, CAIRO_OPERATOR_DEST_OUT);
@@ -767,12 +802,123 @@ awn_background_draw_glow(AwnBackground* bg, cairo_t* cr,
     cairo_pattern_destroy(pat);
     cairo_destroy(blur_ctx);
 
+    /* store the alpha, clears everything outside of glow_rect
+     * when updating the whole glow */
+    cairo_t* cr = cairo_create(bg->glow_surface);
+    if (clip) {
+        gdk_cairo_rectangle(cr, clip);
+        cairo_clip(cr);
+    }
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
     cairo_set_source_surface(cr, blur_srfc, x, y);
-    cairo_set_operator(cr, CAIRO_OPERATOR_DEST_OVER);
-    /* paint the blur on original surface */
     cairo_paint(cr);
+    cairo_destroy(cr);
     cairo_surface_destroy(blur_srfc);
-    cairo_restore(cr);
+
+    if (!clip) {
+        bg->glow_radius = rad;
+        bg->glow_valid = TRUE;
+    }
+}
+
+/*
+ * Redraws the damaged spans of the helper surface. The spans are rounded
+ * to tiles (after widening them by the glow radius, as that's how far
+ * the glow of the changed shape reaches), the background is drawn (clipped)
+ * once for all tiles and the glow is blurred separately for each tile.
+ */
+static void
+awn_background_redraw_damage(AwnBackground*  bg,
+                             GtkPositionType  position,
+                             GdkRectangle*   area,
+                             gint            rad,
+                             gboolean        draw_glow)
+{
+    AwnBackgroundClass* klass = AWN_BACKGROUND_GET_CLASS(bg);
+    GdkRectangle bounds = {
+        0, 0,
+        cairo_image_surface_get_width(bg->helper_surface),
+        cairo_image_surface_get_height(bg->helper_surface)
+    };
+    GdkRectangle* rects;
+    gint n_rects;
+    gint margin = draw_glow ? rad : 0;
+
+    GdkRegion* tiles = gdk_region_new();
+    gdk_region_get_rectangles(bg->damage, &rects, &n_rects);
+    for (gint i = 0; i < n_rects; i++) {
+        gint start = MAX(rects[i].x - margin, 0) /
+                     DAMAGE_TILE_SIZE * DAMAGE_TILE_SIZE;
+        gint end = (rects[i].x + rects[i].width + margin +
+                    DAMAGE_TILE_SIZE - 1) /
+                   DAMAGE_TILE_SIZE * DAMAGE_TILE_SIZE;
+        GdkRectangle tile;
+
+        switch (position) {
+        case GTK_POS_LEFT:
+        case GTK_POS_RIGHT:
+            tile.x = 0;
+            tile.y = start;
+            tile.width = bounds.width;
+            tile.height = end - start;
+            break;
+        default:
+            tile.x = start;
+            tile.y = 0;
+            tile.width = end - start;
+            tile.height = bounds.height;
+            break;
+        }
+        if (gdk_rectangle_intersect(&tile, &bounds, &tile)) {
+            gdk_region_union_with_rect(tiles, &tile);
+        }
+    }
+    g_free(rects);
+
+    if (gdk_region_empty(tiles)) {
+        gdk_region_destroy(tiles);
+        return;
+    }
+
+    cairo_t* cr = cairo_create(bg->helper_surface);
+    gdk_cairo_region(cr, tiles);
+    cairo_clip(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    klass->draw(bg, cr, position, area);
+    cairo_destroy(cr);
+
+    /* the rest of the surface didn't change, so the glow can be blurred
+     * from the background around the tiles - the glow of the changed
+     * background reaches rad px past the tiles, update_glow() then reads
+     * the background up to rad px around that */
+    if (draw_glow && bg->glow_valid && bg->glow_radius == rad) {
+        GdkRegion* glow_region = gdk_region_new();
+
+        gdk_region_get_rectangles(tiles, &rects, &n_rects);
+        for (gint i = 0; i < n_rects; i++) {
+            GdkRectangle rect = {
+                rects[i].x - rad, rects[i].y - rad,
+                rects[i].width + rad * 2, rects[i].height + rad * 2
+            };
+            if (gdk_rectangle_intersect(&rect, &bounds, &rect)) {
+                gdk_region_union_with_rect(glow_region, &rect);
+            }
+        }
+        g_free(rects);
+
+        gdk_region_get_rectangles(glow_region, &rects, &n_rects);
+        for (gint i = 0; i < n_rects; i++) {
+            awn_background_update_glow(bg, area, rad, position, &rects[i]);
+        }
+        g_free(rects);
+        gdk_region_destroy(glow_region);
+    } else {
+        bg->glow_valid = FALSE;
+    }
+
+    gdk_region_destroy(tiles);
 }
 
 void
@@ -794,20 +940,45 @@ awn_background_draw(AwnBackground*  bg,
         cairo_save(cr);
 
         /* Check if background needs to be redrawn */
-        if (klass->get_needs_redraw(bg, position, area)) {
+        gboolean full_redraw = klass->get_needs_redraw(bg, position, area);
+        gint rad = awn_panel_get_glow_size(bg->panel);
+        gboolean draw_glow =
+            bg->draw_glow && awn_panel_get_composited(bg->panel);
+        GtkAllocation alloc;
+
+        /* Keep the surface as large as the panel, so that animated resizes
+         * don't reallocate it on every frame */
+        gtk_widget_get_allocation(GTK_WIDGET(bg->panel), &alloc);
+        gint full_width = MAX(area->x + area->width + rad, alloc.width);
+        gint full_height = MAX(area->y + area->height + rad, alloc.height);
+
+        gboolean realloc_needed = bg->helper_surface == NULL ||
+                                  cairo_image_surface_get_width(bg->helper_surface) != full_width ||
+                                  cairo_image_surface_get_height(bg->helper_surface) != full_height;
+
+        if (!full_redraw && !realloc_needed &&
+                (area->x != bg->helper_area.x || area->y != bg->helper_area.y ||
+                 area->width != bg->helper_area.width ||
+                 area->height != bg->helper_area.height)) {
+            /* Subclasses which know what changes with the area will report
+             * the damaged spans, the rest needs to redraw everything */
+            full_redraw = klass->add_resize_damage == NULL ||
+                          !klass->add_resize_damage(bg, position,
+                                                    &bg->helper_area, area);
+        }
+
+        if (full_redraw || realloc_needed) {
             cairo_t* temp_cr;
-            gint rad = awn_panel_get_glow_size(bg->panel);
-            gint full_width = area->x + area->width + rad;
-            gint full_height = area->y + area->height + rad;
 
-            gboolean realloc_needed = bg->helper_surface == NULL ||
-                                      cairo_image_surface_get_width(bg->helper_surface) != full_width ||
-                                      cairo_image_surface_get_height(bg->helper_surface) != full_height;
             if (realloc_needed) {
-                /* Free last surface */
+                /* Free last surfaces */
                 if (bg->helper_surface != NULL) {
                     cairo_surface_destroy(bg->helper_surface);
                 }
+                if (bg->glow_surface != NULL) {
+                    cairo_surface_destroy(bg->glow_surface);
+                    bg->glow_surface = NULL;
+                }
                 /* Create new surface */
                 bg->helper_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32,
                                      full_width,
@@ -821,11 +992,32 @@ awn_background_draw(AwnBackground*  bg,
             }
             /* Draw background on temp cairo_t */
             klass->draw(bg, temp_cr, position, area);
-            if (bg->draw_glow && awn_panel_get_composited(bg->panel)) {
-                awn_background_draw_glow(bg, temp_cr, area, rad, position);
-            }
             cairo_destroy(temp_cr);
+            bg->glow_valid = FALSE;
+        } else if (bg->damage) {
+            awn_background_redraw_damage(bg, position, area, rad, draw_glow);
+        }
+        bg->helper_area = *area;
+        if (bg->damage) {
+            gdk_region_destroy(bg->damage);
+            bg->damage = NULL;
+        }
+
+        /* The glow is blurred only when the shape of the background changes,
+         * turning it on and off or changing its colour is just a paint */
+        if (draw_glow) {
+            if (!bg->glow_valid || bg->glow_radius != rad) {
+                awn_background_update_glow(bg, area, rad, position, NULL);
+            }
+            GdkColor bg_color =
+                gtk_widget_get_style(GTK_WIDGET(bg->panel))->bg[GTK_STATE_SELECTED];
+            cairo_set_source_rgb(cr,
+                                 (bg_color.red / 256) / 255.,
+                                 (bg_color.green / 256) / 255.,
+                                 (bg_color.blue / 256) / 255.);
+            cairo_mask_surface(cr, bg->glow_surface, 0., 0.);
         }
+
         /* Paint saved surface */
         cairo_set_source_surface(cr, bg->helper_surface, 0., 0.);
         cairo_paint(cr);
@@ -1187,8 +1379,8 @@ void awn_background_set_glow(AwnBackground* bg, gboolean activate)
 
     if (bg->draw_glow != activate) {
         bg->draw_glow = activate;
-        awn_background_invalidate(bg);
-        awn_background_emit_changed(bg);
+        /* the glow is painted separately, the background stays valid */
+        g_signal_emit(bg, _bg_signals[CHANGED], 0);
     }
 }
 
@@ -1214,4 +1406,31 @@ void awn_background_invalidate(AwnBackground*  bg)
     bg->needs_redraw = 1;
 }
 
+/*
+ * awn_background_invalidate_span:
+ * @bg: the background
+ * @start: start of the damaged span
+ * @end: end of the damaged span
+ *
+ * Marks part of the cached background as damaged, the coordinates are along
+ * the panel (x for top and bottom positions, y for left and right ones).
+ * Only the tiles containing damaged spans are redrawn on the next draw.
+ */
+void awn_background_invalidate_span(AwnBackground*  bg,
+                                    gint            start,
+                                    gint            end)
+{
+    GdkRectangle span = { start, 0, end - start, 1 };
+
+    g_return_if_fail(AWN_IS_BACKGROUND(bg));
+
+    if (span.width <= 0) {
+        return;
+    }
+    if (!bg->damage) {
+        bg->damage = gdk_region_new();
+    }
+    gdk_region_union_with_rect(bg->damage, &span);
+}
+
 /* vim: set et ts=2 sts=2 sw=2 : */
@@ -84,8 +84,16 @@ struct _AwnBackground {
     gboolean          cache_enabled;
     gboolean          needs_redraw;
     cairo_surface_t*  helper_surface;
+    /* area the helper_surface was drawn for */
+    GdkRectangle      helper_area;
+    /* spans (along the panel) of helper_surface which need to be redrawn */
+    GdkRegion*        damage;
 
     gboolean          draw_glow;
+    /* blurred alpha of helper_surface, painted in the selected colour */
+    cairo_surface_t*  glow_surface;
+    gint              glow_radius;
+    gboolean          glow_valid;
 
     /* FIXME:
      * These two should ultimately go somewhere else (once we do multiple panels)
@@ -145,6 +153,11 @@ struct _AwnBackgroundClass {
                                 GtkPositionType position,
                                 GdkRectangle* area);
 
+    gboolean(*add_resize_damage)(AwnBackground* bg,
+                                 GtkPositionType position,
+                                 GdkRectangle* old_area,
+                                 GdkRectangle* new_area);
+
     /*< signals >*/
     void (*changed)(AwnBackground* bg);
     void (*padding_changed)(AwnBackground* bg);
@@ -159,6 +172,10 @@ void awn_background_draw(AwnBackground*  bg,
 
 void awn_background_invalidate(AwnBackground*  bg);
 
+void awn_background_invalidate_span(AwnBackground*  bg,
+                                    gint            start,
+                                    gint            end);
+
 void awn_background_padding_request(AwnBackground* bg,
                                     GtkPositionType position,
                                     guint* padding_top,
@@ -933,9 +933,10 @@ awn_panel_size_request(GtkWidget* widget, GtkRequisition* requisition)
 
     if (priv->animated_resize && !priv->expand) {
         if (*target_size != *current_draw_size && !priv->resize_timer_id) {
-            /* background invalidation is in awn_panel_resize_timeout */
-            priv->resize_timer_id = g_timeout_add(40, awn_panel_resize_timeout,
-                                                  widget); // 25 FPS
+            /* the background notices the changing draw rect itself */
+            priv->resize_timer_id =
+                awn_frame_clock_add(awn_frame_clock_get_default(), 0,
+                                    awn_panel_resize_timeout, widget);
         }
     } else if (priv->expand) {
         // this ensures there's a shrinking animation when expand is turned off
@@ -1014,7 +1015,8 @@ awn_panel_resize_timeout(gpointer data)
     };
     gdk_window_invalidate_rect(gtk_widget_get_window(GTK_WIDGET(panel)),
                                &invalid_rect, FALSE);
-    awn_background_invalidate(priv->bg);
+    // the background redraws itself (or just the ends) when the draw
+    // rect changes, no need to invalidate it here
     // without this there are some artifacts on sad face & throbbers
     awn_applet_manager_redraw_throbbers(AWN_APPLET_MANAGER(priv->manager));
 
@@ -1341,6 +1343,59 @@ awn_panel_get_mask(AwnPanel* panel)
     return region;
 }
 
+/*
+ * Same as gdk_region_point_in() on awn_panel_get_mask(), without building
+ * the region - AppletManager keeps its mask cached.
+ */
+static gboolean
+awn_panel_point_in_mask(AwnPanel* panel, gint x, gint y)
+{
+    AwnPanelPrivate* priv = panel->priv;
+    GtkAllocation viewport_alloc;
+    gdouble viewport_offset_x, viewport_offset_y;
+
+    gtk_widget_get_allocation(priv->viewport, &viewport_alloc);
+
+    if (x >= viewport_alloc.x && x < viewport_alloc.x + viewport_alloc.width &&
+            y >= viewport_alloc.y && y < viewport_alloc.y + viewport_alloc.height) {
+        /* the applets are in viewport */
+        viewport_offset_x =
+            gtk_adjustment_get_value(
+                gtk_viewport_get_hadjustment(GTK_VIEWPORT(priv->viewport)));
+        viewport_offset_y =
+            gtk_adjustment_get_value(
+                gtk_viewport_get_vadjustment(GTK_VIEWPORT(priv->viewport)));
+
+        if (awn_applet_manager_point_in_mask(AWN_APPLET_MANAGER(priv->manager),
+                                             priv->path_type, priv->offset_mod,
+                                             x - (gint)(viewport_alloc.x - viewport_offset_x),
+                                             y - (gint)(viewport_alloc.y - viewport_offset_y))) {
+            return TRUE;
+        }
+    }
+
+    if (gtk_widget_get_visible(GTK_WIDGET(priv->arrow1))) {
+        GdkRegion* icon_mask;
+        gboolean inside;
+
+        icon_mask = awn_icon_get_input_mask(AWN_ICON(priv->arrow1));
+        inside = gdk_region_point_in(icon_mask, x, y);
+        gdk_region_destroy(icon_mask);
+        if (inside) {
+            return TRUE;
+        }
+
+        icon_mask = awn_icon_get_input_mask(AWN_ICON(priv->arrow2));
+        inside = gdk_region_point_in(icon_mask, x, y);
+        gdk_region_destroy(icon_mask);
+        if (inside) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
 static gboolean awn_panel_check_mouse_pos(AwnPanel* panel,
         MouseCheckType check_type)
 {
@@ -1396,17 +1451,9 @@ static gboolean awn_panel_check_mouse_pos(AwnPanel* panel,
         }
     }
     case MOUSE_CHECK_ACTIVE_MASK: {
-        // FIXME:
-        //   best would be to check if mouse is inside InputShape of the window,
-        //   but we can't do it because the checks are happening also while
-        //   in clickthrough mode
-        //   solution could be to save the mask which is created in update_masks
-        GdkRegion* region = awn_panel_get_mask(panel);
-        gdk_region_offset(region, window_x, window_y);
-        gboolean inside_mask = gdk_region_point_in(region, x, y);
-        gdk_region_destroy(region);
-
-        if (inside_mask) {
+        // we can't check the InputShape of the window, because the checks
+        //   are happening also while in clickthrough mode
+        if (awn_panel_point_in_mask(panel, x - window_x, y - window_y)) {
             return TRUE;
         }
 
@@ -1580,6 +1627,13 @@ autohide_start_timeout(gpointer data)
     g_signal_emit(panel, _panel_signals[AUTOHIDE_START], 0, &signal_ret);
     priv->autohide_always_visible = signal_ret;
 
+    /* once hidden only the poll notices the mouse touching the edge */
+    if (!priv->autohide_always_visible && priv->mouse_poll_timer_id == 0) {
+        priv->mouse_poll_timer_id =
+            g_timeout_add(priv->autohide_mouse_poll_delay,
+                          poll_mouse_position, panel);
+    }
+
     return FALSE;
 }
 
@@ -1603,10 +1657,7 @@ poll_mouse_position(gpointer data)
                 priv->autohide_start_timer_id = 0;
                 return TRUE;
             }
-            if (priv->autohide_started) {
-                priv->autohide_started = FALSE;
-                g_signal_emit(panel, _panel_signals[AUTOHIDE_END], 0);
-            }
+            awn_panel_reset_autohide(panel);
         } else if (gtk_widget_get_mapped(GTK_WIDGET(widget))) {
             /* mouse is away, panel should start hiding */
             if (priv->autohide_start_timer_id == 0  && !priv->autohide_started) {
@@ -1672,9 +1723,18 @@ poll_mouse_position(gpointer data)
 
     /* DETERMINE WHEN TO STOP POLLING */
 
-    /* Keep on polling when autohide */
+    /* Keep on polling when autohide is enabled, but only while the panel is
+     * hidden - when it's mapped, crossing events of the panel tell us when
+     * the mouse leaves it.
+     */
     if (priv->autohide_type != AUTOHIDE_TYPE_NONE) {
-        return TRUE;
+        if (priv->autohide_started) {
+            if (!priv->autohide_always_visible) {
+                return TRUE;
+            }
+        } else if (!gtk_widget_get_mapped(widget)) {
+            return TRUE;
+        }
     }
 
     /* Keep on polling on noctrl clickthrough */
@@ -1740,7 +1800,8 @@ awn_panel_dispose(GObject* object)
     }
 
     if (priv->resize_timer_id) {
-        g_source_remove(priv->resize_timer_id);
+        awn_frame_clock_remove(awn_frame_clock_get_default(),
+                               priv->resize_timer_id);
         priv->resize_timer_id = 0;
     }
 
@@ -3068,10 +3129,7 @@ on_mouse_over(GtkWidget* widget, GdkEventCrossing* event)
         g_source_remove(priv->autohide_start_timer_id);
         priv->autohide_start_timer_id = 0;
     }
-    if (priv->autohide_started) {
-        priv->autohide_started = FALSE;
-        g_signal_emit(panel, _panel_signals[AUTOHIDE_END], 0);
-    }
+    awn_panel_reset_autohide(panel);
 
     if (priv->mouse_poll_timer_id == 0 && poll_mouse_position(panel)) {
         priv->mouse_poll_timer_id =
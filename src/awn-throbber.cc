@@ -18,9 +18,11 @@
  */
 #include <gdk/gdkx.h>
 #include <math.h>
+#include <string.h>
 
 #include <libawn/awn-utils.h>
 #include <libawn/awn-cairo-utils.h>
+#include <libawn/awn-frame-clock.h>
 #include <libawn/awn-overlayable.h>
 
 #include "awn-defines.h"
@@ -36,6 +38,30 @@ extern "C" {
   AWN_TYPE_THROBBER, \
   AwnThrobberPrivate))
 
+#define THROBBER_PHASES 8
+
+/* what the phases of AWN_THROBBER_TYPE_NORMAL look like, compared with
+ * memcmp */
+typedef struct {
+    gint    width;
+    gint    height;
+    gint    size;
+    gdouble fill[4];
+    gdouble outline[4];
+} AwnThrobberSpriteKey;
+
+/* The phases rendered side by side, shared by all throbbers of the same
+ * size and colours. Every launching task shows a throbber. */
+typedef struct {
+    /* needs to be the first member, it's the key in the sprites table */
+    AwnThrobberSpriteKey key;
+    gint                 ref_count;
+    cairo_surface_t*     surface;
+} AwnThrobberSprite;
+
+/* AwnThrobberSpriteKey -> AwnThrobberSprite */
+static GHashTable* sprites = NULL;
+
 struct _AwnThrobberPrivate {
     AwnThrobberType type;
     gint size;
@@ -46,6 +72,8 @@ struct _AwnThrobberPrivate {
     DesktopAgnosticConfigClient* client;
     DesktopAgnosticColor* fill_color;
     DesktopAgnosticColor* outline_color;
+
+    AwnThrobberSprite* sprite;
 };
 
 enum {
@@ -56,6 +84,8 @@ enum {
     PROP_OUTLINE_COLOR
 };
 
+static void awn_throbber_sprite_unref(AwnThrobberSprite* sprite);
+
 /* GObject stuff */
 static void
 awn_throbber_dispose(GObject* object)
@@ -63,10 +93,15 @@ awn_throbber_dispose(GObject* object)
     AwnThrobberPrivate* priv = AWN_THROBBER_GET_PRIVATE(object);
 
     if (priv->timer_id) {
-        g_source_remove(priv->timer_id);
+        awn_frame_clock_remove(awn_frame_clock_get_default(), priv->timer_id);
         priv->timer_id = 0;
     }
 
+    if (priv->sprite) {
+        awn_throbber_sprite_unref(priv->sprite);
+        priv->sprite = NULL;
+    }
+
     G_OBJECT_CLASS(awn_throbber_parent_class)->dispose(object);
 }
 
@@ -220,6 +255,152 @@ paint_sad_face(cairo_t* cr)
 
 }
 
+static guint
+_sprite_key_hash(gconstpointer key)
+{
+    const guchar* data = (const guchar*)key;
+    guint hash = 2166136261u;
+
+    for (gsize i = 0; i < sizeof(AwnThrobberSpriteKey); i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static gboolean
+_sprite_key_equal(gconstpointer a, gconstpointer b)
+{
+    return memcmp(a, b, sizeof(AwnThrobberSpriteKey)) == 0;
+}
+
+static void
+_get_rgba(DesktopAgnosticColor* color, gdouble* rgba)
+{
+    if (color) {
+        desktop_agnostic_color_get_cairo_color(color, &rgba[0], &rgba[1],
+                                               &rgba[2], &rgba[3]);
+    } else {
+        rgba[0] = rgba[1] = rgba[2] = 0.0;
+        rgba[3] = 1.0;
+    }
+}
+
+/* paints one phase to [0,0] - [1,1] */
+static void
+paint_normal_phase(cairo_t* cr, const AwnThrobberSpriteKey* key, gint counter)
+{
+    const gdouble RADIUS = 0.0625;
+    const gdouble DIST = 0.3;
+    const gdouble OTHER = DIST * 0.707106781; /* sqrt(2)/2 */
+    const gint COUNT = THROBBER_PHASES;
+
+    cairo_set_line_width(cr, 1. / key->size);
+    cairo_translate(cr, 0.5, 0.5);
+    cairo_scale(cr, 1, -1);
+
+#define PAINT_CIRCLE(cr, x, y, cnt) \
+cairo_set_source_rgba (cr, key->fill[0], key->fill[1], key->fill[2], \
+key->fill[3] * ((counter+cnt) % COUNT) / (float)COUNT); \
+cairo_arc (cr, x, y, RADIUS, 0, 2*M_PI); \
+cairo_fill_preserve (cr); \
+cairo_set_source_rgba (cr, key->outline[0], key->outline[1], key->outline[2], \
+key->outline[3] * ((counter+cnt) % COUNT) / (float)COUNT); \
+cairo_stroke (cr);
+
+    PAINT_CIRCLE(cr, 0, DIST, 0);
+    PAINT_CIRCLE(cr, OTHER, OTHER, 1);
+    PAINT_CIRCLE(cr, DIST, 0, 2);
+    PAINT_CIRCLE(cr, OTHER, -OTHER, 3);
+    PAINT_CIRCLE(cr, 0, -DIST, 4);
+    PAINT_CIRCLE(cr, -OTHER, -OTHER, 5);
+    PAINT_CIRCLE(cr, -DIST, 0, 6);
+    PAINT_CIRCLE(cr, -OTHER, OTHER, 7);
+
+#undef PAINT_CIRCLE
+}
+
+static AwnThrobberSprite*
+awn_throbber_sprite_get(const AwnThrobberSpriteKey* key, cairo_t* target)
+{
+    AwnThrobberSprite* sprite;
+    cairo_t* cr;
+
+    if (!sprites) {
+        sprites = g_hash_table_new(_sprite_key_hash, _sprite_key_equal);
+    }
+
+    sprite = (AwnThrobberSprite*)g_hash_table_lookup(sprites, key);
+    if (sprite) {
+        sprite->ref_count++;
+        return sprite;
+    }
+
+    sprite = g_new0(AwnThrobberSprite, 1);
+    sprite->key = *key;
+    sprite->ref_count = 1;
+    sprite->surface = cairo_surface_create_similar(cairo_get_target(target),
+                      CAIRO_CONTENT_COLOR_ALPHA,
+                      key->width * THROBBER_PHASES,
+                      key->height);
+
+    cr = cairo_create(sprite->surface);
+    for (gint i = 0; i < THROBBER_PHASES; i++) {
+        cairo_save(cr);
+        cairo_translate(cr, i * key->width, 0);
+        cairo_scale(cr, key->width, key->height);
+        paint_normal_phase(cr, key, i);
+        cairo_restore(cr);
+    }
+    cairo_destroy(cr);
+
+    g_hash_table_insert(sprites, &sprite->key, sprite);
+
+    return sprite;
+}
+
+static void
+awn_throbber_sprite_unref(AwnThrobberSprite* sprite)
+{
+    if (--sprite->ref_count > 0) {
+        return;
+    }
+
+    g_hash_table_remove(sprites, &sprite->key);
+    cairo_surface_destroy(sprite->surface);
+    g_free(sprite);
+}
+
+/* blits the current phase, in icon pixels */
+static void
+awn_throbber_paint_normal(AwnThrobber* throbber, cairo_t* cr, gint w, gint h)
+{
+    AwnThrobberPrivate* priv = throbber->priv;
+    AwnThrobberSpriteKey key;
+
+    if (w <= 0 || h <= 0) {
+        return;
+    }
+
+    memset(&key, 0, sizeof(key));
+    key.width = w;
+    key.height = h;
+    key.size = priv->size;
+    _get_rgba(priv->fill_color, key.fill);
+    _get_rgba(priv->outline_color, key.outline);
+
+    if (!priv->sprite || memcmp(&key, &priv->sprite->key, sizeof(key)) != 0) {
+        if (priv->sprite) {
+            awn_throbber_sprite_unref(priv->sprite);
+        }
+        priv->sprite = awn_throbber_sprite_get(&key, cr);
+    }
+
+    cairo_set_source_surface(cr, priv->sprite->surface,
+                             -(priv->counter % THROBBER_PHASES) * w, 0);
+    cairo_rectangle(cr, 0, 0, w, h);
+    cairo_fill(cr);
+}
+
 static gboolean
 awn_throbber_expose_event(GtkWidget* widget, GdkEventExpose* event)
 {
@@ -234,44 +415,16 @@ awn_throbber_expose_event(GtkWidget* widget, GdkEventExpose* event)
 
     cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
 
-    // we'll paint to [0,0] - [1,1], so scale's needed
     g_object_get(G_OBJECT(widget), "icon-width", &w, "icon-height", &h, NULL);
-    cairo_scale(cr, w, h);
-
-    switch (priv->type) {
-    case AWN_THROBBER_TYPE_NORMAL: {
-        const gdouble RADIUS = 0.0625;
-        const gdouble DIST = 0.3;
-        const gdouble OTHER = DIST * 0.707106781; /* sqrt(2)/2 */
-        const gint COUNT = 8;
-        const gint counter = priv->counter;
-
-        cairo_set_line_width(cr, 1. / priv->size);
-        cairo_translate(cr, 0.5, 0.5);
-        cairo_scale(cr, 1, -1);
-
-#define PAINT_CIRCLE(cr, x, y, cnt) \
-awn_cairo_set_source_color_with_alpha_multiplier (cr, \
-priv->fill_color, ((counter+cnt) % COUNT) / (float)COUNT); \
-cairo_arc (cr, x, y, RADIUS, 0, 2*M_PI); \
-cairo_fill_preserve (cr); \
-awn_cairo_set_source_color_with_alpha_multiplier (cr, \
-priv->outline_color, ((counter+cnt) % COUNT) / (float)COUNT); \
-cairo_stroke (cr);
 
-        PAINT_CIRCLE(cr, 0, DIST, 0);
-        PAINT_CIRCLE(cr, OTHER, OTHER, 1);
-        PAINT_CIRCLE(cr, DIST, 0, 2);
-        PAINT_CIRCLE(cr, OTHER, -OTHER, 3);
-        PAINT_CIRCLE(cr, 0, -DIST, 4);
-        PAINT_CIRCLE(cr, -OTHER, -OTHER, 5);
-        PAINT_CIRCLE(cr, -DIST, 0, 6);
-        PAINT_CIRCLE(cr, -OTHER, OTHER, 7);
+    if (priv->type == AWN_THROBBER_TYPE_NORMAL) {
+        awn_throbber_paint_normal(AWN_THROBBER(widget), cr, w, h);
+    }
 
-#undef PAINT_CIRCLE
+    // we'll paint to [0,0] - [1,1], so scale's needed
+    cairo_scale(cr, w, h);
 
-        break;
-    }
+    switch (priv->type) {
     case AWN_THROBBER_TYPE_SAD_FACE: {
         cairo_set_line_width(cr, 0.03);
 
@@ -398,10 +551,8 @@ awn_throbber_show(GtkWidget* widget, gpointer user_data)
     AwnThrobberPrivate* priv = AWN_THROBBER_GET_PRIVATE(widget);
 
     if (!priv->timer_id && priv->type == AWN_THROBBER_TYPE_NORMAL) {
-        // we want lower prio than HIGH_IDLE
-        priv->timer_id = g_timeout_add_full(G_PRIORITY_DEFAULT_IDLE,
-                                            100, awn_throbber_timeout,
-                                            widget, NULL);
+        priv->timer_id = awn_frame_clock_add(awn_frame_clock_get_default(),
+                                             100, awn_throbber_timeout, widget);
     }
 }
 
@@ -411,7 +562,7 @@ awn_throbber_hide(GtkWidget* widget, gpointer user_data)
     AwnThrobberPrivate* priv = AWN_THROBBER_GET_PRIVATE(widget);
 
     if (priv->timer_id) {
-        g_source_remove(priv->timer_id);
+        awn_frame_clock_remove(awn_frame_clock_get_default(), priv->timer_id);
         priv->timer_id = 0;
     }
 }
@@ -521,10 +672,9 @@ awn_throbber_set_type(AwnThrobber* throbber, AwnThrobberType type)
     switch (type) {
     case AWN_THROBBER_TYPE_NORMAL:
         if (!priv->timer_id && gtk_widget_get_mapped(GTK_WIDGET(throbber))) {
-            // we want lower prio than HIGH_IDLE
-            priv->timer_id = g_timeout_add_full(G_PRIORITY_DEFAULT_IDLE,
-                                                100, awn_throbber_timeout,
-                                                throbber, NULL);
+            priv->timer_id = awn_frame_clock_add(awn_frame_clock_get_default(),
+                                                 100, awn_throbber_timeout,
+                                                 throbber);
         }
         break;
     case AWN_THROBBER_TYPE_CLOSE_BUTTON:
@@ -533,7 +683,8 @@ awn_throbber_set_type(AwnThrobber* throbber, AwnThrobberType type)
         // no break;
     default:
         if (priv->timer_id) {
-            g_source_remove(priv->timer_id);
+            awn_frame_clock_remove(awn_frame_clock_get_default(),
+                                   priv->timer_id);
             priv->timer_id = 0;
         }
         break;